@@ -66,7 +66,9 @@ macro(add_bitcode target)
             list(APPEND srcincludes -I${DIRECTORY})
         endforeach()
         
-        get_filename_component(outfile ${srcfile} NAME)
+        ## the output is named per target, so several targets can build the same source
+        get_filename_component(srcname ${srcfile} NAME)
+        set(outfile ${target}-${srcname})
         get_filename_component(infile ${srcfile} ABSOLUTE)
 
         ## the command to generate the bitcode for this file
@@ -131,8 +133,14 @@ macro(add_plugin target)
     #    message(FATAL_ERROR "LLVMHoistGlobals.so does not exist at ${LLVMHoistGlobalsPATH}")
     #endif()
 
+    ## in pointer mode, shadow switches plugin state with a pointer store instead of a copy
+    set(hoistflags "")
+    if(SHADOW_HOIST_POINTER STREQUAL ON)
+        list(APPEND hoistflags -hoist-globals-pointer)
+    endif()
+
     add_custom_command(OUTPUT ${target}.hoisted.bc
-        COMMAND ${LLVM_BC_OPT} -load=${LLVMHoistGlobalsPATH} -hoist-globals ${target}.bc -o ${target}.hoisted.bc
+        COMMAND ${LLVM_BC_OPT} -load=${LLVMHoistGlobalsPATH} -hoist-globals ${hoistflags} ${target}.bc -o ${target}.hoisted.bc
         DEPENDS ${target}.bc LLVMHoistGlobals ${LLVMHoistGlobalsPATH}
         COMMENT "Hoisting globals from ${target}.bc to ${target}.hoisted.bc"
     )
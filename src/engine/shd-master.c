@@ -25,6 +25,12 @@ struct _Master {
     SimulationTime minJumpTime;
     SimulationTime nextMinJumpTime;
 
+    /* if set, the jump time is the minimum latency actually used by packets
+     * during the last observedWindowCount windows, kept here as a ring */
+    guint observedWindowCount;
+    guint observedWindowIndex;
+    SimulationTime* observedLatencies;
+
     /* start of current window of execution */
     SimulationTime executeWindowStart;
     /* end of current window of execution (start + min_time_jump) */
@@ -67,6 +73,14 @@ Master* master_new(Configuration* config) {
 
     master->minJumpTimeConfig = ((SimulationTime)config->minRunAhead) * SIMTIME_ONE_MILLISECOND;
 
+    if(config->runAheadObservedWindows > 0) {
+        master->observedWindowCount = (guint)config->runAheadObservedWindows;
+        master->observedLatencies = g_new(SimulationTime, master->observedWindowCount);
+        for(guint i = 0; i < master->observedWindowCount; i++) {
+            master->observedLatencies[i] = SIMTIME_INVALID;
+        }
+    }
+
     /* these are only avail in glib >= 2.30
      * setup signal handlers for gracefully handling shutdowns */
 //  TODO
@@ -90,6 +104,9 @@ void master_free(Master* master) {
     g_free(dt_format);
 
     random_free(master->random);
+    if(master->observedLatencies) {
+        g_free(master->observedLatencies);
+    }
 
     MAGIC_CLEAR(master);
     g_free(master);
@@ -123,6 +140,21 @@ void master_updateMinTimeJump(Master* master, gdouble minPathLatency) {
     }
 }
 
+gboolean master_isRunAheadObserved(Master* master) {
+    MAGIC_ASSERT(master);
+    return master->observedWindowCount > 0;
+}
+
+static SimulationTime _master_getObservedMinLatency(Master* master) {
+    SimulationTime minLatency = SIMTIME_INVALID;
+    for(guint i = 0; i < master->observedWindowCount; i++) {
+        if(master->observedLatencies[i] < minLatency) {
+            minLatency = master->observedLatencies[i];
+        }
+    }
+    return minLatency;
+}
+
 SimulationTime master_getExecutionBarrier(Master* master) {
     MAGIC_ASSERT(master);
     return master->executeWindowEnd;
@@ -264,7 +296,8 @@ SimulationTime master_getEndTime(Master* master) {
     return master->endTime;
 }
 
-void master_slaveFinishedCurrentWindow(Master* master, SimulationTime minNextEventTime) {
+void master_slaveFinishedCurrentWindow(Master* master, SimulationTime minNextEventTime,
+        SimulationTime minObservedLatency) {
     MAGIC_ASSERT(master);
     utility_assert(minNextEventTime != SIMTIME_INVALID);
 
@@ -274,6 +307,21 @@ void master_slaveFinishedCurrentWindow(Master* master, SimulationTime minNextEve
     /* update our detected min jump time */
     master->minJumpTime = master->nextMinJumpTime;
 
+    if(master->observedWindowCount > 0) {
+        /* replace the oldest window with the one that just finished */
+        master->observedLatencies[master->observedWindowIndex] = minObservedLatency;
+        master->observedWindowIndex = (master->observedWindowIndex + 1) % master->observedWindowCount;
+
+        /* only hosts that actually talked constrain the window. if nobody did,
+         * fall back to the topology minimum so new flows are not clamped much */
+        SimulationTime observed = _master_getObservedMinLatency(master);
+        if(observed != SIMTIME_INVALID && observed > master->minJumpTime) {
+            debug("using observed minimum time jump of %"G_GUINT64_FORMAT" nanoseconds "
+                    "instead of topology minimum %"G_GUINT64_FORMAT, observed, master->minJumpTime);
+            master->minJumpTime = observed;
+        }
+    }
+
     /* update the next interval window based on next event times */
     SimulationTime newStart = minNextEventTime;
     SimulationTime newEnd = minNextEventTime + master_getMinTimeJump(master);
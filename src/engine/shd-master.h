@@ -17,6 +17,7 @@ gint master_run(Master* master);
 
 SimulationTime master_getMinTimeJump(Master* master);
 void master_updateMinTimeJump(Master* master, gdouble minPathLatency);
+gboolean master_isRunAheadObserved(Master* master);
 SimulationTime master_getExecutionBarrier(Master* master);
 GTimer* master_getRunTimer(Master* master);
 void master_setKillTime(Master* master, SimulationTime endTime);
@@ -25,6 +26,7 @@ void master_setKilled(Master* master, gboolean isKilled);
 SimulationTime master_getExecuteWindowEnd(Master* master);
 SimulationTime master_getExecuteWindowStart(Master* master);
 SimulationTime master_getEndTime(Master* master);
-void master_slaveFinishedCurrentWindow(Master* master, SimulationTime minNextEventTime);
+void master_slaveFinishedCurrentWindow(Master* master, SimulationTime minNextEventTime,
+        SimulationTime minObservedLatency);
 
 #endif /* SHD_ENGINE_H_ */
@@ -46,6 +46,8 @@ struct _Slave {
     gint rawFrequencyKHz;
     guint numEventsCurrentInterval;
     guint numNodesWithEventsCurrentInterval;
+    /* smallest latency of a packet sent between different hosts this interval */
+    SimulationTime minObservedLatencyCurrentInterval;
 
     /* We will not enter plugin context when set. Used when destroying threads */
     gboolean forceShadowContext;
@@ -312,6 +314,11 @@ void slave_updateMinTimeJump(Slave* slave, gdouble minPathLatency) {
     _slave_unlock(slave);
 }
 
+gboolean slave_isRunAheadObserved(Slave* slave) {
+    MAGIC_ASSERT(slave);
+    return master_isRunAheadObserved(slave->master);
+}
+
 guint slave_getWorkerCount(Slave* slave) {
     MAGIC_ASSERT(slave);
     /* configured number of worker threads, + 1 for main thread */
@@ -355,11 +362,15 @@ void slave_heartbeat(Slave* slave, SimulationTime simClockNow) {
     }
 }
 
-void slave_notifyProcessed(Slave* slave, guint numberEventsProcessed, guint numberNodesWithEvents) {
+void slave_notifyProcessed(Slave* slave, guint numberEventsProcessed, guint numberNodesWithEvents,
+        SimulationTime minObservedLatency) {
     MAGIC_ASSERT(slave);
     _slave_lock(slave);
     slave->numEventsCurrentInterval += numberEventsProcessed;
     slave->numNodesWithEventsCurrentInterval += numberNodesWithEvents;
+    if(minObservedLatency < slave->minObservedLatencyCurrentInterval) {
+        slave->minObservedLatencyCurrentInterval = minObservedLatency;
+    }
     _slave_unlock(slave);
     countdownlatch_countDownAwait(slave->processingLatch);
     countdownlatch_countDownAwait(slave->barrierLatch);
@@ -386,6 +397,13 @@ void slave_runParallel(Slave* slave) {
         item = g_list_next(item);
     }
 
+    /* workers read the topology from its snapshot, so publish the initial attachments */
+    if(slave->topology) {
+        topology_publishSnapshot(slave->topology);
+    }
+
+    slave->minObservedLatencyCurrentInterval = SIMTIME_INVALID;
+
     /* we will track when workers finish processing their nodes */
     slave->processingLatch = countdownlatch_new(slave->nWorkers + 1);
     /* after the workers finish processing, wait for barrier update */
@@ -450,12 +468,20 @@ void slave_runParallel(Slave* slave) {
         }
 
         /* notify master that we finished this round, and what our next event is */
-        master_slaveFinishedCurrentWindow(slave->master, minNextEventTime);
+        master_slaveFinishedCurrentWindow(slave->master, minNextEventTime,
+                slave->minObservedLatencyCurrentInterval);
+
+        /* no worker is reading the topology while they wait at the barrier, so this is
+         * where new paths and attachments become visible and old snapshots are reclaimed */
+        if(slave->topology) {
+            topology_publishSnapshot(slave->topology);
+        }
 
         /* reset for next round */
         countdownlatch_reset(slave->processingLatch);
         slave->numEventsCurrentInterval = 0;
         slave->numNodesWithEventsCurrentInterval = 0;
+        slave->minObservedLatencyCurrentInterval = SIMTIME_INVALID;
 
         /* release the workers for the next round, or to exit */
         countdownlatch_countDownAwait(slave->barrierLatch);
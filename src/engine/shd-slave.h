@@ -49,9 +49,11 @@ gboolean slave_isKilled(Slave* slave);
 void slave_setKillTime(Slave* slave, SimulationTime endTime);
 void slave_setKilled(Slave* slave, gboolean isKilled);
 SimulationTime slave_getMinTimeJump(Slave* slave);
+gboolean slave_isRunAheadObserved(Slave* slave);
 guint slave_getWorkerCount(Slave* slave);
 SimulationTime slave_getExecutionBarrier(Slave* slave);
-void slave_notifyProcessed(Slave* slave, guint numberEventsProcessed, guint numberNodesWithEvents);
+void slave_notifyProcessed(Slave* slave, guint numberEventsProcessed, guint numberNodesWithEvents,
+        SimulationTime minObservedLatency);
 void slave_runParallel(Slave* slave);
 void slave_runSerial(Slave* slave);
 void slave_storeProgram(Slave* slave, Program* prog);
@@ -4,6 +4,8 @@
  * See LICENSE for licensing information
  */
 
+#include <rpth.h>
+
 #include "shadow.h"
 
 /* thread-level storage structure */
@@ -19,6 +21,11 @@ struct _Worker {
     SimulationTime clock_last;
     SimulationTime clock_barrier;
 
+    /* smallest inter-host packet latency seen in the current window */
+    SimulationTime minObservedLatency;
+    /* log every clamped inter-host event when sizing the runahead by observed latency */
+    gboolean logClampedEvents;
+
     Random* random;
 
     Program* cached_plugin;
@@ -35,6 +42,9 @@ struct _Worker {
  * instance of a worker object */
 static GPrivate workerKey = G_PRIVATE_INIT((GDestroyNotify)worker_free);
 
+/* tells the preload library where plugins on this thread read the current time */
+extern void interposer_setWorkerClock(const SimulationTime* clock);
+
 static Worker* _worker_getPrivate() {
     /* get current thread's private worker object */
     Worker* worker = g_private_get(&workerKey);
@@ -58,6 +68,8 @@ Worker* worker_new(Slave* slave) {
     worker->clock_now = SIMTIME_INVALID;
     worker->clock_last = SIMTIME_INVALID;
     worker->clock_barrier = SIMTIME_INVALID;
+    worker->minObservedLatency = SIMTIME_INVALID;
+    worker->logClampedEvents = slave_isRunAheadObserved(slave);
 
     /* each worker needs a private copy of each plug-in library */
     worker->privatePrograms = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, (GDestroyNotify)program_free);
@@ -69,6 +81,12 @@ Worker* worker_new(Slave* slave) {
 
     g_private_replace(&workerKey, worker);
 
+    /* keep the thread stacks of exited processes for the next ones */
+    pth_stack_pool_enable();
+
+    /* publish our clock so the plugin time functions need not call into shadow */
+    interposer_setWorkerClock(&(worker->clock_now));
+
     return worker;
 }
 
@@ -78,10 +96,15 @@ void worker_free(Worker* worker) {
     /* calls the destroy functions we specified in g_hash_table_new_full */
     g_hash_table_destroy(worker->privatePrograms);
 
+    /* release the thread stacks that our processes left in the pool */
+    pth_stack_pool_drain();
+
     if(worker->serialEventQueue) {
         eventqueue_free(worker->serialEventQueue);
     }
 
+    interposer_setWorkerClock(NULL);
+
     MAGIC_CLEAR(worker);
     g_private_set(&workerKey, NULL);
     g_free(worker);
@@ -199,7 +222,8 @@ gpointer worker_runParallel(WorkLoad* workload) {
             item = g_list_next(item);
         }
 
-        slave_notifyProcessed(worker->slave, nEventsProcessed, nNodesWithEvents);
+        slave_notifyProcessed(worker->slave, nEventsProcessed, nNodesWithEvents, worker->minObservedLatency);
+        worker->minObservedLatency = SIMTIME_INVALID;
     }
 
     /* free all applications before freeing any of the nodes since freeing
@@ -317,8 +341,14 @@ void worker_scheduleEvent(Event* event, SimulationTime nano_delay, GQuark receiv
             /* warn and adjust time if needed */
             SimulationTime eventTime = shadowevent_getTime(event);
             if(eventTime < minTime) {
-                info("Inter-node event time %"G_GUINT64_FORMAT" changed to %"G_GUINT64_FORMAT" due to minimum delay %"G_GUINT64_FORMAT,
-                        eventTime, minTime, jump);
+                if(worker->logClampedEvents) {
+                    /* the runahead came from observed traffic, so this costs fidelity */
+                    message("Inter-node event time %"G_GUINT64_FORMAT" changed to %"G_GUINT64_FORMAT" due to minimum delay %"G_GUINT64_FORMAT" "
+                            "(event delayed by %"G_GUINT64_FORMAT" nanoseconds)", eventTime, minTime, jump, minTime - eventTime);
+                } else {
+                    info("Inter-node event time %"G_GUINT64_FORMAT" changed to %"G_GUINT64_FORMAT" due to minimum delay %"G_GUINT64_FORMAT,
+                            eventTime, minTime, jump);
+                }
                 shadowevent_setTime(event, minTime);
             }
         }
@@ -329,6 +359,21 @@ void worker_scheduleEvent(Event* event, SimulationTime nano_delay, GQuark receiv
     }
 }
 
+static gboolean _worker_dropSegments(Packet* packet, Random* random, guint32 threshold) {
+    /* a super-segment is lost one segment at a time, the survivors travel together */
+    guint i = 0;
+    while(i < packet_getSegmentCount(packet)) {
+        guint32 chance = random_nextUInt(random);
+        if(chance <= threshold) {
+            i++;
+        } else {
+            packet_addDeliveryStatus(packet_getSegment(packet, i), PDS_INET_DROPPED);
+            packet_removeSegment(packet, i);
+        }
+    }
+    return packet_getSegmentCount(packet) > 0 ? TRUE : FALSE;
+}
+
 void worker_schedulePacket(Packet* packet) {
     /* get our thread-private worker */
     Worker* worker = _worker_getPrivate();
@@ -337,28 +382,55 @@ void worker_schedulePacket(Packet* packet) {
         return;
     }
 
-    in_addr_t srcIP = packet_getSourceIP(packet);
-    in_addr_t dstIP = packet_getDestinationIP(packet);
+    /* established flows carry the route their socket already resolved */
+    Address* dstAddress = NULL;
+    Path* path = NULL;
 
-    Address* srcAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) srcIP);
-    Address* dstAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) dstIP);
+    if(!packet_getRoute(packet, &dstAddress, &path)) {
+        in_addr_t srcIP = packet_getSourceIP(packet);
+        in_addr_t dstIP = packet_getDestinationIP(packet);
 
-    if(!srcAddress || !dstAddress) {
-        error("unable to schedule packet because of null addresses");
-        return;
+        Address* srcAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) srcIP);
+        dstAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) dstIP);
+
+        if(!srcAddress || !dstAddress) {
+            error("unable to schedule packet because of null addresses");
+            return;
+        }
+
+        path = topology_getPath(worker_getTopology(), srcAddress, dstAddress);
+        if(!path) {
+            error("unable to schedule packet because of missing path");
+            return;
+        }
     }
 
     /* check if network reliability forces us to 'drop' the packet */
-    gdouble reliability = topology_getReliability(worker_getTopology(), srcAddress, dstAddress);
-    Random* random = host_getRandom(worker_getCurrentHost());
-    gdouble chance = random_nextDouble(random);
+    guint32 threshold = path_getReliabilityThreshold(path);
+    Random* random = host_getRandom(worker->cached_node);
+    gboolean isDelivered = FALSE;
+
+    if(packet_isFluid(packet)) {
+        /* the sender already accounted for the path loss in its rate */
+        isDelivered = TRUE;
+    } else if(packet_getSegmentCount(packet) > 0) {
+        isDelivered = _worker_dropSegments(packet, random, threshold);
+    } else {
+        guint32 chance = random_nextUInt(random);
+        /* don't drop control packets with length 0, otherwise congestion
+         * control has problems responding to packet loss */
+        isDelivered = (chance <= threshold || packet_getPayloadLength(packet) == 0) ? TRUE : FALSE;
+    }
 
-    /* don't drop control packets with length 0, otherwise congestion
-     * control has problems responding to packet loss */
-    if(chance <= reliability || packet_getPayloadLength(packet) == 0) {
+    if(isDelivered) {
         /* the sender's packet will make it through, find latency */
-        gdouble latency = topology_getLatency(worker_getTopology(), srcAddress, dstAddress);
-        SimulationTime delay = (SimulationTime) ceil(latency * SIMTIME_ONE_MILLISECOND);
+        SimulationTime delay = path_getDelay(path);
+
+        /* remember which latencies are actually in use, for the observed runahead */
+        GQuark srcID = (GQuark)address_getID(host_getDefaultAddress(worker->cached_node));
+        if(delay < worker->minObservedLatency && srcID != (GQuark)address_getID(dstAddress)) {
+            worker->minObservedLatency = delay;
+        }
 
         PacketArrivedEvent* event = packetarrived_new(packet);
         worker_scheduleEvent((Event*)event, delay, (GQuark)address_getID(dstAddress));
@@ -53,6 +53,22 @@ struct pth_event_st {
     } ev_args;
 };
 
+/* the fd events of all threads waiting on one fd share a single
+   registration in the epoll instance of the context, for the union of
+   their interests, until the last of them stops waiting */
+struct pth_efd_st {
+    int           nwaiting[3];  /* waiting events for EPOLLIN, OUT and ERR */
+    unsigned int  events;       /* interests registered in the instance    */
+    unsigned int  revents;      /* what epoll reported for the fd ...      */
+    unsigned long pass;         /* ... in this epoll_wait pass             */
+};
+
+/* epoll data of an fd registration, the low bit tells it apart from the
+   (aligned) pointer to the event of a timerfd and the NULL of the sigpipe */
+#define PTH_EFD_DATA(fd)      ((((uint64_t)(fd)) << 1) | 1)
+#define PTH_EFD_IS_DATA(u64)  ((u64) & 1)
+#define PTH_EFD_DATA_FD(u64)  ((int)((u64) >> 1))
+
 #endif /* cpp */
 
 /* event structure destructor */
@@ -140,6 +156,7 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_type = PTH_EVENT_TIME;
         ev->ev_goal = (int)(spec & (PTH_UNTIL_OCCURRED));
         ev->ev_args.TIME.tv = tv;
+        ev->ev_args.TIME.fd = -1;
     }
     else if (spec & PTH_EVENT_MSG) {
         /* message port event */
@@ -187,6 +204,7 @@ pth_event_t pth_event(unsigned long spec, ...)
         ev->ev_args.FUNC.func  = va_arg(ap, pth_event_func_t);
         ev->ev_args.FUNC.arg   = va_arg(ap, void *);
         ev->ev_args.FUNC.tv    = va_arg(ap, pth_time_t);
+        ev->ev_args.FUNC.fd    = -1;
     }
     else
         return pth_error((pth_event_t)NULL, EINVAL);
@@ -366,77 +384,168 @@ int pth_event_free(pth_event_t ev, int mode)
     return TRUE;
 }
 
+static const unsigned int pth_efd_interests[3] = { EPOLLIN, EPOLLOUT, EPOLLERR };
+
+/* the epoll interests of an fd event */
+static unsigned int _pth_event_fd_interests(pth_event_t pth_ev)
+{
+    unsigned int events = 0;
+    if (pth_ev->ev_goal & PTH_UNTIL_FD_READABLE)
+        events |= EPOLLIN;
+    if (pth_ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
+        events |= EPOLLOUT;
+    if (pth_ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
+        events |= EPOLLERR;
+    return events;
+}
+
+/* get the registration of the fd, growing the table if asked to */
+static struct pth_efd_st *_pth_efd_get(int fd, int grow)
+{
+    struct pth_gctx_st *gctx = pth_gctx_get();
+    struct pth_efd_st *efds;
+    int size;
+
+    if (fd < 0)
+        return NULL;
+    if (fd < gctx->main_efd_fds_size)
+        return &gctx->main_efd_fds[fd];
+    if (!grow)
+        return NULL;
+
+    size = gctx->main_efd_fds_size > 0 ? gctx->main_efd_fds_size : 64;
+    while (size <= fd)
+        size *= 2;
+    if ((efds = realloc(gctx->main_efd_fds, size * sizeof(struct pth_efd_st))) == NULL)
+        return NULL;
+    memset(&efds[gctx->main_efd_fds_size], 0,
+           (size - gctx->main_efd_fds_size) * sizeof(struct pth_efd_st));
+    gctx->main_efd_fds = efds;
+    gctx->main_efd_fds_size = size;
+    return &efds[fd];
+}
+
+/* bring the registration of the fd in the epoll instance up to date with
+   the interests of its waiters */
+static int _pth_efd_update(int fd, struct pth_efd_st *efd)
+{
+    struct epoll_event epoll_ev;
+    unsigned int events = 0;
+    int op;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        if (efd->nwaiting[i] > 0)
+            events |= pth_efd_interests[i];
+    if (events == efd->events)
+        return 0;
+
+    memset(&epoll_ev, 0, sizeof(struct epoll_event));
+    epoll_ev.events = events;
+    epoll_ev.data.u64 = PTH_EFD_DATA(fd);
+
+    if (events == 0) {
+        /* the fd may be closed already, which removed it for us */
+        pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_DEL, fd, NULL);
+        pth_gctx_get()->main_efd_nfds--;
+        efd->events = 0;
+        return 0;
+    }
+
+    op = efd->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, op, fd, &epoll_ev) < 0) {
+        /* the fd was closed and reused behind our back, or is still there
+           from someone else */
+        if (op == EPOLL_CTL_MOD && errno == ENOENT)
+            op = EPOLL_CTL_ADD;
+        else if (op == EPOLL_CTL_ADD && errno == EEXIST)
+            op = EPOLL_CTL_MOD;
+        else
+            return -1;
+        if (pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, op, fd, &epoll_ev) < 0)
+            return -1;
+    }
+    if (efd->events == 0)
+        pth_gctx_get()->main_efd_nfds++;
+    efd->events = events;
+    return 0;
+}
+
 static void _pth_event_register(pth_event_t pth_ev) {
 	if(!pth_ev) {
 		return;
 	}
 
-	struct epoll_event epoll_ev;
-	memset(&epoll_ev, 0, sizeof(struct epoll_event));
-	epoll_ev.data.ptr = pth_ev;
-
-	int target_fd = 0;
-
 	if (pth_ev->ev_type == PTH_EVENT_FD) {
-		if (pth_ev->ev_goal & PTH_UNTIL_FD_READABLE) {
-			epoll_ev.events |= EPOLLIN;
-		}
-		if (pth_ev->ev_goal & PTH_UNTIL_FD_WRITEABLE) {
-			epoll_ev.events |= EPOLLOUT;
-		}
-		if (pth_ev->ev_goal & PTH_UNTIL_FD_EXCEPTION) {
-			epoll_ev.events |= EPOLLERR;
-		}
-
-		if(epoll_ev.events != 0) {
-		    target_fd = pth_ev->ev_args.FD.fd;
-		}
+	    unsigned int events = _pth_event_fd_interests(pth_ev);
+	    struct pth_efd_st *efd;
+	    int i;
+
+	    if (events == 0)
+	        return;
+	    if ((efd = _pth_efd_get(pth_ev->ev_args.FD.fd, TRUE)) == NULL) {
+	        pth_ev->ev_status = PTH_STATUS_FAILED;
+	        return;
+	    }
+	    for (i = 0; i < 3; i++)
+	        if (events & pth_efd_interests[i])
+	            efd->nwaiting[i]++;
+	    if (_pth_efd_update(pth_ev->ev_args.FD.fd, efd) < 0) {
+	        pth_ev->ev_status = PTH_STATUS_FAILED;
+	        pth_debug3("_pth_event_register: epoll failed for thread \"%s\" fd %d", pth_gctx_get()->pth_current->name, pth_ev->ev_args.FD.fd);
+	        abort();
+	    }
 	} else if(pth_ev->ev_type == PTH_EVENT_TIME || pth_ev->ev_type == PTH_EVENT_FUNC) {
+	    struct epoll_event epoll_ev;
 	    pth_time_t* target_tv = NULL;
-	    target_fd = pth_sc(timerfd_create)(CLOCK_MONOTONIC, TFD_NONBLOCK);
+	    int target_fd;
+
+	    /* the async scheduler never waits on the instance and checks the
+	       timeouts by the clock, so a timer would wake up nobody */
+	    if (pth_gctx_get()->pth_is_async) {
+	        if (pth_ev->ev_type == PTH_EVENT_TIME)
+	            pth_ev->ev_args.TIME.fd = -1;
+	        else
+	            pth_ev->ev_args.FUNC.fd = -1;
+	        return;
+	    }
 
+	    target_fd = pth_sc(timerfd_create)(CLOCK_MONOTONIC, TFD_NONBLOCK);
 	    if(pth_ev->ev_type == PTH_EVENT_TIME) {
             pth_ev->ev_args.TIME.fd = target_fd;
 	        target_tv = &pth_ev->ev_args.TIME.tv;
-	    } else if(pth_ev->ev_type == PTH_EVENT_FUNC) {
+	    } else {
 	        pth_ev->ev_args.FUNC.fd = target_fd;
             target_tv = &pth_ev->ev_args.FUNC.tv;
 	    }
+	    if (target_fd < 0)
+	        return;
+
+        /* arm the timer */
+        struct itimerspec timeout;
+        memset(&timeout, 0, sizeof(struct itimerspec));
+        timeout.it_value.tv_sec = target_tv->tv_sec;
+        timeout.it_value.tv_nsec = (1000 * target_tv->tv_usec);
+
+        int rc = pth_sc(timerfd_settime)(target_fd, TFD_TIMER_ABSTIME, &timeout, NULL);
+        if(rc != 0) {
+            pth_ev->ev_status = PTH_STATUS_FAILED;
+            pth_debug3("_pth_event_register: timerfd failed for thread \"%s\" fd %d", pth_gctx_get()->pth_current->name, target_fd);
+            abort();
+        }
 
-	    if(target_tv) {
-            /* arm the timer */
-            struct itimerspec timeout;
-            memset(&timeout, 0, sizeof(struct itimerspec));
-            timeout.it_value.tv_sec = target_tv->tv_sec;
-            timeout.it_value.tv_nsec = (1000 * target_tv->tv_usec);
-
-            int rc = pth_sc(timerfd_settime)(target_fd, TFD_TIMER_ABSTIME, &timeout, NULL);
-            if(rc != 0) {
-                pth_ev->ev_status = PTH_STATUS_FAILED;
-                pth_debug3("_pth_event_register: timerfd failed for thread \"%s\" fd %d", pth_gctx_get()->pth_current->name, target_fd);
-                abort();
-            }
-
-            /* the timer is readable once it expires */
-            epoll_ev.events |= EPOLLIN;
-	    }
-	}
-
-	if(target_fd > 0) {
-        int rc = pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_ADD, target_fd, &epoll_ev);
-
-        if(rc < 0) {
-            if(errno == EEXIST) {
-                /* this didnt get added because it was already there. so try to mod it instead */
-                rc = pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_MOD, target_fd, &epoll_ev);
-            }
-            if (rc < 0) {
-                /* this didnt get added because of some other error, or the mod failed too */
-                pth_ev->ev_status = PTH_STATUS_FAILED;
-                pth_debug3("_pth_event_register: epoll failed for thread \"%s\" fd %d", pth_gctx_get()->pth_current->name, target_fd);
-                abort();
-            }
+        /* the timer is readable once it expires. it only wakes up the
+           blocking scheduler, which still goes by the clock, so it is not
+           counted with the fds that are worth an epoll_wait() */
+        memset(&epoll_ev, 0, sizeof(struct epoll_event));
+        epoll_ev.events = EPOLLIN;
+        epoll_ev.data.ptr = pth_ev;
+        if (pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_ADD, target_fd, &epoll_ev) < 0) {
+            pth_ev->ev_status = PTH_STATUS_FAILED;
+            pth_debug3("_pth_event_register: epoll failed for thread \"%s\" fd %d", pth_gctx_get()->pth_current->name, target_fd);
+            abort();
         }
+        pth_gctx_get()->main_efd_ntimers++;
 	}
 }
 
@@ -445,24 +554,66 @@ static void _pth_event_deregister(pth_event_t pth_ev) {
         return;
     }
 
-    int target_fd = 0;
-
     if (pth_ev->ev_type == PTH_EVENT_FD) {
-        target_fd = pth_ev->ev_args.FD.fd;
-    } else if(pth_ev->ev_type == PTH_EVENT_TIME) {
-        target_fd = pth_ev->ev_args.TIME.fd;
-    } else if(pth_ev->ev_type == PTH_EVENT_FUNC) {
-        target_fd = pth_ev->ev_args.FUNC.fd;
+        unsigned int events = _pth_event_fd_interests(pth_ev);
+        struct pth_efd_st *efd;
+        int i;
+
+        if (events == 0 || (efd = _pth_efd_get(pth_ev->ev_args.FD.fd, FALSE)) == NULL)
+            return;
+        for (i = 0; i < 3; i++)
+            if ((events & pth_efd_interests[i]) && efd->nwaiting[i] > 0)
+                efd->nwaiting[i]--;
+        _pth_efd_update(pth_ev->ev_args.FD.fd, efd);
+    } else if (pth_ev->ev_type == PTH_EVENT_TIME || pth_ev->ev_type == PTH_EVENT_FUNC) {
+        int *target_fd = pth_ev->ev_type == PTH_EVENT_TIME ?
+                         &pth_ev->ev_args.TIME.fd : &pth_ev->ev_args.FUNC.fd;
+
+        /* delete the timer we created in _pth_event_register() */
+        if (*target_fd >= 0) {
+            pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_DEL, *target_fd, NULL);
+            pth_sc(close)(*target_fd);
+            pth_gctx_get()->main_efd_ntimers--;
+            *target_fd = -1;
+        }
     }
+}
 
-    if(target_fd > 0) {
-        pth_sc(epoll_ctl)(pth_gctx_get()->main_efd, EPOLL_CTL_DEL, target_fd, NULL);
+/* handle one result of epoll_wait() on the instance of the context: fd
+   results are kept for pth_event_fd_occurred() in this pass, timers are
+   consumed and their event is returned */
+intern pth_event_t pth_event_epoll_ready(struct epoll_event *epoll_ev, unsigned long pass)
+{
+    struct pth_efd_st *efd;
+    pth_event_t ev;
+    uint64_t n_expirations;
 
-        /* do we need to delete the timer we created in _pth_event_register()? */
-        if(pth_ev->ev_type == PTH_EVENT_TIME || pth_ev->ev_type == PTH_EVENT_FUNC) {
-            pth_sc(close)(target_fd);
+    if (PTH_EFD_IS_DATA(epoll_ev->data.u64)) {
+        if ((efd = _pth_efd_get(PTH_EFD_DATA_FD(epoll_ev->data.u64), FALSE)) != NULL) {
+            efd->revents = epoll_ev->events;
+            efd->pass = pass;
         }
+        return NULL;
     }
+
+    /* the sigpipe */
+    if ((ev = (pth_event_t)epoll_ev->data.ptr) == NULL)
+        return NULL;
+
+    n_expirations = 0;
+    pth_sc(read)(ev->ev_type == PTH_EVENT_TIME ? ev->ev_args.TIME.fd : ev->ev_args.FUNC.fd,
+                 &n_expirations, sizeof(n_expirations));
+    return ev;
+}
+
+/* whether epoll reported the goal of the fd event in this pass */
+intern int pth_event_fd_occurred(pth_event_t ev, unsigned long pass)
+{
+    struct pth_efd_st *efd;
+
+    if ((efd = _pth_efd_get(ev->ev_args.FD.fd, FALSE)) == NULL || efd->pass != pass)
+        return FALSE;
+    return (efd->revents & _pth_event_fd_interests(ev)) ? TRUE : FALSE;
 }
 
 /* wait for one or more events */
@@ -496,9 +647,6 @@ int pth_wait(pth_event_t ev_ring)
     pth_gctx_get()->pth_current->state = PTH_STATE_WAITING;
     pth_yield(NULL);
 
-    /* check for cancellation */
-    pth_cancel_point();
-
     /* unlink event ring from current thread */
     pth_gctx_get()->pth_current->events = NULL;
 
@@ -517,6 +665,10 @@ int pth_wait(pth_event_t ev_ring)
         ev = ev->ev_next;
     } while (ev != ev_ring);
 
+    /* check for cancellation, after the events left the epoll instance
+       so it never holds on to the events of an exited thread */
+    pth_cancel_point();
+
     /* leave to current thread with number of occurred events */
     pth_debug2("pth_wait: leave to thread \"%s\"", pth_gctx_get()->pth_current->name);
     return nonpending;
@@ -61,6 +61,13 @@ struct pth_gctx_st {
     pth_time_t   pth_loadtickgap;
 
     int main_efd; // epoll fd
+    int main_efd_nfds;              /* number of fds registered in main_efd  */
+    int main_efd_ntimers;           /* timerfds in it, only when may block   */
+    struct pth_efd_st *main_efd_fds;/* registrations in it, indexed by fd    */
+    int main_efd_fds_size;          /* number of fds the table can hold      */
+    unsigned long main_efd_pass;    /* number of epoll_wait() calls on it    */
+    struct epoll_event *pth_evbuf;  /* reused buffer for epoll_wait results  */
+    int pth_evbuf_size;             /* number of events the buffer can hold  */
 
     struct pth_keytab_st pth_keytab[PTH_KEY_MAX];
     pth_key_t ev_key_join;
@@ -141,6 +148,7 @@ pth_gctx_t pth_gctx_new(int may_block)
     gctx->mutex_pread = __mutex_initializer;
     gctx->mutex_pwrite = __mutex_initializer;
     gctx->pth_atfork_idx = 0;
+    gctx->main_efd = -1;
 
     gctx->ev_key_join = PTH_KEY_INIT;
     gctx->ev_key_nap = PTH_KEY_INIT;
@@ -233,8 +241,17 @@ static int pth_init_helper(void)
     }
     pth_attr_destroy(t_attr);
 
-    /* create our epoll instance, used for scheduling */
+    /* create our epoll instance, used for scheduling. it lives as long as
+       the context, and pth_wait() keeps the registered fds up to date */
     pth_gctx_get()->main_efd = epoll_create(1);
+    if (!pth_gctx_get()->pth_is_async) {
+        /* the blocking scheduler also needs to wake up for signals */
+        struct epoll_event sigpipe_ev;
+        memset(&sigpipe_ev, 0, sizeof(struct epoll_event));
+        sigpipe_ev.events = EPOLLIN;
+        sigpipe_ev.data.ptr = NULL;
+        epoll_ctl(pth_gctx_get()->main_efd, EPOLL_CTL_ADD, pth_gctx_get()->pth_sigpipe[0], &sigpipe_ev);
+    }
 
     /*
      * The first time we've to manually switch into the scheduler to start
@@ -50,6 +50,8 @@ struct pth_mctx_st {
     int restored;
 #elif PTH_MCTX_MTH(sjlj)
     pth_sigjmpbuf jb;
+#elif PTH_MCTX_MTH(asm)
+    void *sp;
 #else
 #error "unknown mctx method"
 #endif
@@ -64,6 +66,17 @@ struct pth_mctx_st {
 ** ____ MACHINE STATE SWITCHING ______________________________________
 */
 
+#if PTH_MCTX_MTH(asm)
+/*
+ * the hand-written switch saves the callee-saved registers on the old
+ * stack, stores the stack pointer in `old_sp' and resumes the context
+ * whose stack pointer is `new_sp'. the jump only resumes. both are
+ * implemented in assembly below, so their symbol names are fixed.
+ */
+extern void pth_mctx_asm_switch(void **old_sp, void *new_sp) __asm__("__pth_mctx_asm_switch");
+extern void pth_mctx_asm_jump(void *new_sp) __asm__("__pth_mctx_asm_jump");
+#endif
+
 /*
  * save the current machine context
  */
@@ -82,6 +95,8 @@ struct pth_mctx_st {
 #define pth_mctx_save(mctx) \
         ( (mctx)->error = errno, \
           pth_sigsetjmp((mctx)->jb) )
+#elif PTH_MCTX_MTH(asm)
+/* a context can only be saved while switching away from it */
 #else
 #error "unknown mctx method"
 #endif
@@ -99,6 +114,10 @@ struct pth_mctx_st {
 #define pth_mctx_restore(mctx) \
         ( errno = (mctx)->error, \
           (void)pth_siglongjmp((mctx)->jb, 1) )
+#elif PTH_MCTX_MTH(asm)
+#define pth_mctx_restore(mctx) \
+        ( errno = (mctx)->error, \
+          pth_mctx_asm_jump((mctx)->sp) )
 #else
 #error "unknown mctx method"
 #endif
@@ -135,6 +154,12 @@ struct pth_mctx_st {
     if (pth_mctx_save(old) == 0) \
         pth_mctx_restore(new); \
     pth_mctx_restored(old);
+#elif PTH_MCTX_MTH(asm)
+#define pth_mctx_switch(old,new) \
+    _pth_mctx_switch_debug \
+    (old)->error = errno; \
+    errno = (new)->error; \
+    pth_mctx_asm_switch(&((old)->sp), (new)->sp);
 #else
 #error "unknown mctx method"
 #endif
@@ -180,6 +205,97 @@ intern int pth_mctx_set(
     return TRUE;
 }
 
+#elif PTH_MCTX_MTH(asm)
+
+/*
+ * VARIANT 0: THE HAND-WRITTEN X86-64 SWITCH
+ *
+ * Only the registers that the System V AMD64 ABI requires a function
+ * to preserve (rbx, rbp, r12-r15, the SSE control/status register and
+ * the x87 control word) and the stack pointer make up the context.
+ * Everything else is already saved by the caller of the switch. The
+ * signal mask is not part of the context, so a switch never enters
+ * the kernel.
+ *
+ * The saved context lives on the stack of the suspended thread:
+ *
+ *     sp+0   x87 control word
+ *     sp+8   mxcsr
+ *     sp+16  r15, r14, r13, r12, rbx, rbp
+ *     sp+64  return address
+ */
+
+__asm__ (
+    ".text\n"
+    ".p2align 4\n"
+    ".globl __pth_mctx_asm_switch\n"
+    ".hidden __pth_mctx_asm_switch\n"
+    ".type __pth_mctx_asm_switch,@function\n"
+    "__pth_mctx_asm_switch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $16, %rsp\n"
+    "    stmxcsr 8(%rsp)\n"
+    "    fnstcw (%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rdi\n"
+    ".globl __pth_mctx_asm_jump\n"
+    ".hidden __pth_mctx_asm_jump\n"
+    ".type __pth_mctx_asm_jump,@function\n"
+    "__pth_mctx_asm_jump:\n"
+    "    movq %rdi, %rsp\n"
+    "    fldcw (%rsp)\n"
+    "    ldmxcsr 8(%rsp)\n"
+    "    addq $16, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size __pth_mctx_asm_switch,.-__pth_mctx_asm_switch\n"
+);
+
+intern int pth_mctx_set(
+    pth_mctx_t *mctx, void (*func)(void), char *sk_addr_lo, char *sk_addr_hi)
+{
+    unsigned long *sp;
+    unsigned int mxcsr;
+    unsigned short fpucw;
+
+    if (sk_addr_hi - sk_addr_lo < 1024)
+        return pth_error(FALSE, EINVAL);
+
+    /* the stack grows down. the return address slot must be 16-byte
+       aligned, so that func starts with the alignment a call gives it */
+    sp = (unsigned long *)((unsigned long)sk_addr_hi & ~(unsigned long)15);
+    *(--sp) = 0;                    /* func never returns */
+    *(--sp) = (unsigned long)func;  /* return address of the first switch */
+    *(--sp) = 0;                    /* rbp */
+    *(--sp) = 0;                    /* rbx */
+    *(--sp) = 0;                    /* r12 */
+    *(--sp) = 0;                    /* r13 */
+    *(--sp) = 0;                    /* r14 */
+    *(--sp) = 0;                    /* r15 */
+
+    /* start with the floating point control state of the creator */
+    __asm__ __volatile__ ("stmxcsr %0" : "=m" (mxcsr));
+    __asm__ __volatile__ ("fnstcw %0" : "=m" (fpucw));
+    *(--sp) = (unsigned long)mxcsr;
+    *(--sp) = (unsigned long)fpucw;
+
+    mctx->sp = sp;
+    mctx->error = 0;
+    sigemptyset(&mctx->sigs);
+
+    return TRUE;
+}
+
 #elif PTH_MCTX_MTH(sjlj)     &&\
       !PTH_MCTX_DSP(sjljlx)  &&\
       !PTH_MCTX_DSP(sjljisc) &&\
@@ -100,11 +100,48 @@ intern void pth_scheduler_kill(void)
     /* remove the internal signal pipe */
     close(pth_gctx_get()->pth_sigpipe[0]);
     close(pth_gctx_get()->pth_sigpipe[1]);
+
+    /* remove the epoll instance and its result buffer */
+    if (pth_gctx_get()->main_efd >= 0) {
+        close(pth_gctx_get()->main_efd);
+        pth_gctx_get()->main_efd = -1;
+    }
+    pth_gctx_get()->main_efd_nfds = 0;
+    pth_gctx_get()->main_efd_ntimers = 0;
+    if (pth_gctx_get()->main_efd_fds != NULL) {
+        free(pth_gctx_get()->main_efd_fds);
+        pth_gctx_get()->main_efd_fds = NULL;
+        pth_gctx_get()->main_efd_fds_size = 0;
+    }
+    if (pth_gctx_get()->pth_evbuf != NULL) {
+        free(pth_gctx_get()->pth_evbuf);
+        pth_gctx_get()->pth_evbuf = NULL;
+        pth_gctx_get()->pth_evbuf_size = 0;
+    }
     return;
 }
 
+/* get the result buffer for epoll_wait(), grown to hold at least n events */
+static struct epoll_event *pth_sched_evbuf(int n)
+{
+    struct epoll_event *evbuf;
+    int size;
+
+    if (n <= pth_gctx_get()->pth_evbuf_size)
+        return pth_gctx_get()->pth_evbuf;
+
+    size = pth_gctx_get()->pth_evbuf_size > 0 ? pth_gctx_get()->pth_evbuf_size : 16;
+    while (size < n)
+        size *= 2;
+    if ((evbuf = realloc(pth_gctx_get()->pth_evbuf, size * sizeof(struct epoll_event))) == NULL)
+        return NULL;
+    pth_gctx_get()->pth_evbuf = evbuf;
+    pth_gctx_get()->pth_evbuf_size = size;
+    return evbuf;
+}
+
 
-static int pth_sched_check_pth_events(pth_t t) {
+static int pth_sched_check_pth_events(pth_t t, pth_time_t *now, unsigned long pass) {
     if(!t || !t->events) {
         return 0;
     }
@@ -114,12 +151,27 @@ static int pth_sched_check_pth_events(pth_t t) {
     do {
         if (ev->ev_status == PTH_STATUS_PENDING) {
             /* decide if it was pending and now occurred.
-             * epoll already told us about FD, TIME, and FUNC type pth events;
-             * here we wait check on other pth event types that epoll does not watch */
+             * epoll already told us about expired timerfds, but only if there
+             * were fds worth asking it about, so we check timers by the clock */
             int did_occur = FALSE;
 
+            /* Filedescriptor I/O */
+            if (ev->ev_type == PTH_EVENT_FD) {
+                if (pth_event_fd_occurred(ev, pass))
+                    did_occur = TRUE;
+            }
+            /* Timer */
+            else if (ev->ev_type == PTH_EVENT_TIME) {
+                if (pth_time_cmp(&(ev->ev_args.TIME.tv), now) <= 0)
+                    did_occur = TRUE;
+            }
+            /* Custom Event Function, whose timer fires right away */
+            else if (ev->ev_type == PTH_EVENT_FUNC) {
+                if (pth_time_cmp(&(ev->ev_args.FUNC.tv), now) <= 0)
+                    did_occur = TRUE;
+            }
             /* Message Port Arrivals */
-            if (ev->ev_type == PTH_EVENT_MSG) {
+            else if (ev->ev_type == PTH_EVENT_MSG) {
                 if (pth_ring_elements(&(ev->ev_args.MSG.mp->mp_queue)) > 0)
                     did_occur = TRUE;
             }
@@ -219,47 +271,22 @@ static void pth_sched_eventmanager_async(pth_time_t *now) {
         return;
     }
 
-    /* check for events without blocking!! */
-    struct epoll_event* events_ready = calloc(100, sizeof(struct epoll_event));
-    int n_events_ready = pth_sc(epoll_wait)(pth_gctx_get()->main_efd, events_ready, 100, 0);
+    /* check for events without blocking!! pth_wait() registered the fds of all
+       waiting events, so without any there is nothing epoll could tell us that
+       the clock does not. no timers are registered in async mode. */
+    int nfds = pth_gctx_get()->main_efd_nfds;
+    struct epoll_event* events_ready = NULL;
+    int n_events_ready = 0;
+    unsigned long pass = ++pth_gctx_get()->main_efd_pass;
+    if (nfds > 0 && (events_ready = pth_sched_evbuf(nfds)) != NULL) {
+        n_events_ready = pth_sc(epoll_wait)(pth_gctx_get()->main_efd, events_ready, nfds, 0);
+    }
 
-    /* mark events based on the status we got from epoll */
+    /* note the fds that epoll reported */
     for(int i = 0; i < n_events_ready; i++) {
-        pth_event_t ev = (pth_event_t) events_ready[i].data.ptr;
-        if(!ev) {
-            continue;
-        }
-
-        /* Filedescriptor I/O */
-        if (ev->ev_type == PTH_EVENT_FD) {
-            if (((ev->ev_goal & PTH_UNTIL_FD_READABLE) && (events_ready[i].events & EPOLLIN)) ||
-                ((ev->ev_goal & PTH_UNTIL_FD_WRITEABLE) && (events_ready[i].events & EPOLLOUT)) ||
-                ((ev->ev_goal & PTH_UNTIL_FD_EXCEPTION) && (events_ready[i].events & EPOLLERR))) {
-                ev->ev_status = PTH_STATUS_OCCURRED;
-            }
-        }
-        /* Timer */
-        else if (ev->ev_type == PTH_EVENT_TIME) {
-            uint64_t n_expirations = 0;
-            ssize_t rc = pth_sc(read)(ev->ev_args.TIME.fd, &n_expirations, 8);
-            if(rc > 0 && n_expirations > 0) {
-                ev->ev_status = PTH_STATUS_OCCURRED;
-            }
-        }
-        /* Custom Event Function */
-        else if (ev->ev_type == PTH_EVENT_FUNC) {
-            uint64_t n_expirations = 0;
-            ssize_t rc = pth_sc(read)(ev->ev_args.FUNC.fd, &n_expirations, 8);
-            if(rc > 0 && n_expirations > 0) {
-                ev->ev_status = PTH_STATUS_OCCURRED;
-            }
-        }
+        pth_event_epoll_ready(&events_ready[i], pass);
     }
 
-    /* cleanup */
-    free(events_ready);
-    events_ready = NULL;
-
     /* now comes the final cleanup loop where we've to do two jobs:
      * 1 handle all pth event types for all threads
      * 2 move threads with occurred events from the waiting queue to the ready queue */
@@ -268,7 +295,7 @@ static void pth_sched_eventmanager_async(pth_time_t *now) {
     while (t != NULL) {
         /* do the late handling of the fd I/O and signal
            events in the waiting event ring */
-        int n_events_occurred = pth_sched_check_pth_events(t);
+        int n_events_occurred = pth_sched_check_pth_events(t, now, pass);
 
         /* cancellation support */
         if (t->cancelreq == TRUE) {
@@ -568,24 +595,6 @@ intern void *pth_scheduler(void *dummy)
     return NULL;
 }
 
-static int rpth_epoll_ctl_helper(int epollfd, int op, int fd, void* data, uint32_t evset) {
-    struct epoll_event* epollev = calloc(1, sizeof(struct epoll_event));
-    epollev->events = evset;
-    epollev->data.ptr = data;
-    int ret = epoll_ctl(epollfd, op, fd, epollev);
-    free(epollev);
-    if(ret == 0) {
-        /* all good, 1 fd got added */
-        return 1;
-    } else if(ret < 0 && errno == EEXIST) {
-        /* this didnt get added because it was already there */
-        return 0;
-    } else {
-        /* this didnt get added because of some other error */
-        return -1;
-    }
-}
-
 /*
  * Look whether some events already occurred (or failed) and move
  * corresponding threads from waiting queue back to ready queue.
@@ -609,8 +618,10 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     int loop_repeat;
     int n_events_ready;
     int sig;
-    int epollfd;
-    int nepollevs;
+    int nfds;
+    int i;
+    unsigned long pass;
+    struct epoll_event *readyevs;
 
     pth_debug2("pth_sched_eventmanager: enter in %s mode",
                dopoll ? "polling" : "waiting");
@@ -619,14 +630,6 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     loop_entry:
     loop_repeat = FALSE;
 
-    /* initialize epoll */
-    nepollevs = 0;
-    epollfd = epoll_create(1);
-    if(epollfd < 0) {
-        pth_debug2("pth_sched_eventmanager: epoll_create failed: error %d", errno);
-        abort(); // FIXME how to handle error here?
-    }
-
     /* initialize signal status */
     sigpending(&pth_gctx_get()->pth_sigpending);
     sigfillset(&pth_gctx_get()->pth_sigblock);
@@ -664,24 +667,7 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
                 /* Filedescriptor I/O */
                 if (ev->ev_type == PTH_EVENT_FD) {
                     /* filedescriptors are checked later all at once.
-                       Here we only track them in the epoll instance. */
-                    uint32_t evset = 0;
-                    if (ev->ev_goal & PTH_UNTIL_FD_READABLE)
-                        evset |= EPOLLIN;
-                    if (ev->ev_goal & PTH_UNTIL_FD_WRITEABLE)
-                        evset |= EPOLLOUT;
-                    if (ev->ev_goal & PTH_UNTIL_FD_EXCEPTION)
-                        evset |= EPOLLERR;
-                    if(evset != 0) {
-                        int retval = rpth_epoll_ctl_helper(epollfd, (int)EPOLL_CTL_ADD, ev->ev_args.FD.fd, ev, evset);
-                        if(retval < 0) {
-                            ev->ev_status = PTH_STATUS_FAILED;
-                            pth_debug3("pth_sched_eventmanager: "
-                                       "[I/O] event failed for thread \"%s\" fd %d", t->name, ev->ev_args.FD.fd);
-                        } else {
-                            nepollevs++;
-                        }
-                    }
+                       pth_wait() already tracks them in the epoll instance. */
                 }
                 /* Signal Set */
                 else if (ev->ev_type == PTH_EVENT_SIGS) {
@@ -784,11 +770,13 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     if (any_occurred)
         dopoll = TRUE;
 
-    /* clear pipe and let select() wait for the read-part of the pipe */
+    /* clear pipe and let epoll wait for the read-part of the pipe, which
+       is registered in the epoll instance next to the event fds */
     while (pth_sc(read)(pth_gctx_get()->pth_sigpipe[0], minibuf, sizeof(minibuf)) > 0) ;
-    nepollevs += rpth_epoll_ctl_helper(epollfd, (int)EPOLL_CTL_ADD, pth_gctx_get()->pth_sigpipe[0], NULL, (uint32_t)EPOLLIN);
+    nfds = pth_gctx_get()->main_efd_nfds + pth_gctx_get()->main_efd_ntimers + 1;
+    readyevs = NULL;
+    pass = ++pth_gctx_get()->main_efd_pass;
 
-    struct epoll_event* readyevs = calloc(nepollevs, sizeof(struct epoll_event));
     int epoll_timeout;
 
     if (dopoll) {
@@ -827,9 +815,14 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
     /* now decide how and do the polling for fd I/O and timers
        WHEN THE SCHEDULER SLEEPS AT ALL, THEN HERE!! */
     n_events_ready = -1;
-    if (!(dopoll && nepollevs == 0))
-        while ((n_events_ready = pth_sc(epoll_wait)(epollfd, readyevs, nepollevs, epoll_timeout)) < 0
+    if (!(dopoll && pth_gctx_get()->main_efd_nfds == 0)) {
+        if ((readyevs = pth_sched_evbuf(nfds)) == NULL) {
+            pth_debug1("pth_sched_eventmanager: unable to allocate the epoll buffer");
+            abort();
+        }
+        while ((n_events_ready = pth_sc(epoll_wait)(pth_gctx_get()->main_efd, readyevs, nfds, epoll_timeout)) < 0
                && errno == EINTR) ;
+    }
 
     /* restore signal mask and actions and handle signals */
     pth_sc(sigprocmask)(SIG_SETMASK, &oss, NULL);
@@ -852,74 +845,16 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         }
     }
 
-    /* if an error occurred, avoid confusion in the cleanup loop */
-    if (n_events_ready <= 0) {
-        memset(readyevs, 0, nepollevs * sizeof(struct epoll_event));
-    }
-
     /* now comes the final cleanup loop where we've to
        do two jobs: first we've to do the late handling of the fd I/O events and
        additionally if a thread has one occurred event, we move it from the
        waiting queue to the ready queue */
 
-    /* set occurred events */
-    int i = 0;
-    ev = NULL;
-    for(i = 0; i < n_events_ready; i++) {
-        /* get the pth event that we stored here earlier */
-		struct epoll_event* readyev = &readyevs[i];
-        ev = (pth_event_t)readyev->data.ptr;
-
-        if(!ev) {
-//            /* if the internal signal pipe was used, adjust the select() results */
-//            if (!dopoll && rc > 0 && FD_ISSET(pth_gctx_get()->pth_sigpipe[0], &rfds)) {
-//                FD_CLR(pth_gctx_get()->pth_sigpipe[0], &rfds);
-//                rc--;
-//            }
-            continue;
-        }
-
-        /*
-         * Late handling for still not occurred events
-         */
-        if (ev->ev_status == PTH_STATUS_PENDING) {
-            /* Filedescriptor I/O */
-            if (ev->ev_type == PTH_EVENT_FD) {
-                if (((ev->ev_goal & PTH_UNTIL_FD_READABLE) && (readyev->events & EPOLLIN)) ||
-                    ((ev->ev_goal & PTH_UNTIL_FD_WRITEABLE) && (readyev->events & EPOLLOUT)) ||
-                    ((ev->ev_goal & PTH_UNTIL_FD_EXCEPTION) && (readyev->events & EPOLLERR))) {
-                    ev->ev_status = PTH_STATUS_OCCURRED;
-                }
-            }
-            /* Signal Set */
-            else if (ev->ev_type == PTH_EVENT_SIGS) {
-                for (sig = 1; sig < PTH_NSIG; sig++) {
-                    if (sigismember(ev->ev_args.SIGS.sigs, sig)) {
-                        if (sigismember(&pth_gctx_get()->pth_sigraised, sig)) {
-                            if (ev->ev_args.SIGS.sig != NULL)
-                                *(ev->ev_args.SIGS.sig) = sig;
-                            sigdelset(&pth_gctx_get()->pth_sigraised, sig);
-                            ev->ev_status = PTH_STATUS_OCCURRED;
-                        }
-                    }
-                }
-            }
-        }
-        /*
-         * post-processing for already occurred events
-         */
-        else {
-            /* Condition Variable Signal */
-            if (ev->ev_type == PTH_EVENT_COND) {
-                /* clean signal */
-                if (ev->ev_args.COND.cond->cn_state & PTH_COND_SIGNALED) {
-                    ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_SIGNALED);
-                    ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_BROADCAST);
-                    ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_HANDLED);
-                }
-            }
-        }
-    }
+    /* note the fds that epoll reported. timers are in the epoll instance as
+       timerfds, but we check them against the time above, so this just
+       consumes their expirations. */
+    for (i = 0; i < n_events_ready; i++)
+        pth_event_epoll_ready(&readyevs[i], pass);
 
     /* for all threads in the waiting queue... */
     t = pth_pqueue_head(&pth_gctx_get()->pth_WQ);
@@ -930,6 +865,44 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         if (t->events != NULL) {
             ev = evh = t->events;
             do {
+                /*
+                 * Late handling for still not occurred events
+                 */
+                if (ev->ev_status == PTH_STATUS_PENDING) {
+                    /* Filedescriptor I/O */
+                    if (ev->ev_type == PTH_EVENT_FD) {
+                        if (pth_event_fd_occurred(ev, pass))
+                            ev->ev_status = PTH_STATUS_OCCURRED;
+                    }
+                    /* Signal Set */
+                    else if (ev->ev_type == PTH_EVENT_SIGS) {
+                        for (sig = 1; sig < PTH_NSIG; sig++) {
+                            if (sigismember(ev->ev_args.SIGS.sigs, sig)) {
+                                if (sigismember(&pth_gctx_get()->pth_sigraised, sig)) {
+                                    if (ev->ev_args.SIGS.sig != NULL)
+                                        *(ev->ev_args.SIGS.sig) = sig;
+                                    sigdelset(&pth_gctx_get()->pth_sigraised, sig);
+                                    ev->ev_status = PTH_STATUS_OCCURRED;
+                                }
+                            }
+                        }
+                    }
+                }
+                /*
+                 * post-processing for already occurred events
+                 */
+                else {
+                    /* Condition Variable Signal */
+                    if (ev->ev_type == PTH_EVENT_COND) {
+                        /* clean signal */
+                        if (ev->ev_args.COND.cond->cn_state & PTH_COND_SIGNALED) {
+                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_SIGNALED);
+                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_BROADCAST);
+                            ev->ev_args.COND.cond->cn_state &= ~(PTH_COND_HANDLED);
+                        }
+                    }
+                }
+
                 /* local to global mapping */
                 if (ev->ev_status != PTH_STATUS_PENDING) {
                     pth_debug2("pth_sched_eventmanager: event occurred for thread \"%s\"", t->name);
@@ -965,11 +938,6 @@ intern void pth_sched_eventmanager(pth_time_t *now, int dopoll)
         }
     }
 
-    if(epollfd > -1)
-        close(epollfd);
-    if(readyevs)
-        free(readyevs);
-
     /* perhaps we have to internally loop... */
     if (loop_repeat) {
         pth_time_set(now, PTH_TIME_NOW);
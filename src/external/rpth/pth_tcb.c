@@ -106,6 +106,144 @@ intern const char *pth_state_names[] = {
 #include <valgrind/valgrind.h>
 #endif
 
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#if !defined(MAP_STACK)
+#define MAP_STACK 0
+#endif
+
+/* maximum number of free stacks kept per OS thread */
+#define PTH_STACK_POOL_MAX 256
+
+    /* a free stack waiting in the pool, stored at its own lowest address */
+struct pth_stack_st {
+    struct pth_stack_st *next;
+    unsigned int         size;
+};
+
+    /* stacks are mapped by and recycled within the OS thread that runs the
+       scheduler, so the pool needs no locking. only threads that enabled the
+       pool keep stacks in it, and only until they drain it, so no stack is
+       left behind in the pool of a thread that never drains it again. */
+static __thread struct pth_stack_st *pth_stack_pool = NULL;
+static __thread int pth_stack_pool_count = 0;
+static __thread int pth_stack_pool_enabled = FALSE;
+
+    /* each guarded stack costs the kernel two memory mappings, and a process
+       may only have vm.max_map_count of them (65530 by default). once we run
+       out, new stacks are mapped without a guard page so that they merge with
+       their neighbours instead of taking up mappings of their own. */
+static int pth_stack_guards_failed = FALSE;
+
+static size_t pth_stack_pagesize(void)
+{
+    static size_t pagesize = 0;
+    if (pagesize == 0)
+        pagesize = (size_t)sysconf(_SC_PAGESIZE);
+    return pagesize;
+}
+
+/* map a new stack of the (page aligned) size, behind a PROT_NONE guard page
+   on the side the stack grows towards, so an overflow faults immediately.
+   the guard page is always part of the mapping, but stays accessible if we
+   ran out of mappings to split off for it. */
+static char *pth_stack_map(unsigned int stacksize)
+{
+    size_t pagesize = pth_stack_pagesize();
+    char *map;
+    char *guard;
+    char *stack;
+
+    map = (char *)mmap(NULL, (size_t)stacksize + pagesize, PROT_READ|PROT_WRITE,
+                       MAP_PRIVATE|MAP_ANONYMOUS|MAP_STACK, -1, 0);
+    if (map == (char *)MAP_FAILED)
+        return NULL;
+#if PTH_STACKGROWTH < 0
+    guard = map;
+    stack = map + pagesize;
+#else
+    guard = map + stacksize;
+    stack = map;
+#endif
+    if (!pth_stack_guards_failed && mprotect(guard, pagesize, PROT_NONE) != 0) {
+        if (errno != ENOMEM) {
+            munmap(map, (size_t)stacksize + pagesize);
+            return NULL;
+        }
+        pth_stack_guards_failed = TRUE;
+        pth_debug1("pth_stack_map: out of memory mappings, stacks are no longer guarded");
+    }
+    return stack;
+}
+
+static void pth_stack_unmap(char *stack, unsigned int stacksize)
+{
+    size_t pagesize = pth_stack_pagesize();
+#if PTH_STACKGROWTH < 0
+    munmap(stack - pagesize, (size_t)stacksize + pagesize);
+#else
+    munmap(stack, (size_t)stacksize + pagesize);
+#endif
+}
+
+/* get a stack of the (page aligned) size, reusing a pooled one if possible */
+static char *pth_stack_get(unsigned int stacksize)
+{
+    struct pth_stack_st **sp;
+    struct pth_stack_st *s;
+
+    for (sp = &pth_stack_pool; *sp != NULL; sp = &(*sp)->next) {
+        if ((*sp)->size == stacksize) {
+            s = *sp;
+            *sp = s->next;
+            pth_stack_pool_count--;
+            s->next = NULL;
+            s->size = 0;
+            return (char *)s;
+        }
+    }
+    return pth_stack_map(stacksize);
+}
+
+/* return a stack to the pool, or unmap it if the pool is full or disabled */
+static void pth_stack_put(char *stack, unsigned int stacksize)
+{
+    struct pth_stack_st *s;
+
+    if (!pth_stack_pool_enabled || pth_stack_pool_count >= PTH_STACK_POOL_MAX) {
+        pth_stack_unmap(stack, stacksize);
+        return;
+    }
+    s = (struct pth_stack_st *)stack;
+    s->size = stacksize;
+    s->next = pth_stack_pool;
+    pth_stack_pool = s;
+    pth_stack_pool_count++;
+}
+
+/* let the calling OS thread keep freed stacks for reuse until it drains them */
+void pth_stack_pool_enable(void)
+{
+    pth_stack_pool_enabled = TRUE;
+}
+
+/* unmap all stacks pooled by the calling OS thread, and stop pooling */
+void pth_stack_pool_drain(void)
+{
+    struct pth_stack_st *s;
+
+    pth_stack_pool_enabled = FALSE;
+
+    while ((s = pth_stack_pool) != NULL) {
+        pth_stack_pool = s->next;
+        pth_stack_unmap((char *)s, s->size);
+    }
+    pth_stack_pool_count = 0;
+}
+
 /* allocate a thread control block */
 intern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr)
 {
@@ -113,6 +251,11 @@ intern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr)
 
     if (stacksize > 0 && stacksize < SIGSTKSZ)
         stacksize = SIGSTKSZ;
+    if (stacksize > 0 && stackaddr == NULL) {
+        /* own stacks are whole pages so they can be guarded and pooled */
+        size_t pagesize = pth_stack_pagesize();
+        stacksize = (unsigned int)(((size_t)stacksize + pagesize - 1) & ~(pagesize - 1));
+    }
     if ((t = (pth_t)calloc(1, sizeof(struct pth_st))) == NULL)
         return NULL;
 
@@ -126,7 +269,7 @@ intern pth_t pth_tcb_alloc(unsigned int stacksize, void *stackaddr)
         if (stackaddr != NULL)
             t->stack = (char *)(stackaddr);
         else {
-            if ((t->stack = (char *)calloc(1, stacksize)) == NULL) {
+            if ((t->stack = pth_stack_get(stacksize)) == NULL) {
                 pth_shield { free(t); }
                 return NULL;
             }
@@ -156,12 +299,8 @@ intern void pth_tcb_free(pth_t t)
 {
     if (t == NULL)
         return;
-    if (t->stack != NULL && !t->stackloan) {
-        if(t->stacksize > 0) {
-            memset(t->stack, 0, (size_t)t->stacksize);
-        }
-        free(t->stack);
-    }
+    if (t->stack != NULL && !t->stackloan)
+        pth_stack_put(t->stack, t->stacksize);
     if (t->data_value != NULL)
         free(t->data_value);
     if (t->cleanups != NULL)
@@ -0,0 +1,108 @@
+/*
+**  GNU Pth - The GNU Portable Threads
+**  Copyright (c) 1999-2006 Ralf S. Engelschall <rse@engelschall.com>
+**
+**  This file is part of GNU Pth, a non-preemptive thread scheduling
+**  library which can be found at http://www.gnu.org/software/pth/.
+**
+**  This library is free software; you can redistribute it and/or
+**  modify it under the terms of the GNU Lesser General Public
+**  License as published by the Free Software Foundation; either
+**  version 2.1 of the License, or (at your option) any later version.
+**
+**  This library is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+**  Lesser General Public License for more details.
+**
+**  You should have received a copy of the GNU Lesser General Public
+**  License along with this library; if not, write to the Free Software
+**  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+**  USA, or contact Ralf S. Engelschall <rse@engelschall.com>.
+**
+**  test_mctx.c: Pth test program (machine context switch benchmark)
+*/
+                             /* ``Premature optimization is the
+                                  root of all evil -- but measure.'' */
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "rpth.h"
+
+#define SWITCHES 1000000
+
+/* the mctx method this library was configured with, e.g. "asm/asm/none" */
+#ifndef PTH_MCTX_ID
+#define PTH_MCTX_ID "unknown"
+#endif
+
+static pth_uctx_t uctx_main;
+static pth_uctx_t uctx_peer;
+static volatile long peer_switches;
+
+static double now(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+static void peer(void *arg)
+{
+    for (;;) {
+        peer_switches++;
+        pth_uctx_switch(uctx_peer, uctx_main);
+    }
+}
+
+static void *yielder(void *arg)
+{
+    long i;
+    for (i = 0; i < SWITCHES; i++)
+        pth_yield(NULL);
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    double start, elapsed;
+    pth_t t1, t2;
+    long i;
+
+    pth_init();
+
+    fprintf(stderr, "This is TEST_MCTX, a Pth test measuring context switches.\n");
+    fprintf(stderr, "mctx implementation: %s\n", PTH_MCTX_ID);
+    fprintf(stderr, "\n");
+
+    /* raw machine context switches between two user-space contexts */
+    pth_uctx_create(&uctx_main);
+    pth_uctx_create(&uctx_peer);
+    pth_uctx_make(uctx_peer, NULL, 64*1024, NULL, peer, NULL, NULL);
+
+    start = now();
+    for (i = 0; i < SWITCHES; i++)
+        pth_uctx_switch(uctx_main, uctx_peer);
+    elapsed = now() - start;
+
+    if (peer_switches != SWITCHES) {
+        fprintf(stderr, "uctx: ERROR: peer ran %ld times instead of %d\n", peer_switches, SWITCHES);
+        return 1;
+    }
+    fprintf(stderr, "uctx switches:  %10.0f per second\n", (2.0 * SWITCHES) / elapsed);
+
+    /* thread switches through the scheduler, like process_continue does */
+    start = now();
+    t1 = pth_spawn(PTH_ATTR_DEFAULT, yielder, NULL);
+    t2 = pth_spawn(PTH_ATTR_DEFAULT, yielder, NULL);
+    pth_join(t1, NULL);
+    pth_join(t2, NULL);
+    elapsed = now() - start;
+    fprintf(stderr, "thread yields:  %10.0f per second\n", (2.0 * SWITCHES) / elapsed);
+
+    pth_uctx_destroy(uctx_peer);
+    pth_uctx_destroy(uctx_main);
+    pth_kill();
+    return 0;
+}
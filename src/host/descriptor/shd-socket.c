@@ -86,6 +86,9 @@ void socket_init(Socket* socket, SocketFunctionTable* vtable, DescriptorType typ
     socket->outputBuffer = g_queue_new();
     socket->outputBufferSize = sendBufferSize;
 
+    socket->sendLinks[SOCKET_SEND_LINK_LOOPBACK].socket = socket;
+    socket->sendLinks[SOCKET_SEND_LINK_ETHERNET].socket = socket;
+
     Tracker* tracker = host_getTracker(worker_getCurrentHost());
     Descriptor* descriptor = (Descriptor *)socket;
     tracker_addSocket(tracker, descriptor->handle, socket->protocol, socket->inputBufferSize, socket->outputBufferSize);
@@ -162,6 +165,12 @@ void socket_setPeerName(Socket* socket, in_addr_t ip, in_port_t port) {
     socket->peerIP = ip;
     socket->peerPort = port;
 
+    /* the cached route is for the old peer */
+    socket->routeSourceIP = 0;
+    socket->routeDestinationIP = 0;
+    socket->routeDestination = NULL;
+    socket->routePath = NULL;
+
     /* store the new ascii name of this peer */
     if(socket->peerString) {
         g_free(socket->peerString);
@@ -361,6 +370,43 @@ Packet* socket_removeFromInputBuffer(Socket* socket) {
     return packet;
 }
 
+static void _socket_routePacket(Socket* socket, Packet* packet) {
+    MAGIC_ASSERT(socket);
+
+    /* we only cache the route of the connected flow */
+    in_addr_t destinationIP = packet_getDestinationIP(packet);
+    if(socket->peerIP == 0 || destinationIP != socket->peerIP ||
+            destinationIP == htonl(INADDR_LOOPBACK)) {
+        return;
+    }
+
+    in_addr_t sourceIP = packet_getSourceIP(packet);
+    if(sourceIP == destinationIP) {
+        return;
+    }
+
+    if(sourceIP != socket->routeSourceIP || destinationIP != socket->routeDestinationIP) {
+        /* first packet to this peer, resolve the route once for the whole flow */
+        socket->routeSourceIP = sourceIP;
+        socket->routeDestinationIP = destinationIP;
+
+        Address* srcAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) sourceIP);
+        Address* dstAddress = dns_resolveIPToAddress(worker_getDNS(), (guint32) destinationIP);
+
+        if(srcAddress && dstAddress) {
+            socket->routeDestination = dstAddress;
+            socket->routePath = topology_getPath(worker_getTopology(), srcAddress, dstAddress);
+        } else {
+            socket->routeDestination = NULL;
+            socket->routePath = NULL;
+        }
+    }
+
+    if(socket->routeDestination && socket->routePath) {
+        packet_setRoute(packet, socket->routeDestination, socket->routePath);
+    }
+}
+
 gboolean socket_addToOutputBuffer(Socket* socket, Packet* packet) {
     MAGIC_ASSERT(socket);
 
@@ -370,10 +416,14 @@ gboolean socket_addToOutputBuffer(Socket* socket, Packet* packet) {
         return FALSE;
     }
 
+    /* attach the cached route so the worker need not look it up again */
+    _socket_routePacket(socket, packet);
+
     /* add to our queue */
     g_queue_push_tail(socket->outputBuffer, packet);
     socket->outputBufferLength += length;
     packet_addDeliveryStatus(packet, PDS_SND_SOCKET_BUFFERED);
+    packet_setBufferedTime(packet, worker_getCurrentTime());
 
     /* update the tracker input buffer stats */
     Tracker* tracker = host_getTracker(worker_getCurrentHost());
@@ -34,6 +34,38 @@ enum SocketFlags {
     SF_UNIX_BOUND = 1 << 2,
 };
 
+enum SocketSendLinkFlags {
+    SSL_NONE = 0,
+    /* linked into the send queue of the interface */
+    SSL_QUEUED = 1 << 0,
+    /* a new flow in the fq_codel queuing discipline */
+    SSL_NEW_FLOW = 1 << 1,
+    /* codel is dropping packets from this flow */
+    SSL_DROPPING = 1 << 2,
+};
+
+/* the state a network interface keeps for a socket waiting to send. a socket
+ * bound to any address may wait at the loopback and ethernet interfaces at the
+ * same time, so it has one link for each. */
+typedef struct _SocketSendLink SocketSendLink;
+struct _SocketSendLink {
+    Socket* socket;
+    SocketSendLink* next;
+    enum SocketSendLinkFlags flags;
+
+    /* bytes the socket may still send this round (drr and fq_codel) */
+    gint64 deficit;
+
+    /* codel control state (rfc 8289) */
+    SimulationTime firstAboveTime;
+    SimulationTime dropNext;
+    guint dropCount;
+    guint lastDropCount;
+};
+
+#define SOCKET_SEND_LINK_LOOPBACK 0
+#define SOCKET_SEND_LINK_ETHERNET 1
+
 struct _Socket {
     Transport super;
     SocketFunctionTable* vtable;
@@ -53,6 +85,13 @@ struct _Socket {
 
     gint associationKey;
 
+    /* the route to our connected peer, resolved on the first packet of the flow and
+     * then attached to every outgoing packet so the worker can skip the lookups */
+    in_addr_t routeSourceIP;
+    in_addr_t routeDestinationIP;
+    Address* routeDestination;
+    Path* routePath;
+
     /* buffering packets readable by user */
     GQueue* inputBuffer;
     gsize inputBufferSize;
@@ -65,6 +104,9 @@ struct _Socket {
     gsize outputBufferSizePending;
     gsize outputBufferLength;
 
+    /* links for the send queues of the loopback and ethernet interfaces */
+    SocketSendLink sendLinks[2];
+
     MAGIC_DECLARE;
 };
 
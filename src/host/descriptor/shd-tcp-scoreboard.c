@@ -14,23 +14,24 @@ enum _BlockStatus {
     BLOCK_STATUS_RETRANSMITTED,
 };
 
+/* a range of consecutive packets that share the same state. retransmitted
+ * packets each have their own id, so they are never merged. */
 typedef struct _ScoreBoardBlock ScoreBoardBlock;
 struct _ScoreBoardBlock {
-    /* sequence number of the block/packet */
-    gint sequence;
+    /* sequence numbers of the blocks/packets, [start, end) */
+    gint start;
+    gint end;
     /* sequence of the next packet to be sent */
     gint nextSend;
     /* retransmission id if the packet has been retransmitted */
     gint retransmissionId;
     /* status of the block */
     BlockStatus status;
-
-    MAGIC_DECLARE;
 };
 
 struct _ScoreBoard {
-    /* list of blocks in the scoreboard */
-    GQueue* blocksQ;
+    /* blocks in the scoreboard, sorted by sequence and never overlapping */
+    GArray* blocks;
 
     /* the furthest SACKed sequence number */
     gint fack;
@@ -48,38 +49,13 @@ struct _ScoreBoard {
     MAGIC_DECLARE;
 };
 
-static ScoreBoardBlock* _scoreboardblock_new(gint sequence, BlockStatus status) {
-    ScoreBoardBlock* block = g_new0(ScoreBoardBlock, 1);
-    MAGIC_INIT(block);
-    block->sequence = sequence;
-    block->status = status;
-
-    return block;
-}
-
-static gint _scoreboardblock_compareStatus(ScoreBoardBlock* block1, ScoreBoardBlock* block2) {
-    return (block1->status < block2->status ? -1 : block1->status > block2->status ? 1 : 0);
-}
-
-static gint _scoreboardblock_compareSequence(ScoreBoardBlock* block1, ScoreBoardBlock* block2) {
-    return (block1->sequence < block2->sequence ? -1 : block1->sequence > block2->sequence ? 1 : 0);
-}
-
-static gint _scoreboardblock_compareSequenceData(ScoreBoardBlock* block1, ScoreBoardBlock* block2, gpointer userData) {
-    return _scoreboardblock_compareSequence(block1, block2);
-}
-
-static void _scoreboardblock_free(ScoreBoardBlock* block) {
-    MAGIC_ASSERT(block);
-    MAGIC_CLEAR(block);
-    g_free(block);
-}
+#define _BLOCK(scoreboard, index) (&g_array_index((scoreboard)->blocks, ScoreBoardBlock, (index)))
 
 ScoreBoard* scoreboard_new() {
     ScoreBoard* scoreboard = g_new0(ScoreBoard, 1);
     MAGIC_INIT(scoreboard);
 
-    scoreboard->blocksQ = g_queue_new();
+    scoreboard->blocks = g_array_new(FALSE, FALSE, sizeof(ScoreBoardBlock));
 
     return scoreboard;
 }
@@ -92,38 +68,98 @@ void scoreboard_clear(ScoreBoard* scoreboard) {
     scoreboard->fack = 0;
     scoreboard->fackOut = 0;
 
-    /* reset the blocks queue */
-    if(scoreboard->blocksQ) {
-        g_queue_free_full(scoreboard->blocksQ, (GDestroyNotify)_scoreboardblock_free);
-        scoreboard->blocksQ = g_queue_new();
-    }
+    /* reset the blocks */
+    g_array_set_size(scoreboard->blocks, 0);
 }
 
 void scoreboard_free(ScoreBoard* scoreboard) {
     MAGIC_ASSERT(scoreboard);
     scoreboard_clear(scoreboard);
-    g_queue_free(scoreboard->blocksQ);
+    g_array_free(scoreboard->blocks, TRUE);
     MAGIC_CLEAR(scoreboard);
     g_free(scoreboard);
 }
 
-static ScoreBoardBlock* _scoreboard_addBlock(ScoreBoard* scoreboard, gint sequence, BlockStatus status) {
-    MAGIC_ASSERT(scoreboard);
+/* index of the first block that ends after the sequence, which is the block
+ * holding the sequence if there is one */
+static guint _scoreboard_search(ScoreBoard* scoreboard, gint sequence) {
+    guint low = 0;
+    guint high = scoreboard->blocks->len;
+    while(low < high) {
+        guint mid = low + (high - low) / 2;
+        if(_BLOCK(scoreboard, mid)->end <= sequence) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
 
-    ScoreBoardBlock* block = _scoreboardblock_new(sequence, status);
-    g_queue_insert_sorted(scoreboard->blocksQ, block, (GCompareDataFunc) _scoreboardblock_compareSequenceData, NULL);
+static gint _scoreboard_findBlock(ScoreBoard* scoreboard, gint sequence) {
+    MAGIC_ASSERT(scoreboard);
 
-    return block;
+    guint index = _scoreboard_search(scoreboard, sequence);
+    if(index < scoreboard->blocks->len && _BLOCK(scoreboard, index)->start <= sequence) {
+        return (gint)index;
+    }
+    return -1;
 }
 
-static ScoreBoardBlock* _scoreboard_findBlock(ScoreBoard* scoreboard, gint sequence) {
+static void _scoreboard_addBlock(ScoreBoard* scoreboard, gint start, gint end, BlockStatus status) {
     MAGIC_ASSERT(scoreboard);
 
-    ScoreBoardBlock b;
-    b.sequence = sequence;
-    GList* link = g_queue_find_custom(scoreboard->blocksQ, &b, (GCompareFunc)_scoreboardblock_compareSequence);
+    ScoreBoardBlock block = {0};
+    block.start = start;
+    block.end = end;
+    block.status = status;
+
+    g_array_insert_val(scoreboard->blocks, _scoreboard_search(scoreboard, start), block);
+}
+
+/* split the block at index so that a new block begins at sequence */
+static void _scoreboard_splitBlock(ScoreBoard* scoreboard, guint index, gint sequence) {
+    ScoreBoardBlock upper = *_BLOCK(scoreboard, index);
+    utility_assert(upper.start < sequence && sequence < upper.end);
+
+    _BLOCK(scoreboard, index)->end = sequence;
+    upper.start = sequence;
+    g_array_insert_val(scoreboard->blocks, index + 1, upper);
+}
 
-    return link ? (ScoreBoardBlock*)link->data : NULL;
+/* split blocks as needed so that a block holding sequence starts and ends there,
+ * and return its index */
+static guint _scoreboard_isolate(ScoreBoard* scoreboard, guint index, gint sequence) {
+    if(_BLOCK(scoreboard, index)->start < sequence) {
+        _scoreboard_splitBlock(scoreboard, index, sequence);
+        index++;
+    }
+    if(_BLOCK(scoreboard, index)->end > sequence + 1) {
+        _scoreboard_splitBlock(scoreboard, index, sequence + 1);
+    }
+    return index;
+}
+
+static void _scoreboard_mergeBlocks(ScoreBoard* scoreboard) {
+    /* keep the ranges as few as possible, so updates stay cheap */
+    guint kept = 0;
+    for(guint i = 1; i < scoreboard->blocks->len; i++) {
+        ScoreBoardBlock* last = _BLOCK(scoreboard, kept);
+        ScoreBoardBlock* block = _BLOCK(scoreboard, i);
+
+        if(last->end == block->start && last->status == block->status &&
+                block->status != BLOCK_STATUS_RETRANSMITTED) {
+            last->end = block->end;
+        } else {
+            kept++;
+            if(kept != i) {
+                *_BLOCK(scoreboard, kept) = *block;
+            }
+        }
+    }
+    if(scoreboard->blocks->len > 0) {
+        g_array_set_size(scoreboard->blocks, kept + 1);
+    }
 }
 
 static gchar* _scoreboard_getStatusString(BlockStatus status) {
@@ -140,51 +176,93 @@ static gchar* _scoreboard_getStatusString(BlockStatus status) {
     return "UNKNOWN";
 }
 
-static void _scoreboardblock_appendString(ScoreBoardBlock* block, GString* msg) {
-    g_string_append_printf(msg, " %d (st=%s nxt=%d rtx=%d)", block->sequence, _scoreboard_getStatusString(block->status), block->nextSend, block->retransmissionId);
-}
-
 static void _scoreboard_dump(ScoreBoard* scoreboard) {
     MAGIC_ASSERT(scoreboard);
 
     GString* msg = g_string_new("");
     g_string_append_printf(msg, "[SCOREBOARD] fack=%d ackRtx=%d |", scoreboard->fack, scoreboard->ackedRetransmissionId);
-    g_queue_foreach(scoreboard->blocksQ, (GFunc)_scoreboardblock_appendString, msg);
+    for(guint i = 0; i < scoreboard->blocks->len; i++) {
+        ScoreBoardBlock* block = _BLOCK(scoreboard, i);
+        g_string_append_printf(msg, " %d-%d (st=%s nxt=%d rtx=%d)", block->start, block->end - 1,
+                _scoreboard_getStatusString(block->status), block->nextSend, block->retransmissionId);
+    }
 
     message("%s", msg->str);
     g_string_free(msg, TRUE);
 }
 
-static gint _scoreboard_compareSack(gconstpointer s1, gconstpointer s2) {
-    gint sack1 = GPOINTER_TO_INT(s1);
-    gint sack2 = GPOINTER_TO_INT(s2);
-    return sack1 < sack2 ? -1 : sack1 > sack2 ? 1 : 0;
+static gint _scoreboard_compareSack(const PacketTCPSelectiveACKBlock* s1, const PacketTCPSelectiveACKBlock* s2) {
+    return s1->start < s2->start ? -1 : s1->start > s2->start ? 1 : 0;
 }
 
 static void _scoreboard_removeAcked(ScoreBoard* scoreboard, gint32 unacked) {
     MAGIC_ASSERT(scoreboard);
 
-    /* reconstruct the blocks queue to avoid editing it in-place */
-    GQueue* updatedBlocksQ = g_queue_new();
+    /* blocks are sorted, so the acked ones are all at the front */
+    guint nAcked = 0;
+    while(nAcked < scoreboard->blocks->len && _BLOCK(scoreboard, nAcked)->end <= unacked) {
+        nAcked++;
+    }
+    if(nAcked > 0) {
+        g_array_remove_range(scoreboard->blocks, 0, nAcked);
+    }
+
+    /* the first block may still be partially acked */
+    if(scoreboard->blocks->len > 0 && _BLOCK(scoreboard, 0)->start < unacked) {
+        _BLOCK(scoreboard, 0)->start = unacked;
+    }
+}
 
-    /* keep all blocks that have not been fully ACKed */
-    while(!g_queue_is_empty(scoreboard->blocksQ)) {
-        ScoreBoardBlock* block = g_queue_pop_head(scoreboard->blocksQ);
-        if(block->sequence < ((gint)unacked)) {
-            /* the block has been acked, destroy it */
-            _scoreboardblock_free(block);
+/* add inflight blocks for every sequence in [start, end) we are not tracking yet */
+static gboolean _scoreboard_fillGaps(ScoreBoard* scoreboard, gint start, gint end) {
+    gboolean added = FALSE;
+    gint sequence = start;
+    guint index = _scoreboard_search(scoreboard, sequence);
+
+    while(sequence < end) {
+        ScoreBoardBlock* block = index < scoreboard->blocks->len ? _BLOCK(scoreboard, index) : NULL;
+
+        if(block && block->start <= sequence) {
+            /* already tracked */
+            sequence = block->end;
+            index++;
         } else {
-            /* the block has not yet been acked, keep it */
-            g_queue_push_tail(updatedBlocksQ, block);
+            gint gapEnd = block ? MIN(block->start, end) : end;
+            _scoreboard_addBlock(scoreboard, sequence, gapEnd, BLOCK_STATUS_INFLIGHT);
+            added = TRUE;
+            sequence = gapEnd;
+            index++;
         }
     }
 
-    /* clean up the old blocks queue */
-    g_queue_free(scoreboard->blocksQ);
-    scoreboard->blocksQ = updatedBlocksQ;
+    return added;
 }
 
-TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, GList* selectiveACKs, gint32 unacked, gint32 next) {
+static void _scoreboard_markSacked(ScoreBoard* scoreboard, gint start, gint end) {
+    guint index = _scoreboard_search(scoreboard, start);
+
+    while(index < scoreboard->blocks->len && _BLOCK(scoreboard, index)->start < end) {
+        if(_BLOCK(scoreboard, index)->status != BLOCK_STATUS_SACKED) {
+            /* only change the part of the block that was sacked */
+            if(_BLOCK(scoreboard, index)->start < start) {
+                _scoreboard_splitBlock(scoreboard, index, start);
+                index++;
+            }
+            if(_BLOCK(scoreboard, index)->end > end) {
+                _scoreboard_splitBlock(scoreboard, index, end);
+            }
+
+            ScoreBoardBlock* block = _BLOCK(scoreboard, index);
+            if(block->status == BLOCK_STATUS_RETRANSMITTED) {
+                scoreboard->ackedRetransmissionId = block->retransmissionId;
+            }
+            block->status = BLOCK_STATUS_SACKED;
+        }
+        index++;
+    }
+}
+
+TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, PacketTCPSelectiveACKs* selectiveACKs, gint32 unacked, gint32 next) {
     MAGIC_ASSERT(scoreboard);
     utility_assert(unacked <= next);
 
@@ -192,30 +270,33 @@ TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, GList* selectiveACKs,
 
     _scoreboard_removeAcked(scoreboard, unacked);
 
-    if(selectiveACKs) {
-        selectiveACKs = g_list_sort(selectiveACKs, (GCompareFunc)_scoreboard_compareSack);
+    if(selectiveACKs && selectiveACKs->nBlocks > 0) {
+        /* the most recent block comes first on the wire, we want them in order */
+        PacketTCPSelectiveACKs sacks = *selectiveACKs;
+        qsort(sacks.blocks, sacks.nBlocks, sizeof(PacketTCPSelectiveACKBlock),
+                (int (*)(const void*, const void*))_scoreboard_compareSack);
 
-        gint firstSeq = (gint)MAX(unacked, GPOINTER_TO_INT(g_list_first(selectiveACKs)->data));
+        gint firstSeq = (gint)MAX(unacked, (gint)sacks.blocks[0].start);
         gint lastSeq = 0;
         if(next > 0) {
-            lastSeq = (gint)MIN((next-1), GPOINTER_TO_INT(g_list_last(selectiveACKs)->data));
+            gint lastSacked = 0;
+            for(guint i = 0; i < sacks.nBlocks; i++) {
+                lastSacked = MAX(lastSacked, (gint)sacks.blocks[i].end - 1);
+            }
+            lastSeq = (gint)MIN((next-1), lastSacked);
         }
         scoreboard->fack = MAX(scoreboard->fack, lastSeq);
 
-        /* go through all sequence that might be sacked and update scoreboard */
-        for(gint seq = firstSeq; seq <= lastSeq; seq++) {
-            gboolean sacked = (gboolean)g_list_find(selectiveACKs, GINT_TO_POINTER(seq));
-            BlockStatus status = (sacked ? BLOCK_STATUS_SACKED : BLOCK_STATUS_INFLIGHT);
-
-            ScoreBoardBlock* block = _scoreboard_findBlock(scoreboard, seq);
-            if(!block) {
-                _scoreboard_addBlock(scoreboard, seq, status);
-                flag |= TCP_PF_DATA_SACKED;
-            } else if(status == BLOCK_STATUS_SACKED) {
-                if(block->status == BLOCK_STATUS_RETRANSMITTED) {
-                    scoreboard->ackedRetransmissionId = block->retransmissionId;
-                }
-                block->status = status;
+        /* everything between the first and last sacked sequence is tracked */
+        if(firstSeq <= lastSeq && _scoreboard_fillGaps(scoreboard, firstSeq, lastSeq + 1)) {
+            flag |= TCP_PF_DATA_SACKED;
+        }
+
+        for(guint i = 0; i < sacks.nBlocks; i++) {
+            gint start = MAX(firstSeq, (gint)sacks.blocks[i].start);
+            gint end = MIN(lastSeq + 1, (gint)sacks.blocks[i].end);
+            if(start < end) {
+                _scoreboard_markSacked(scoreboard, start, end);
             }
         }
     }
@@ -229,26 +310,40 @@ TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, GList* selectiveACKs,
     scoreboard->lastAcknowledgment = unacked;
 
     /* go through all the blocks and check if any of the INFLIGHT ones need to be retransmitted */
-    for(guint i = 0; i < g_queue_get_length(scoreboard->blocksQ); i++) {
-        ScoreBoardBlock* block = (ScoreBoardBlock*)g_queue_peek_nth(scoreboard->blocksQ, i);
-        if(!block) continue;
+    for(guint i = 0; i < scoreboard->blocks->len; i++) {
+        ScoreBoardBlock* block = _BLOCK(scoreboard, i);
 
         switch(block->status) {
-            case BLOCK_STATUS_INFLIGHT:
+            case BLOCK_STATUS_INFLIGHT: {
+                /* anything 4 or more below the forward ack is lost */
+                gint lostEnd = scoreboard->fack - 3;
+                if(block->start < lostEnd) {
+                    if(block->end > lostEnd) {
+                        _scoreboard_splitBlock(scoreboard, i, lostEnd);
+                        block = _BLOCK(scoreboard, i);
+                    }
+                    block->status = BLOCK_STATUS_LOST;
+                    scoreboard->fackOut += block->end - block->start;
+                    flag |= TCP_PF_DATA_LOST;
+                }
                 /* checks for 3 duplicate ACKs */
-                if(block->sequence <= scoreboard->fack - 4 || 
-                   (block->sequence == scoreboard->lastAcknowledgment && scoreboard->duplicateACKCount == 3)) {
+                else if(scoreboard->duplicateACKCount == 3 &&
+                        block->start <= scoreboard->lastAcknowledgment &&
+                        scoreboard->lastAcknowledgment < block->end) {
+                    i = _scoreboard_isolate(scoreboard, i, scoreboard->lastAcknowledgment);
+                    block = _BLOCK(scoreboard, i);
                     block->status = BLOCK_STATUS_LOST;
                     scoreboard->fackOut += 1;
                     flag |= TCP_PF_DATA_LOST;
                 }
                 break;
+            }
 
             case BLOCK_STATUS_RETRANSMITTED:
                 if((block->nextSend <= scoreboard->fack) ||
                    (block->retransmissionId + 4 < scoreboard->ackedRetransmissionId)) {
                     block->status = BLOCK_STATUS_LOST;
-                    scoreboard->fackOut += 1;
+                    scoreboard->fackOut += block->end - block->start;
                     flag |= TCP_PF_DATA_LOST;
                 }
                 break;
@@ -259,9 +354,10 @@ TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, GList* selectiveACKs,
             case BLOCK_STATUS_SACKED:
                 break;
         }
-
     }
 
+    _scoreboard_mergeBlocks(scoreboard);
+
     //_scoreboard_dump(scoreboard);
 
     return flag;
@@ -270,18 +366,21 @@ TCPProcessFlags scoreboard_update(ScoreBoard* scoreboard, GList* selectiveACKs,
 gint scoreboard_getNextRetransmit(ScoreBoard* scoreboard) {
     MAGIC_ASSERT(scoreboard);
 
-    ScoreBoardBlock b;
-    b.status = BLOCK_STATUS_LOST;
-    GList* link = g_queue_find_custom(scoreboard->blocksQ, &b, (GCompareFunc)_scoreboardblock_compareStatus);
+    for(guint i = 0; i < scoreboard->blocks->len; i++) {
+        ScoreBoardBlock* block = _BLOCK(scoreboard, i);
+        if(block->status == BLOCK_STATUS_LOST) {
+            return block->start;
+        }
+    }
 
-    return link ? ((ScoreBoardBlock*)(link->data))->sequence : -1;
+    return -1;
 }
 
 void scoreboard_markRetransmitted(ScoreBoard* scoreboard, gint sequence, gint nextSend) {
     MAGIC_ASSERT(scoreboard);
 
-    ScoreBoardBlock* block = _scoreboard_findBlock(scoreboard, sequence);
-    if(!block) {
+    gint index = _scoreboard_findBlock(scoreboard, sequence);
+    if(index < 0) {
         warning("Couldn't find block for sequence %d to mark retransmitted", sequence);
         return;
     }
@@ -291,6 +390,7 @@ void scoreboard_markRetransmitted(ScoreBoard* scoreboard, gint sequence, gint ne
         warning("fack out is negative at %d with sequence %d and next send %d", scoreboard->fackOut, sequence, nextSend);
     }
 
+    ScoreBoardBlock* block = _BLOCK(scoreboard, _scoreboard_isolate(scoreboard, (guint)index, sequence));
     block->status = BLOCK_STATUS_RETRANSMITTED;
     block->nextSend = nextSend;
     block->retransmissionId = scoreboard->retransmissionId;
@@ -300,51 +400,51 @@ void scoreboard_markRetransmitted(ScoreBoard* scoreboard, gint sequence, gint ne
 void scoreboard_packetDropped(ScoreBoard* scoreboard, gint sequence) {
     MAGIC_ASSERT(scoreboard);
 
-    ScoreBoardBlock* block = _scoreboard_findBlock(scoreboard, sequence);
-    if(!block) {
-        block = _scoreboard_addBlock(scoreboard, sequence, BLOCK_STATUS_INFLIGHT);
+    gint index = _scoreboard_findBlock(scoreboard, sequence);
+    if(index < 0) {
+        _scoreboard_addBlock(scoreboard, sequence, sequence + 1, BLOCK_STATUS_INFLIGHT);
+        index = _scoreboard_findBlock(scoreboard, sequence);
     }
 
-    if(block->status != BLOCK_STATUS_INFLIGHT) {
+    if(_BLOCK(scoreboard, index)->status != BLOCK_STATUS_INFLIGHT) {
         return;
     }
 
+    ScoreBoardBlock* block = _BLOCK(scoreboard, _scoreboard_isolate(scoreboard, (guint)index, sequence));
     block->status = BLOCK_STATUS_LOST;
 
     scoreboard->fackOut++;
 }
 
-static void _scoreboard_markLossHelper(ScoreBoardBlock* block, ScoreBoard* scoreboard) {
-    MAGIC_ASSERT(scoreboard);
-    MAGIC_ASSERT(block);
-    if(block->status != BLOCK_STATUS_SACKED) {
-        if(block->status != BLOCK_STATUS_LOST) {
-            scoreboard->fackOut += 1;
-        }
-        block->status = BLOCK_STATUS_LOST;
-    }
-}
-
 void scoreboard_markLoss(ScoreBoard* scoreboard, gint unacked, gint nextSend) {
     MAGIC_ASSERT(scoreboard);
 
-    g_queue_foreach(scoreboard->blocksQ, (GFunc)_scoreboard_markLossHelper, scoreboard);
+    for(guint i = 0; i < scoreboard->blocks->len; i++) {
+        ScoreBoardBlock* block = _BLOCK(scoreboard, i);
+        if(block->status != BLOCK_STATUS_SACKED) {
+            if(block->status != BLOCK_STATUS_LOST) {
+                scoreboard->fackOut += block->end - block->start;
+            }
+            block->status = BLOCK_STATUS_LOST;
+        }
+    }
 
     gint start = unacked;
     BlockStatus status = BLOCK_STATUS_LOST;
-    if(!g_queue_is_empty(scoreboard->blocksQ)) {
-        ScoreBoardBlock* block = g_queue_peek_tail(scoreboard->blocksQ);
-        start = block->sequence + 1;
+    if(scoreboard->blocks->len > 0) {
+        start = _BLOCK(scoreboard, scoreboard->blocks->len - 1)->end;
         status = BLOCK_STATUS_INFLIGHT;
     }
 
-    for(gint sequence = start; sequence < nextSend; sequence++) {
-        _scoreboard_addBlock(scoreboard, sequence, status);
+    if(start < nextSend) {
+        _scoreboard_addBlock(scoreboard, start, nextSend, status);
         if(status == BLOCK_STATUS_LOST) {
-            scoreboard->fackOut += 1;
+            scoreboard->fackOut += nextSend - start;
         }
     }
 
+    _scoreboard_mergeBlocks(scoreboard);
+
     scoreboard->retransmissionId = 0;
     scoreboard->ackedRetransmissionId = -1;
 }
@@ -127,21 +127,21 @@ struct _TCP {
         guint32 highestSequence;
         /* total number of packets sent */
         guint32 packetsSent;
-        /* list of selective ACKs, packets received after a missing packet */
-        GList* selectiveACKs;
+        /* ranges of packets received after a missing packet, lowest first */
+        GArray* selectiveACKs;
+        /* the most recent of those packets, its range is reported first (rfc 2018) */
+        guint lastSelectiveACK;
     } send;
 
     struct {
         /* TCP provides reliable transport, keep track of packets until they are acked */
-        GHashTable* queue;
+        SequenceRing* queue;
         /* track amount of queued application data */
         gsize queueLength;
         /* retransmission timeout value (rto), in milliseconds */
         gint timeout;
-        /* when the scheduled timer events will expire; empty if no retransmit is scheduled */
-        PriorityQueue* scheduledTimerExpirations;
-        /* our updated expiration time, to determine if previous events are still valid */
-        SimulationTime desiredTimerExpiration;
+        /* armed while we have unacked packets in flight */
+        WheelTimer* timer;
         /* number of times we backed off due to congestion */
         guint backoffCount;
 
@@ -156,6 +156,23 @@ struct _TCP {
         gsize space;
     } autotune;
 
+    /* delayed acks for in-order data (rfc 1122 and rfc 5681) */
+    struct {
+        /* ack at least every this many full segments */
+        guint segmentsPerACK;
+        /* data segments received since the last ack we sent */
+        guint unackedSegments;
+        WheelTimer* timer;
+    } delayedACK;
+
+    /* flow-level approximation of long bulk transfers */
+    struct {
+        /* when we entered congestion avoidance, 0 if we are not in it */
+        SimulationTime avoidanceStart;
+        /* the interface whose bandwidth we share, NULL unless we are fluid */
+        NetworkInterface* interface;
+    } fluid;
+
     /* congestion object for implementing different types of congestion control (aimd, reno, cubic) */
     TCPCongestion* congestion;
 
@@ -170,13 +187,15 @@ struct _TCP {
         guint32 rtt;
     } info;
 
-    /* TCP throttles outgoing data packets if too many are in flight */
-    PriorityQueue* throttledOutput;
+    /* TCP throttles outgoing data packets if too many are in flight. control
+     * packets have no sequence number, they are queued separately and go first. */
+    GQueue* throttledControl;
+    SequenceRing* throttledOutput;
     /* track amount of queued application data */
     gsize throttledOutputLength;
 
     /* TCP ensures that the user receives data in-order */
-    PriorityQueue* unorderedInput;
+    SequenceRing* unorderedInput;
     /* track amount of queued application data */
     gsize unorderedInputLength;
 
@@ -430,12 +449,28 @@ static void _tcp_setBufferSizes(TCP* tcp) {
             socket_getOutputBufferSize(&(tcp->super)), socket_getInputBufferSize(&(tcp->super)));
 }
 
+static void _tcp_leaveFluid(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+
+    tcp->fluid.avoidanceStart = 0;
+    if(tcp->fluid.interface) {
+        networkinterface_removeFluidFlow(tcp->fluid.interface, &(tcp->super));
+        tcp->fluid.interface = NULL;
+        debug("%s <-> %s: returning to packet-level simulation", tcp->super.boundString, tcp->super.peerString);
+    }
+}
+
 static void _tcp_setState(TCP* tcp, enum TCPState state) {
     MAGIC_ASSERT(tcp);
 
     tcp->stateLast = tcp->state;
     tcp->state = state;
 
+    /* only established connections are approximated */
+    if(state != TCPS_ESTABLISHED) {
+        _tcp_leaveFluid(tcp);
+    }
+
     debug("%s <-> %s: moved from TCP state '%s' to '%s'", tcp->super.boundString, tcp->super.peerString,
             tcp_stateToAscii(tcp->stateLast), tcp_stateToAscii(tcp->state));
 
@@ -597,7 +632,8 @@ static void _tcp_updateSendWindow(TCP* tcp) {
     tcp->send.window = MIN(tcp->congestion->window, tcp->receive.lastWindow);
 }
 
-static Packet* _tcp_createPacket(TCP* tcp, enum ProtocolTCPFlags flags, gconstpointer payload, gsize payloadLength) {
+static Packet* _tcp_createPacket(TCP* tcp, enum ProtocolTCPFlags flags,
+        Payload* payload, gsize payloadOffset, gsize payloadLength) {
     MAGIC_ASSERT(tcp);
 
     /*
@@ -630,7 +666,7 @@ static Packet* _tcp_createPacket(TCP* tcp, enum ProtocolTCPFlags flags, gconstpo
     guint sequence = payloadLength > 0 || isFinNotAck ? tcp->send.next : 0;
 
     /* create the TCP packet. the ack, window, and timestamps will be set in _tcp_flush */
-    Packet* packet = packet_new(payload, payloadLength);
+    Packet* packet = packet_newSlice(payload, payloadOffset, payloadLength);
     packet_setDropNotificationDelay(packet, (tcp->congestion->rttSmoothed * 2) * SIMTIME_ONE_MILLISECOND);
     packet_setTCP(packet, flags, sourceIP, sourcePort, destinationIP, destinationPort, sequence);
     packet_addDeliveryStatus(packet, PDS_SND_CREATED);
@@ -654,8 +690,17 @@ static gsize _tcp_getBufferSpaceOut(TCP* tcp) {
 static void _tcp_bufferPacketOut(TCP* tcp, Packet* packet) {
     MAGIC_ASSERT(tcp);
 
+    PacketTCPHeader header;
+    packet_getTCPHeader(packet, &header);
+
     /* TCP wants to avoid congestion */
-    priorityqueue_push(tcp->throttledOutput, packet);
+    if(header.sequence == 0) {
+        g_queue_push_tail(tcp->throttledControl, packet);
+    } else if(!sequencering_insert(tcp->throttledOutput, header.sequence, packet)) {
+        /* this sequence is already waiting to be sent */
+        packet_unref(packet);
+        return;
+    }
     tcp->throttledOutputLength += packet_getPayloadLength(packet);
     packet_addDeliveryStatus(packet, PDS_SND_TCP_ENQUEUE_THROTTLED);
 
@@ -674,8 +719,15 @@ static gsize _tcp_getBufferSpaceIn(TCP* tcp) {
 static void _tcp_bufferPacketIn(TCP* tcp, Packet* packet) {
     MAGIC_ASSERT(tcp);
 
+    PacketTCPHeader header;
+    packet_getTCPHeader(packet, &header);
+
     /* TCP wants in-order data */
-    priorityqueue_push(tcp->unorderedInput, packet);
+    if(!sequencering_insert(tcp->unorderedInput, header.sequence, packet)) {
+        /* we already have this sequence, its a duplicate */
+        packet_addDeliveryStatus(packet, PDS_RCV_SOCKET_DROPPED);
+        return;
+    }
     packet_ref(packet);
     tcp->unorderedInputLength += packet_getPayloadLength(packet);
 
@@ -689,7 +741,15 @@ static void _tcp_addRetransmit(TCP* tcp, Packet* packet) {
 
     PacketTCPHeader header;
     packet_getTCPHeader(packet, &header);
-    g_hash_table_insert(tcp->retransmit.queue, GINT_TO_POINTER(header.sequence), packet);
+
+    /* replace anything we still had stored for this sequence */
+    Packet* stale = sequencering_steal(tcp->retransmit.queue, header.sequence);
+    if(stale) {
+        tcp->retransmit.queueLength -= packet_getPayloadLength(stale);
+        packet_unref(stale);
+    }
+
+    sequencering_insert(tcp->retransmit.queue, header.sequence, packet);
     packet_addDeliveryStatus(packet, PDS_SND_TCP_ENQUEUE_RETRANSMIT);
 
     tcp->retransmit.queueLength += packet_getPayloadLength(packet);
@@ -698,86 +758,38 @@ static void _tcp_addRetransmit(TCP* tcp, Packet* packet) {
     }
 }
 
+static void _tcp_releaseRetransmit(Packet* ackedPacket, TCP* tcp) {
+    tcp->retransmit.queueLength -= packet_getPayloadLength(ackedPacket);
+    packet_addDeliveryStatus(ackedPacket, PDS_SND_TCP_DEQUEUE_RETRANSMIT);
+}
+
 /* remove all packets with a sequence number less than the sequence parameter */
 static void _tcp_clearRetransmit(TCP* tcp, guint sequence) {
     MAGIC_ASSERT(tcp);
 
-    GHashTableIter iter;
-    gpointer key, value;
-    g_hash_table_iter_init(&iter, tcp->retransmit.queue);
-
-    while(g_hash_table_iter_next(&iter, &key, &value)) {
-        guint ackedSequence = GPOINTER_TO_INT(key);
-        Packet* ackedPacket = (Packet*)value;
-
-        if(ackedSequence < sequence) {
-            tcp->retransmit.queueLength -= packet_getPayloadLength(ackedPacket);
-            packet_addDeliveryStatus(ackedPacket, PDS_SND_TCP_DEQUEUE_RETRANSMIT);
-            g_hash_table_iter_remove(&iter);
-        }
-    }
+    /* the queue is ordered by sequence, so this only touches the acked packets */
+    sequencering_removeBefore(tcp->retransmit.queue, (guint32)sequence,
+            (GFunc)_tcp_releaseRetransmit, tcp);
 
     if(_tcp_getBufferSpaceOut(tcp) > 0) {
         descriptor_adjustStatus((Descriptor*)tcp, DS_WRITABLE, TRUE);
     }
 }
 
-static void _tcp_scheduleRetransmitTimer(TCP* tcp, SimulationTime now, SimulationTime delay) {
-    MAGIC_ASSERT(tcp);
-
-    SimulationTime* expireTimePtr = g_new0(SimulationTime, 1);
-    *expireTimePtr = now + delay;
-    gboolean success = priorityqueue_push(tcp->retransmit.scheduledTimerExpirations, expireTimePtr);
-
-    if(success) {
-        TCPRetransmitTimerExpiredEvent* event = tcpretransmittimerexpired_new(tcp);
-
-        /* this is a local event for our own host */
-        Host* host = worker_getCurrentHost();
-        Address* address = host_getDefaultAddress(host);
-        GQuark id = (GQuark) address_getID(address);
-
-        worker_scheduleEvent((Event*)event, delay, id);
-
-        debug("%s retransmit timer scheduled for %"G_GUINT64_FORMAT" ns",
-                tcp->super.boundString, *expireTimePtr);
-    } else {
-        warning("%s could not schedule a retransmit timer for %"G_GUINT64_FORMAT" ns",
-                tcp->super.boundString, *expireTimePtr);
-        g_free(expireTimePtr);
-    }
-}
-
-static void _tcp_scheduleRetransmitTimerIfNeeded(TCP* tcp, SimulationTime now) {
-    /* logic for scheduling retransmission events. we only need to schedule one if
-     * we have no events that will allow us to schedule one later. */
-    SimulationTime* nextTimePtr = priorityqueue_peek(tcp->retransmit.scheduledTimerExpirations);
-    if(nextTimePtr && *nextTimePtr <= tcp->retransmit.desiredTimerExpiration) {
-        /* another event will fire before the RTO expires, check again then */
-        return;
-    }
-
-    /* no existing timer will expire as early as desired */
-    SimulationTime delay = tcp->retransmit.desiredTimerExpiration - now;
-    _tcp_scheduleRetransmitTimer(tcp, now, delay);
-}
-
 static void _tcp_setRetransmitTimer(TCP* tcp, SimulationTime now) {
     MAGIC_ASSERT(tcp);
 
-    /* our retransmission timer needs to change
-     * track the new expiration time based on the current RTO */
-    SimulationTime delay = tcp->retransmit.timeout * SIMTIME_ONE_MILLISECOND;
-    tcp->retransmit.desiredTimerExpiration = now + delay;
+    /* (re)arm our retransmission timer based on the current RTO */
+    SimulationTime expireTime = now + (tcp->retransmit.timeout * SIMTIME_ONE_MILLISECOND);
+    wheeltimer_arm(tcp->retransmit.timer, expireTime);
 
-    _tcp_scheduleRetransmitTimerIfNeeded(tcp, now);
+    debug("%s retransmit timer set to expire at %"G_GUINT64_FORMAT" ns",
+            tcp->super.boundString, expireTime);
 }
 
 static void _tcp_stopRetransmitTimer(TCP* tcp) {
     MAGIC_ASSERT(tcp);
-    /* we want to stop the timer. since there may be an event already scheduled,
-     * lets mark our desired time as 0 so we know to cancel when the event fires. */
-    tcp->retransmit.desiredTimerExpiration = 0;
+    wheeltimer_cancel(tcp->retransmit.timer);
 
     debug("%s retransmit timer disabled", tcp->super.boundString);
 }
@@ -825,7 +837,8 @@ static void _tcp_updateRTTEstimate(TCP* tcp, SimulationTime timestamp) {
 static void _tcp_retransmitPacket(TCP* tcp, gint sequence) {
     MAGIC_ASSERT(tcp);
 
-    Packet* packet = g_hash_table_lookup(tcp->retransmit.queue, GINT_TO_POINTER(sequence));
+    /* remove from queue and update length and status */
+    Packet* packet = sequencering_steal(tcp->retransmit.queue, (guint32)sequence);
     /* if packet wasn't found is was most likely retransmitted from a previous SACK
      * but has yet to be received/acknowledged by the receiver */
     if(!packet) {
@@ -834,8 +847,6 @@ static void _tcp_retransmitPacket(TCP* tcp, gint sequence) {
 
     debug("retransmitting packet %d", sequence);
 
-    /* remove from queue and update length and status */
-    g_hash_table_steal(tcp->retransmit.queue, GINT_TO_POINTER(sequence));
     tcp->retransmit.queueLength -= packet_getPayloadLength(packet);
     packet_addDeliveryStatus(packet, PDS_SND_TCP_DEQUEUE_RETRANSMIT);
 
@@ -852,6 +863,80 @@ static void _tcp_retransmitPacket(TCP* tcp, gint sequence) {
 }
 
 
+static void _tcp_addSelectiveACK(TCP* tcp, guint sequence) {
+    MAGIC_ASSERT(tcp);
+
+    GArray* ranges = tcp->send.selectiveACKs;
+    tcp->send.lastSelectiveACK = sequence;
+
+    /* find the first range that ends at or after the sequence */
+    guint i = 0;
+    while(i < ranges->len && g_array_index(ranges, PacketTCPSelectiveACKBlock, i).end < sequence) {
+        i++;
+    }
+
+    if(i < ranges->len) {
+        PacketTCPSelectiveACKBlock* range = &g_array_index(ranges, PacketTCPSelectiveACKBlock, i);
+
+        if(sequence >= range->start && sequence < range->end) {
+            /* duplicate */
+            return;
+        } else if(sequence == range->end) {
+            range->end++;
+
+            /* we may have filled the gap to the next range */
+            if(i + 1 < ranges->len) {
+                PacketTCPSelectiveACKBlock* next = &g_array_index(ranges, PacketTCPSelectiveACKBlock, i + 1);
+                if(next->start == range->end) {
+                    range->end = next->end;
+                    g_array_remove_index(ranges, i + 1);
+                }
+            }
+            return;
+        } else if(sequence + 1 == range->start) {
+            range->start--;
+            return;
+        }
+    }
+
+    PacketTCPSelectiveACKBlock range = {sequence, sequence + 1};
+    g_array_insert_val(ranges, i, range);
+}
+
+static void _tcp_removeSelectiveACKs(TCP* tcp, guint sequence) {
+    MAGIC_ASSERT(tcp);
+
+    /* the ranges that start right after the in-order sequence are now in order too */
+    GArray* ranges = tcp->send.selectiveACKs;
+    while(ranges->len > 0 && g_array_index(ranges, PacketTCPSelectiveACKBlock, 0).start <= sequence + 1) {
+        g_array_remove_index(ranges, 0);
+    }
+}
+
+static void _tcp_getSelectiveACKs(TCP* tcp, PacketTCPSelectiveACKs* selectiveACKs) {
+    MAGIC_ASSERT(tcp);
+
+    GArray* ranges = tcp->send.selectiveACKs;
+    selectiveACKs->nBlocks = 0;
+
+    /* the range with the most recent arrival goes first, then the highest ones */
+    gint recent = -1;
+    for(guint i = 0; i < ranges->len; i++) {
+        PacketTCPSelectiveACKBlock* range = &g_array_index(ranges, PacketTCPSelectiveACKBlock, i);
+        if(tcp->send.lastSelectiveACK >= range->start && tcp->send.lastSelectiveACK < range->end) {
+            selectiveACKs->blocks[selectiveACKs->nBlocks++] = *range;
+            recent = (gint)i;
+            break;
+        }
+    }
+
+    for(gint i = ((gint)ranges->len) - 1; i >= 0 && selectiveACKs->nBlocks < PACKET_TCP_SACK_BLOCKS_MAX; i--) {
+        if(i != recent) {
+            selectiveACKs->blocks[selectiveACKs->nBlocks++] = g_array_index(ranges, PacketTCPSelectiveACKBlock, i);
+        }
+    }
+}
+
 static void _tcp_flush(TCP* tcp) {
     MAGIC_ASSERT(tcp);
 
@@ -861,6 +946,10 @@ static void _tcp_flush(TCP* tcp) {
 
     SimulationTime now = worker_getCurrentTime();
 
+    /* the same sacks go out on everything we send now */
+    PacketTCPSelectiveACKs selectiveACKs;
+    _tcp_getSelectiveACKs(tcp, &selectiveACKs);
+
     /* find all packets to retransmit and add them throttled output */
     gint retransmitSequence = scoreboard_getNextRetransmit(tcp->retransmit.scoreboard);
     while(retransmitSequence != -1) {
@@ -870,9 +959,12 @@ static void _tcp_flush(TCP* tcp) {
     }
 
     /* flush packets that can now be sent to socket */
-    while(!priorityqueue_isEmpty(tcp->throttledOutput)) {
-        /* get the next throttled packet, in sequence order */
-        Packet* packet = priorityqueue_peek(tcp->throttledOutput);
+    while(TRUE) {
+        /* get the next throttled packet, control first and then in sequence order */
+        Packet* packet = g_queue_peek_head(tcp->throttledControl);
+        if(!packet) {
+            packet = sequencering_peekFirst(tcp->throttledOutput);
+        }
 
         /* break out if we have no packets left */
         if(!packet) {
@@ -900,7 +992,11 @@ static void _tcp_flush(TCP* tcp) {
         }
 
         /* packet is sendable, we removed it from out buffer */
-        priorityqueue_pop(tcp->throttledOutput);
+        if(header.sequence == 0) {
+            g_queue_pop_head(tcp->throttledControl);
+        } else {
+            sequencering_popFirst(tcp->throttledOutput);
+        }
         tcp->throttledOutputLength -= length;
 
         if(header.sequence > 0 || (header.flags & PTCP_SYN)) {
@@ -908,18 +1004,19 @@ static void _tcp_flush(TCP* tcp) {
             _tcp_addRetransmit(tcp, packet);
 
             /* start retransmit timer if its not running (rfc 6298, section 5.1) */
-            if(!tcp->retransmit.desiredTimerExpiration) {
+            if(!wheeltimer_isArmed(tcp->retransmit.timer)) {
                 _tcp_setRetransmitTimer(tcp, now);
             }
         }
 
         /* update TCP header to our current advertised window and acknowledgment */
-        packet_updateTCP(packet, tcp->receive.next, tcp->send.selectiveACKs, tcp->receive.window, now, tcp->receive.lastTimestamp);
+        packet_updateTCP(packet, tcp->receive.next, &selectiveACKs, tcp->receive.window, now, tcp->receive.lastTimestamp);
 
         /* keep track of the last things we sent them */
         tcp->send.lastAcknowledgment = tcp->receive.next;
         tcp->send.lastWindow = tcp->receive.window;
         tcp->info.lastAckSent = now;
+        tcp->delayedACK.unackedSegments = 0;
 
          /* socket will queue it ASAP */
         gboolean success = socket_addToOutputBuffer(&(tcp->super), packet);
@@ -931,8 +1028,8 @@ static void _tcp_flush(TCP* tcp) {
     }
 
     /* any packets now in order can be pushed to our user input buffer */
-    while(!priorityqueue_isEmpty(tcp->unorderedInput)) {
-        Packet* packet = priorityqueue_peek(tcp->unorderedInput);
+    while(!sequencering_isEmpty(tcp->unorderedInput)) {
+        Packet* packet = sequencering_peekFirst(tcp->unorderedInput);
 
         PacketTCPHeader header;
         packet_getTCPHeader(packet, &header);
@@ -942,7 +1039,7 @@ static void _tcp_flush(TCP* tcp) {
             gboolean fitInBuffer = socket_addToInputBuffer(&(tcp->super), packet);
 
             if(fitInBuffer) {
-                priorityqueue_pop(tcp->unorderedInput);
+                sequencering_popFirst(tcp->unorderedInput);
                 packet_unref(packet);
                 tcp->unorderedInputLength -= packet_getPayloadLength(packet);
                 (tcp->receive.next)++;
@@ -1007,41 +1104,29 @@ static void _tcp_fastRetransmitAlert(TCP* tcp, TCPProcessFlags flags) {
     }
 }
 
-void tcp_retransmitTimerExpired(TCP* tcp) {
+static void _tcp_retransmitTimerExpired(TCP* tcp, gpointer data) {
     MAGIC_ASSERT(tcp);
 
-    /* a timer expired, update our timer tracking state */
+    /* the wheel only runs timers that were not reset or stopped */
     SimulationTime now = worker_getCurrentTime();
-    SimulationTime* scheduledTimerExpirationPtr = priorityqueue_pop(tcp->retransmit.scheduledTimerExpirations);
-    utility_assert(scheduledTimerExpirationPtr);
-    g_free(scheduledTimerExpirationPtr);
 
     debug("%s a scheduled retransmit timer expired", tcp->super.boundString);
 
     /* if we are closed, we don't care */
     if(tcp->state == TCPS_CLOSED) {
-        _tcp_stopRetransmitTimer(tcp);
         _tcp_clearRetransmit(tcp, (guint)-1);
         return;
     }
 
-    if(g_hash_table_size(tcp->retransmit.queue) == 0) {
-        _tcp_stopRetransmitTimer(tcp);
+    if(sequencering_isEmpty(tcp->retransmit.queue)) {
         return;
     }
 
-    /* if the timer should be off or was reset, ignore this event */
-    if(tcp->retransmit.desiredTimerExpiration == 0) {
-        return;
-    } else if(tcp->retransmit.desiredTimerExpiration > now) {
-        /* the timer was reset after this event was scheduled, check if we need to
-         * schedule another event, or if we can do it when the next event fires instead */
-        _tcp_scheduleRetransmitTimerIfNeeded(tcp, now);
-        return;
-    }
+    /* make sure we are still around if the retransmission closes us */
+    descriptor_ref(&tcp->super.super.super);
 
     /* rfc 6298, section 5.4-5.7 (http://tools.ietf.org/html/rfc6298)
-     * if we get here, this is a valid timer expiration and we need to do a retransmission
+     * this is a valid timer expiration and we need to do a retransmission
      * do exponential backoff */
     tcp->retransmit.backoffCount++;
     _tcp_setRetransmitTimeout(tcp, tcp->retransmit.timeout * 2);
@@ -1059,7 +1144,7 @@ void tcp_retransmitTimerExpired(TCP* tcp) {
 
     /* resend the next unacked packet */
     gint sequence = tcp->send.unacked;
-    if(tcp->send.unacked == 1 && g_hash_table_lookup(tcp->retransmit.queue, GINT_TO_POINTER(0))) {
+    if(tcp->send.unacked == 1 && sequencering_lookup(tcp->retransmit.queue, 0)) {
         sequence = 0;
     }
 
@@ -1067,6 +1152,8 @@ void tcp_retransmitTimerExpired(TCP* tcp) {
 
     _tcp_retransmitPacket(tcp, sequence);
     _tcp_flush(tcp);
+
+    descriptor_unref(&tcp->super.super.super);
 }
 
 gboolean tcp_isFamilySupported(TCP* tcp, sa_family_t family) {
@@ -1182,7 +1269,7 @@ gint tcp_connectToPeer(TCP* tcp, in_addr_t ip, in_port_t port, sa_family_t famil
     socket_setPeerName(&(tcp->super), ip, port);
 
     /* send 1st part of 3-way handshake, state->syn_sent */
-    Packet* packet = _tcp_createPacket(tcp, PTCP_SYN, NULL, 0);
+    Packet* packet = _tcp_createPacket(tcp, PTCP_SYN, NULL, 0, 0);
 
     /* dont have to worry about space since this has no payload */
     _tcp_bufferPacketOut(tcp, packet);
@@ -1288,24 +1375,6 @@ static TCP* _tcp_getSourceTCP(TCP* tcp, in_addr_t ip, in_port_t port) {
     return tcp;
 }
 
-static GList* _tcp_removeSacks(GList* selectiveACKs, gint sequence) {
-    GList *unacked = NULL;
-    if(selectiveACKs) {
-        GList *iter = selectiveACKs;
-        while(iter) {
-            gint sackSequence = GPOINTER_TO_INT(iter->data);
-
-            if(sackSequence > sequence) {
-                unacked = g_list_append(unacked, iter->data);
-            }
-
-            iter = g_list_next(iter);
-        }
-        g_list_free(selectiveACKs);
-    }
-    return unacked;
-}
-
 TCPProcessFlags _tcp_dataProcessing(TCP* tcp, Packet* packet, PacketTCPHeader *header) {
     MAGIC_ASSERT(tcp);
 
@@ -1331,27 +1400,10 @@ TCPProcessFlags _tcp_dataProcessing(TCP* tcp, Packet* packet, PacketTCPHeader *h
 
         /* SACK: if not next packet, one was dropped and we need to include this in the selective ACKs */
         if(!isNextPacket) {
-            tcp->send.selectiveACKs = g_list_append(tcp->send.selectiveACKs, GINT_TO_POINTER(header->sequence));
-        } else if(tcp->send.selectiveACKs && g_list_length(tcp->send.selectiveACKs) > 0) {
-            /* find the first gap in SACKs and remove everything before it */
-            GList *iter = g_list_first(tcp->send.selectiveACKs);
-            GList *next = g_list_next(iter);
-
-            gint firstSequence = GPOINTER_TO_INT(iter->data);
-            if(firstSequence <= header->sequence + 1) {
-                while(next) {
-                    gint currSequence = GPOINTER_TO_INT(iter->data);
-                    gint nextSequence = GPOINTER_TO_INT(next->data);
-                    /* check for a gap in sequences */
-                    if(currSequence + 1 < nextSequence && currSequence > header->sequence) {
-                        break;
-                    }
-                    iter = next;
-                    next = g_list_next(iter);
-                }
-
-                tcp->send.selectiveACKs = _tcp_removeSacks(tcp->send.selectiveACKs, GPOINTER_TO_INT(iter->data));
-            }
+            _tcp_addSelectiveACK(tcp, header->sequence);
+        } else {
+            /* everything up to the first gap after this packet is acked normally now */
+            _tcp_removeSelectiveACKs(tcp, header->sequence);
         }
 
         DescriptorStatus s = descriptor_getStatus((Descriptor*) tcp);
@@ -1451,8 +1503,148 @@ static void _tcp_logCongestionInfo(TCP* tcp) {
             outSize, outLength, inSize, inLength, tcp->info.retransmitCount, ploss);
 }
 
+static gboolean _tcp_canDelayACK(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+
+    if(tcp->delayedACK.segmentsPerACK <= 1 || tcp->state != TCPS_ESTABLISHED) {
+        return FALSE;
+    }
+
+    /* ack at least every few full segments (rfc 5681, section 4.2) */
+    if(tcp->delayedACK.unackedSegments >= tcp->delayedACK.segmentsPerACK) {
+        return FALSE;
+    }
+
+    /* gaps, an opening window, or a closed one must be reported immediately */
+    if(tcp->send.selectiveACKs->len > 0 || tcp->congestion->fastRetransmit ||
+            tcp->receive.window > tcp->send.lastWindow || tcp->receive.window == 0) {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void _tcp_sendDelayedACK(TCP* tcp, gpointer data) {
+    MAGIC_ASSERT(tcp);
+
+    /* nothing to do if a data packet or another ack carried it already */
+    if(tcp->state != TCPS_CLOSED && tcp->receive.next > tcp->send.lastAcknowledgment) {
+        debug("%s <-> %s: delayed ack timer expired, acknowledging %"G_GUINT32_FORMAT,
+                tcp->super.boundString, tcp->super.peerString, tcp->receive.next);
+
+        Packet* ack = _tcp_createPacket(tcp, PTCP_ACK, NULL, 0, 0);
+        _tcp_bufferPacketOut(tcp, ack);
+
+        /* make sure we are still around if the flush closes us */
+        descriptor_ref(&tcp->super.super.super);
+        _tcp_flush(tcp);
+        descriptor_unref(&tcp->super.super.super);
+    }
+}
+
+static void _tcp_scheduleDelayedACK(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+
+    if(wheeltimer_isArmed(tcp->delayedACK.timer)) {
+        return;
+    }
+
+    wheeltimer_arm(tcp->delayedACK.timer, worker_getCurrentTime() + CONFIG_TCPDELAYEDACK_DELAY);
+}
+
+static void _tcp_enterFluid(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+
+    in_addr_t sourceIP = tcp_getIP(tcp);
+    if(sourceIP == htonl(INADDR_ANY)) {
+        /* source interface depends on destination */
+        if(tcp_getPeerIP(tcp) == htonl(INADDR_LOOPBACK)) {
+            sourceIP = htonl(INADDR_LOOPBACK);
+        } else {
+            sourceIP = host_getDefaultIP(worker_getCurrentHost());
+        }
+    }
+
+    tcp->fluid.interface = host_lookupInterface(worker_getCurrentHost(), sourceIP);
+    if(tcp->fluid.interface) {
+        networkinterface_addFluidFlow(tcp->fluid.interface, &(tcp->super));
+        debug("%s <-> %s: switching to flow-level simulation", tcp->super.boundString, tcp->super.peerString);
+    }
+}
+
+static void _tcp_setFluidWindow(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+
+    /* one window per round trip sends at the rate we compute here */
+    gdouble rtt = ((gdouble)MAX(tcp->congestion->rttSmoothed, 1)) / 1000.0f;
+    gdouble segmentSize = (gdouble)(CONFIG_MTU - CONFIG_HEADER_SIZE_TCPIPETH);
+
+    /* the throughput the path loss allows (mathis et al., 1997):
+     * rate = (mss / rtt) * sqrt(3 / 2p), so window = sqrt(3 / 2p).
+     * flows limited this way leave the rest of their share to the others. */
+    gdouble demand = 0;
+    if(tcp->super.routePath) {
+        gdouble loss = 1.0f - path_getReliability(tcp->super.routePath);
+        if(loss > 0.0f) {
+            demand = sqrt(3.0f / (2.0f * loss)) * segmentSize / rtt;
+        }
+    }
+    networkinterface_setFluidFlowDemand(tcp->fluid.interface, &(tcp->super), demand);
+
+    /* our max-min fair share of the interface bandwidth */
+    gdouble window = networkinterface_getFluidFlowShare(tcp->fluid.interface, &(tcp->super)) * rtt / segmentSize;
+
+    tcp->congestion->window = MAX((gint)window, 1);
+    _tcp_updateSendWindow(tcp);
+}
+
+static void _tcp_updateFluid(TCP* tcp, SimulationTime now) {
+    MAGIC_ASSERT(tcp);
+
+    SimulationTime fluidAfter = ((SimulationTime)worker_getConfig()->tcpFluidAfter) * SIMTIME_ONE_SECOND;
+    if(fluidAfter == 0) {
+        return;
+    }
+
+    /* bulk transfers that are steady in congestion avoidance, with data waiting */
+    gboolean isSteady = tcp->state == TCPS_ESTABLISHED &&
+            tcp->congestion->state == TCP_CCS_AVOIDANCE &&
+            tcp->receive.state != TCPRS_RECOVERY &&
+            tcp->retransmit.backoffCount == 0 &&
+            tcp->retransmit.queueLength > 0;
+
+    if(!isSteady) {
+        _tcp_leaveFluid(tcp);
+        return;
+    }
+
+    if(tcp->fluid.avoidanceStart == 0) {
+        tcp->fluid.avoidanceStart = now;
+    }
+
+    if(!tcp->fluid.interface && now - tcp->fluid.avoidanceStart >= fluidAfter) {
+        _tcp_enterFluid(tcp);
+    }
+
+    /* the flow set may have changed since our last window */
+    if(tcp->fluid.interface) {
+        _tcp_setFluidWindow(tcp);
+    }
+}
+
+gboolean tcp_isFluid(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+    return tcp->fluid.interface != NULL ? TRUE : FALSE;
+}
+
+void tcp_clearFluidInterface(TCP* tcp) {
+    MAGIC_ASSERT(tcp);
+    /* the interface is going away and forgets us itself */
+    tcp->fluid.interface = NULL;
+}
+
 /* return TRUE if the packet should be retransmitted */
-void tcp_processPacket(TCP* tcp, Packet* packet) {
+static void _tcp_processPacket(TCP* tcp, Packet* packet, gboolean moreSegmentsFollow) {
     MAGIC_ASSERT(tcp);
 
     /* fetch the TCP info from the packet */
@@ -1673,8 +1865,12 @@ void tcp_processPacket(TCP* tcp, Packet* packet) {
     SimulationTime now = worker_getCurrentTime();
     gint nPacketsAcked = 0;
 
+    /* only data that arrives in order may have its ack delayed */
+    gboolean isInOrderData = (packetLength > 0 && header.sequence == tcp->receive.next) ? TRUE : FALSE;
+
     if(packetLength > 0) {
         flags |= _tcp_dataProcessing(tcp, packet, &header);
+        tcp->delayedACK.unackedSegments++;
     }
 
     if(header.flags & PTCP_ACK) {
@@ -1689,11 +1885,9 @@ void tcp_processPacket(TCP* tcp, Packet* packet) {
     }
 
     /* update the scoreboard and see if any packets have been lost */
-    GList* selectiveACKs = packet_copyTCPSelectiveACKs(packet);
-    flags |= scoreboard_update(tcp->retransmit.scoreboard, selectiveACKs, tcp->send.unacked, tcp->send.next);
-    if(selectiveACKs) {
-        g_list_free(selectiveACKs);
-    }
+    PacketTCPSelectiveACKs selectiveACKs;
+    packet_getTCPSelectiveACKs(packet, &selectiveACKs);
+    flags |= scoreboard_update(tcp->retransmit.scoreboard, &selectiveACKs, tcp->send.unacked, tcp->send.next);
 
     /* update the last time stamp value (RFC 1323) */
     tcp->receive.lastTimestamp = header.timestampValue;
@@ -1716,22 +1910,32 @@ void tcp_processPacket(TCP* tcp, Packet* packet) {
         _tcp_logCongestionInfo(tcp);
     }
 
+    if(flags & TCP_PF_DATA_ACKED) {
+        _tcp_updateFluid(tcp, now);
+    }
+
     /* now flush as many packets as we can to socket */
     _tcp_flush(tcp);
 
-    /* send ack if they need updates but we didn't send any yet (selective acks) */
-    if((tcp->receive.next > tcp->send.lastAcknowledgment) ||
+    /* send ack if they need updates but we didn't send any yet (selective acks).
+     * segments of a super-segment are acked as a unit after the last one. */
+    if(!moreSegmentsFollow &&
+        ((tcp->receive.next > tcp->send.lastAcknowledgment) ||
         (tcp->receive.window != tcp->send.lastWindow) ||
-        (tcp->congestion->fastRetransmit && header.sequence > tcp->receive.next)) 
+        (tcp->congestion->fastRetransmit && header.sequence > tcp->receive.next)))
     {
-        responseFlags |= PTCP_ACK;
+        if(responseFlags == PTCP_NONE && isInOrderData && _tcp_canDelayACK(tcp)) {
+            _tcp_scheduleDelayedACK(tcp);
+        } else {
+            responseFlags |= PTCP_ACK;
+        }
     }
 
     /* send control packet if we have one */
     if(responseFlags != PTCP_NONE) {
         debug("%s <-> %s: sending response control packet",
                 tcp->super.boundString, tcp->super.peerString);
-        Packet* response = _tcp_createPacket(tcp, responseFlags, NULL, 0);
+        Packet* response = _tcp_createPacket(tcp, responseFlags, NULL, 0, 0);
         _tcp_bufferPacketOut(tcp, response);
         _tcp_flush(tcp);
     }
@@ -1740,6 +1944,21 @@ void tcp_processPacket(TCP* tcp, Packet* packet) {
     tcp->receive.lastTimestamp = 0;
 }
 
+void tcp_processPacket(TCP* tcp, Packet* packet) {
+    MAGIC_ASSERT(tcp);
+
+    guint nSegments = packet_getSegmentCount(packet);
+    if(nSegments == 0) {
+        _tcp_processPacket(tcp, packet, FALSE);
+        return;
+    }
+
+    /* the segments keep their own headers and sequence numbers */
+    for(guint i = 0; i < nSegments; i++) {
+        _tcp_processPacket(tcp, packet_getSegment(packet, i), (i + 1 < nSegments) ? TRUE : FALSE);
+    }
+}
+
 void tcp_dropPacket(TCP* tcp, Packet* packet) {
     MAGIC_ASSERT(tcp);
 
@@ -1799,12 +2018,19 @@ gssize tcp_sendUserData(TCP* tcp, gconstpointer buffer, gsize nBytes, in_addr_t
     gsize maxPacketLength = CONFIG_MTU - CONFIG_HEADER_SIZE_TCPIPETH;
     gsize bytesCopied = 0;
 
+    /* copy the user data once, every segment references a slice of it.
+     * a NULL buffer asks for virtual bytes that are only generated if read. */
+    Payload* payload = NULL;
+    if(remaining > 0) {
+        payload = buffer ? payload_new(buffer, remaining) : payload_newVirtual(remaining);
+    }
+
     /* create as many packets as needed */
     while(remaining > 0) {
         gsize copyLength = MIN(maxPacketLength, remaining);
 
         /* use helper to create the packet */
-        Packet* packet = _tcp_createPacket(tcp, PTCP_ACK, buffer + bytesCopied, copyLength);
+        Packet* packet = _tcp_createPacket(tcp, PTCP_ACK, payload, bytesCopied, copyLength);
         if(copyLength > 0) {
             /* we are sending more user data */
             tcp->send.end++;
@@ -1817,6 +2043,11 @@ gssize tcp_sendUserData(TCP* tcp, gconstpointer buffer, gsize nBytes, in_addr_t
         bytesCopied += copyLength;
     }
 
+    if(payload) {
+        /* the packets hold their own references */
+        payload_unref(payload);
+    }
+
     debug("%s <-> %s: sending %"G_GSIZE_FORMAT" user bytes", tcp->super.boundString, tcp->super.peerString, bytesCopied);
 
     /* now flush as much as possible out to socket */
@@ -1832,7 +2063,7 @@ static void _tcp_sendWindowUpdate(TCP* tcp, gpointer data) {
             tcp->super.boundString, tcp->super.peerString, tcp->receive.window);
 
     // XXX we may be in trouble if this packet gets dropped
-    Packet* windowUpdate = _tcp_createPacket(tcp, PTCP_ACK, NULL, 0);
+    Packet* windowUpdate = _tcp_createPacket(tcp, PTCP_ACK, NULL, 0, 0);
     _tcp_bufferPacketOut(tcp, windowUpdate);
     _tcp_flush(tcp);
 
@@ -1976,10 +2207,16 @@ gssize tcp_receiveUserData(TCP* tcp, gpointer buffer, gsize nBytes, in_addr_t* i
 void tcp_free(TCP* tcp) {
     MAGIC_ASSERT(tcp);
 
-    priorityqueue_free(tcp->throttledOutput);
-    priorityqueue_free(tcp->unorderedInput);
-    g_hash_table_destroy(tcp->retransmit.queue);
-    priorityqueue_free(tcp->retransmit.scheduledTimerExpirations);
+    /* a stale demand would shrink the share of the other flows */
+    _tcp_leaveFluid(tcp);
+
+    g_queue_free_full(tcp->throttledControl, (GDestroyNotify)packet_unref);
+    sequencering_free(tcp->throttledOutput);
+    sequencering_free(tcp->unorderedInput);
+    sequencering_free(tcp->retransmit.queue);
+    g_array_free(tcp->send.selectiveACKs, TRUE);
+    wheeltimer_free(tcp->retransmit.timer);
+    wheeltimer_free(tcp->delayedACK.timer);
 
     if(tcp->child) {
         MAGIC_ASSERT(tcp->child);
@@ -2024,7 +2261,7 @@ void tcp_close(TCP* tcp) {
 
         case TCPS_SYNRECEIVED:
         case TCPS_SYNSENT: {
-            Packet* reset = _tcp_createPacket(tcp, PTCP_RST, NULL, 0);
+            Packet* reset = _tcp_createPacket(tcp, PTCP_RST, NULL, 0, 0);
             _tcp_bufferPacketOut(tcp, reset);
             _tcp_flush(tcp);
             return;
@@ -2039,7 +2276,7 @@ void tcp_close(TCP* tcp) {
     }
 
     /* send a FIN */
-    Packet* packet = _tcp_createPacket(tcp, PTCP_FIN, NULL, 0);
+    Packet* packet = _tcp_createPacket(tcp, PTCP_FIN, NULL, 0, 0);
 
     /* dont have to worry about space since this has no payload */
     _tcp_bufferPacketOut(tcp, packet);
@@ -2119,16 +2356,18 @@ TCP* tcp_new(gint handle, guint receiveBufferSize, guint sendBufferSize) {
     tcp->receive.lastAcknowledgment = initialSequenceNumber;
 
     tcp->autotune.isEnabled = TRUE;
+    tcp->delayedACK.segmentsPerACK = (guint) config->tcpDelayedACKSegments;
 
-    tcp->throttledOutput =
-            priorityqueue_new((GCompareDataFunc)packet_compareTCPSequence, NULL, (GDestroyNotify)packet_unref);
-    tcp->unorderedInput =
-            priorityqueue_new((GCompareDataFunc)packet_compareTCPSequence, NULL, (GDestroyNotify)packet_unref);
-    tcp->retransmit.queue =
-            g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)packet_unref);
+    tcp->throttledControl = g_queue_new();
+    tcp->throttledOutput = sequencering_new((GDestroyNotify)packet_unref);
+    tcp->unorderedInput = sequencering_new((GDestroyNotify)packet_unref);
+    tcp->retransmit.queue = sequencering_new((GDestroyNotify)packet_unref);
     tcp->retransmit.scoreboard = scoreboard_new();
-    tcp->retransmit.scheduledTimerExpirations =
-            priorityqueue_new((GCompareDataFunc)utility_simulationTimeCompare, NULL, g_free);
+    tcp->send.selectiveACKs = g_array_new(FALSE, FALSE, sizeof(PacketTCPSelectiveACKBlock));
+
+    TimerWheel* timers = host_getTimerWheel(worker_getCurrentHost());
+    tcp->retransmit.timer = wheeltimer_new(timers, (CallbackFunc)_tcp_retransmitTimerExpired, tcp, NULL);
+    tcp->delayedACK.timer = wheeltimer_new(timers, (CallbackFunc)_tcp_sendDelayedACK, tcp, NULL);
 
     /* TCP_TIMEOUT_INIT=1000ms from net/tcp.h */
     _tcp_setRetransmitTimeout(tcp, 1000);
@@ -26,7 +26,9 @@ void tcp_getInfo(TCP* tcp, struct tcp_info *tcpinfo);
 void tcp_enterServerMode(TCP* tcp, gint backlog);
 gint tcp_acceptServerPeer(TCP* tcp, in_addr_t* ip, in_port_t* port, gint* acceptedHandle);
 void tcp_closeTimerExpired(TCP* tcp);
-void tcp_retransmitTimerExpired(TCP* tcp);
+gboolean tcp_isFluid(TCP* tcp);
+/* called by an interface that is freed while we are one of its fluid flows */
+void tcp_clearFluidInterface(TCP* tcp);
 
 void tcp_clearAllChildrenIfServer(TCP* tcp);
 
@@ -18,12 +18,9 @@ struct _Timer {
     /* number of expires that happened since the timer was last set */
     guint64 expireCountSinceLastSet;
 
-    /* expire ids are used internally to cancel events that fire after
-     * they have become invalid because the user reset the timer */
-    guint nextExpireID;
-    guint minValidExpireID;
+    /* armed in our host's timer wheel while we are set to expire */
+    WheelTimer* expireTimer;
 
-    guint numEventsScheduled;
     gboolean isClosed;
 
     MAGIC_DECLARE;
@@ -32,16 +29,20 @@ struct _Timer {
 static void _timer_close(Timer* timer) {
     MAGIC_ASSERT(timer);
     timer->isClosed = TRUE;
+    wheeltimer_cancel(timer->expireTimer);
     descriptor_adjustStatus(&(timer->super), DS_ACTIVE, FALSE);
     host_closeDescriptor(worker_getCurrentHost(), timer->super.handle);
 }
 
 static void _timer_free(Timer* timer) {
     MAGIC_ASSERT(timer);
+    wheeltimer_free(timer->expireTimer);
     MAGIC_CLEAR(timer);
     g_free(timer);
 }
 
+static void _timer_expire(Timer* timer, gpointer data);
+
 static DescriptorFunctionTable _timerFunctions = {
     (DescriptorFunc) _timer_close,
     (DescriptorFunc) _timer_free,
@@ -70,6 +71,9 @@ Timer* timer_new(gint handle, gint clockid, gint flags) {
     descriptor_init(&(timer->super), DT_TIMER, &_timerFunctions, handle);
     descriptor_adjustStatus(&(timer->super), DS_ACTIVE, TRUE);
 
+    timer->expireTimer = wheeltimer_new(host_getTimerWheel(worker_getCurrentHost()),
+            (CallbackFunc)_timer_expire, timer, NULL);
+
     return timer;
 }
 
@@ -125,7 +129,7 @@ static void _timer_disarm(Timer* timer) {
     MAGIC_ASSERT(timer);
     timer->nextExpireTime = 0;
     timer->expireInterval = 0;
-    timer->minValidExpireID = timer->nextExpireID;
+    wheeltimer_cancel(timer->expireTimer);
     debug("timer fd %i disarmed", timer->super.handle);
 }
 
@@ -167,58 +171,44 @@ static void _timer_setCurrentInterval(Timer* timer, const struct timespec* confi
     timer->expireInterval = _timer_timespecToSimTime(config);
 }
 
-static void _timer_expire(Timer* timer, gpointer data);
-
 static void _timer_scheduleNewExpireEvent(Timer* timer) {
     MAGIC_ASSERT(timer);
-
-    /* callback to our own node */
-    gpointer next = GUINT_TO_POINTER(timer->nextExpireID);
-    CallbackEvent* event = callback_new((CallbackFunc)_timer_expire, timer, next);
-
-    /* ref the timer storage in the callback event */
-    descriptor_ref(&timer->super);
-
-    SimulationTime nanos = timer->nextExpireTime - worker_getCurrentTime();
-    worker_scheduleEvent((Event*)event, nanos, 0);
-
-    timer->nextExpireID++;
-    timer->numEventsScheduled++;
+    /* re-arming replaces any expiration we had pending */
+    wheeltimer_arm(timer->expireTimer, timer->nextExpireTime);
 }
 
 static void _timer_expire(Timer* timer, gpointer data) {
     MAGIC_ASSERT(timer);
 
-    guint expireID = GPOINTER_TO_UINT(data);
-    debug("timer fd %i expired; isClosed=%i expireID=%u minValidExpireID=%u", timer->isClosed, expireID, timer->minValidExpireID);
-
-    timer->numEventsScheduled--;
-
-    /* make sure the timer has not been reset since we scheduled this expiration event */
-    if(!timer->isClosed && expireID >= timer->minValidExpireID) {
-        /* if a one-time (non-periodic) timer already expired before they
-         * started listening for the event with epoll, the event is reported
-         * immediately on the next epoll_wait call. this behavior was
-         * verified on linux. */
-        timer->expireCountSinceLastSet++;
-        descriptor_adjustStatus(&(timer->super), DS_READABLE, TRUE);
-
-        if(timer->expireInterval > 0) {
-            SimulationTime now = worker_getCurrentTime();
-            timer->nextExpireTime += timer->expireInterval;
-            if(timer->nextExpireTime < now) {
-                /* for some reason we looped the interval. expire again immediately
-                 * to keep the periodic timer going. */
-                timer->nextExpireTime = now;
-            }
-            _timer_scheduleNewExpireEvent(timer);
-        } else {
-            /* the timer is now disarmed */
-            _timer_disarm(timer);
+    /* the wheel does not run expirations that were reset or closed */
+    debug("timer fd %i expired", timer->super.handle);
+
+    /* make sure we are still around if a listener closes us */
+    descriptor_ref(&timer->super);
+
+    /* if a one-time (non-periodic) timer already expired before they
+     * started listening for the event with epoll, the event is reported
+     * immediately on the next epoll_wait call. this behavior was
+     * verified on linux. */
+    timer->expireCountSinceLastSet++;
+    descriptor_adjustStatus(&(timer->super), DS_READABLE, TRUE);
+
+    if(timer->isClosed) {
+        /* a listener closed us, so we should not be re-armed */
+    } else if(timer->expireInterval > 0) {
+        SimulationTime now = worker_getCurrentTime();
+        timer->nextExpireTime += timer->expireInterval;
+        if(timer->nextExpireTime < now) {
+            /* for some reason we looped the interval. expire again immediately
+             * to keep the periodic timer going. */
+            timer->nextExpireTime = now;
         }
+        _timer_scheduleNewExpireEvent(timer);
+    } else {
+        /* the timer is now disarmed */
+        _timer_disarm(timer);
     }
 
-    /* unref the timer storage in the callback event */
     descriptor_unref(&timer->super);
 }
 
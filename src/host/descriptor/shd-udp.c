@@ -69,6 +69,13 @@ gssize udp_sendUserData(UDP* udp, gconstpointer buffer, gsize nBytes, in_addr_t
     gsize remaining = nBytes;
     gsize offset = 0;
 
+    /* copy the user data once, every datagram references a slice of it.
+     * a NULL buffer asks for virtual bytes that are only generated if read. */
+    Payload* payload = NULL;
+    if(nBytes > 0) {
+        payload = buffer ? payload_new(buffer, nBytes) : payload_newVirtual(nBytes);
+    }
+
     /* create as many packets as needed */
     while(remaining > 0) {
         gsize copyLength = MIN(maxPacketLength, remaining);
@@ -93,7 +100,7 @@ gssize udp_sendUserData(UDP* udp, gconstpointer buffer, gsize nBytes, in_addr_t
         utility_assert(sourceIP && sourcePort && destinationIP && destinationPort);
 
         /* create the UDP packet */
-        Packet* packet = packet_new(buffer + offset, copyLength);
+        Packet* packet = packet_newSlice(payload, offset, copyLength);
         packet_setUDP(packet, PUDP_NONE, sourceIP, sourcePort, destinationIP, destinationPort);
         packet_addDeliveryStatus(packet, PDS_SND_CREATED);
 
@@ -110,6 +117,10 @@ gssize udp_sendUserData(UDP* udp, gconstpointer buffer, gsize nBytes, in_addr_t
         }
     }
 
+    if(payload) {
+        payload_unref(payload);
+    }
+
     /* update the tracker output buffer stats */
     Tracker* tracker = host_getTracker(worker_getCurrentHost());
     Socket* socket = (Socket* )udp;
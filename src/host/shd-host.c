@@ -27,6 +27,12 @@ struct _Host {
     /* a statistics tracker for in/out bytes, CPU, memory, etc. */
     Tracker* tracker;
 
+    /* the heap that serves all memory allocated by this node's plugins */
+    Arena* arena;
+
+    /* recent getaddrinfo results of this node's plugins */
+    ResolverCache* resolverCache;
+
     /* this node's loglevel */
     GLogLevelFlags logLevel;
 
@@ -45,6 +51,8 @@ struct _Host {
 
     /* all file, socket, and epoll descriptors we know about and track */
     GHashTable* descriptors;
+    /* timers of our descriptors, run from a single event in our queue */
+    TimerWheel* timers;
     guint64 receiveBufferSize;
     guint64 sendBufferSize;
     gboolean autotuneReceiveBuffer;
@@ -73,9 +81,9 @@ struct _Host {
     MAGIC_DECLARE;
 };
 
-Host* host_new(GQuark id, gchar* hostname, gchar* ipHint, gchar* geocodeHint, gchar* typeHint,
-        guint64 requestedBWDownKiBps, guint64 requestedBWUpKiBps,
-        guint cpuFrequency, gint cpuThreshold, gint cpuPrecision, guint nodeSeed,
+Host* host_new(GQuark id, gchar* hostname, Address* ethernetAddress, Random* random,
+        guint64 bwDownKiBps, guint64 bwUpKiBps,
+        guint cpuFrequency, gint cpuThreshold, gint cpuPrecision,
         SimulationTime heartbeatInterval, GLogLevelFlags heartbeatLogLevel, gchar* heartbeatLogInfo,
         GLogLevelFlags logLevel, gboolean logPcap, gchar* pcapDir, gchar* qdisc,
         guint64 receiveBufferSize, gboolean autotuneReceiveBuffer,
@@ -86,24 +94,14 @@ Host* host_new(GQuark id, gchar* hostname, gchar* ipHint, gchar* geocodeHint, gc
 
     host->id = id;
     host->name = g_strdup(hostname);
-    host->random = random_new(nodeSeed);
+    utility_assert(random);
+    host->random = random;
 
-    /* get unique virtual address identifiers for each network interface */
+    /* get unique virtual address identifiers for each network interface.
+     * the ethernet address was already assigned in bulk and attached to the
+     * topology by our creator. */
+    utility_assert(ethernetAddress);
     Address* loopbackAddress = dns_register(worker_getDNS(), host->id, host->name, "127.0.0.1");
-    Address* ethernetAddress = dns_register(worker_getDNS(), host->id, host->name, ipHint);
-
-    /* connect to topology and get the default bandwidth */
-    guint64 bwDownKiBps = 0, bwUpKiBps = 0;
-    topology_attach(worker_getTopology(), ethernetAddress, host->random,
-            ipHint, geocodeHint, typeHint, &bwDownKiBps, &bwUpKiBps);
-
-    /* prefer assigned bandwidth if available */
-    if(requestedBWDownKiBps) {
-        bwDownKiBps = requestedBWDownKiBps;
-    }
-    if(requestedBWUpKiBps) {
-        bwUpKiBps = requestedBWUpKiBps;
-    }
 
     /* virtual addresses and interfaces for managing network I/O */
     NetworkInterface* loopback = networkinterface_new(loopbackAddress, G_MAXUINT32, G_MAXUINT32,
@@ -127,6 +125,7 @@ Host* host_new(GQuark id, gchar* hostname, gchar* ipHint, gchar* geocodeHint, gc
 
     /* virtual descriptor management */
     host->descriptors = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, descriptor_unref);
+    host->timers = timerwheel_new();
     host->receiveBufferSize = receiveBufferSize;
     host->sendBufferSize = sendBufferSize;
     host->autotuneReceiveBuffer = autotuneReceiveBuffer;
@@ -142,6 +141,8 @@ Host* host_new(GQuark id, gchar* hostname, gchar* ipHint, gchar* geocodeHint, gc
 
     host->cpu = cpu_new(cpuFrequency, cpuThreshold, cpuPrecision);
     host->tracker = tracker_new(heartbeatInterval, heartbeatLogLevel, heartbeatLogInfo);
+    host->arena = arena_new();
+    host->resolverCache = resolvercache_new(CONFIG_RESOLVER_CACHE_SIZE);
     host->logLevel = logLevel;
     host->logPcap = logPcap;
     host->pcapDir = pcapDir;
@@ -186,6 +187,7 @@ void host_free(Host* host, gpointer userData) {
     }
 
     g_hash_table_destroy(host->descriptors);
+    timerwheel_free(host->timers);
     g_hash_table_destroy(host->shadowToOSHandleMap);
     g_hash_table_destroy(host->osToShadowHandleMap);
     g_hash_table_destroy(host->randomShadowHandleMap);
@@ -196,6 +198,9 @@ void host_free(Host* host, gpointer userData) {
     eventqueue_free(host->events);
     cpu_free(host->cpu);
     tracker_free(host->tracker);
+    resolvercache_free(host->resolverCache);
+    /* also reclaims everything the plugins never freed */
+    arena_free(host->arena);
 
     g_queue_free(host->availableDescriptors);
     random_free(host->random);
@@ -289,6 +294,11 @@ gchar* host_getName(Host* host) {
     return host->name;
 }
 
+TimerWheel* host_getTimerWheel(Host* host) {
+    MAGIC_ASSERT(host);
+    return host->timers;
+}
+
 Address* host_getDefaultAddress(Host* host) {
     MAGIC_ASSERT(host);
     return networkinterface_getAddress(host->defaultInterface);
@@ -1325,6 +1335,11 @@ gint host_sendUserData(Host* host, gint handle, gconstpointer buffer, gsize nByt
         return EBADF;
     }
 
+    /* only sockets can carry virtual payloads */
+    if(buffer == NULL && nBytes > 0 && type == DT_PIPE) {
+        return EINVAL;
+    }
+
     Transport* transport = (Transport*) descriptor;
 
     /* we should block if our cpu has been too busy lately */
@@ -1465,6 +1480,16 @@ Tracker* host_getTracker(Host* host) {
     return host->tracker;
 }
 
+Arena* host_getArena(Host* host) {
+    MAGIC_ASSERT(host);
+    return host->arena;
+}
+
+ResolverCache* host_getResolverCache(Host* host) {
+    MAGIC_ASSERT(host);
+    return host->resolverCache;
+}
+
 GLogLevelFlags host_getLogLevel(Host* host) {
     MAGIC_ASSERT(host);
     return host->logLevel;
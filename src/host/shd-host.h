@@ -13,9 +13,12 @@
 
 typedef struct _Host Host;
 
-Host* host_new(GQuark id, gchar* hostname, gchar* requestedIP, gchar* geocodeHint, gchar* typeHint,
-        guint64 requestedBWDownKiBps, guint64 requestedBWUpKiBps,
-        guint cpuFrequency, gint cpuThreshold, gint cpuPrecision, guint nodeSeed,
+/* the ethernetAddress must already be registered with the DNS and attached to
+ * the topology. the new host takes over the caller's reference to it, and
+ * owns the random stream from then on. */
+Host* host_new(GQuark id, gchar* hostname, Address* ethernetAddress, Random* random,
+        guint64 bwDownKiBps, guint64 bwUpKiBps,
+        guint cpuFrequency, gint cpuThreshold, gint cpuPrecision,
         SimulationTime heartbeatInterval, GLogLevelFlags heartbeatLogLevel, gchar* heartbeatLogInfo,
         GLogLevelFlags logLevel, gboolean logPcap, gchar* pcapDir, gchar* qdisc,
         guint64 receiveBufferSize, gboolean autotuneReceiveBuffer,
@@ -37,6 +40,7 @@ void host_freeAllApplications(Host* host);
 gint host_compare(gconstpointer a, gconstpointer b, gpointer user_data);
 gboolean host_isEqual(Host* a, Host* b);
 CPU* host_getCPU(Host* host);
+TimerWheel* host_getTimerWheel(Host* host);
 gchar* host_getName(Host* host);
 Address* host_getDefaultAddress(Host* host);
 in_addr_t host_getDefaultIP(Host* host);
@@ -79,6 +83,8 @@ gint host_getPeerName(Host* host, gint handle, const struct sockaddr* address, s
 gint host_getSocketName(Host* host, gint handle, const struct sockaddr* address, socklen_t* len);
 
 Tracker* host_getTracker(Host* host);
+Arena* host_getArena(Host* host);
+ResolverCache* host_getResolverCache(Host* host);
 GLogLevelFlags host_getLogLevel(Host* host);
 gchar host_isLoggingPcap(Host *host);
 
@@ -13,7 +13,14 @@ enum NetworkInterfaceFlags {
 };
 
 enum NetworkInterfaceQDisc {
-    NIQ_NONE=0, NIQ_FIFO=1, NIQ_RR=2,
+    NIQ_NONE=0, NIQ_FIFO=1, NIQ_RR=2, NIQ_DRR=3, NIQ_FQCODEL=4,
+};
+
+/* sockets waiting to send, linked through their send links */
+typedef struct _NetworkInterfaceSendList NetworkInterfaceSendList;
+struct _NetworkInterfaceSendList {
+    SocketSendLink* head;
+    SocketSendLink* tail;
 };
 
 struct _NetworkInterface {
@@ -34,10 +41,23 @@ struct _NetworkInterface {
     GQueue* inBuffer;
     gsize inBufferSize;
     gsize inBufferLength;
+    /* fluid windows are accepted beyond the buffer size, so they are counted
+     * separately and never take space from the packet-level traffic */
+    gsize inBufferFluidLength;
 
     /* Transports wanting to send data out */
-    GQueue* rrQueue;
     PriorityQueue* fifoQueue;
+    /* used by rr and drr, and as the old flows of fq_codel */
+    NetworkInterfaceSendList sendList;
+    NetworkInterfaceSendList newFlowList;
+    /* which send link of the sockets belongs to us */
+    guint sendLinkIndex;
+
+    /* flows sending at the flow level, they share our upstream bandwidth.
+     * maps each flow to its demand in bytes per second, 0 if unlimited */
+    GHashTable* fluidFlows;
+    /* the max-min fair allocation of the unlimited flows, negative if stale */
+    gdouble fluidFlowLevel;
 
     /* bandwidth accounting */
     SimulationTime lastTimeReceived;
@@ -56,6 +76,42 @@ static gint _networkinterface_compareSocket(const Socket* sa, const Socket* sb,
     return packet_getPriority(pa) > packet_getPriority(pb) ? +1 : -1;
 }
 
+static void _networkinterface_pushSendLink(NetworkInterfaceSendList* list, SocketSendLink* link) {
+    link->next = NULL;
+    if(list->tail) {
+        list->tail->next = link;
+    } else {
+        list->head = link;
+    }
+    list->tail = link;
+}
+
+static SocketSendLink* _networkinterface_popSendLink(NetworkInterfaceSendList* list) {
+    SocketSendLink* link = list->head;
+    if(link) {
+        list->head = link->next;
+        if(!list->head) {
+            list->tail = NULL;
+        }
+        link->next = NULL;
+    }
+    return link;
+}
+
+static void _networkinterface_releaseSendLink(SocketSendLink* link) {
+    /* the socket has no more packets, unref it from the sendable queue */
+    link->flags = SSL_NONE;
+    link->deficit = 0;
+    descriptor_unref((Descriptor*) link->socket);
+}
+
+static void _networkinterface_clearSendList(NetworkInterfaceSendList* list) {
+    SocketSendLink* link = NULL;
+    while((link = _networkinterface_popSendLink(list)) != NULL) {
+        _networkinterface_releaseSendLink(link);
+    }
+}
+
 NetworkInterface* networkinterface_new(Address* address, guint64 bwDownKiBps, guint64 bwUpKiBps,
         gboolean logPcap, gchar* pcapDir, gchar* qdisc, guint64 interfaceReceiveLength) {
     NetworkInterface* interface = g_new0(NetworkInterface, 1);
@@ -76,16 +132,24 @@ NetworkInterface* networkinterface_new(Address* address, guint64 bwDownKiBps, gu
     interface->inBuffer = g_queue_new();
     interface->inBufferSize = interfaceReceiveLength;
 
+    interface->fluidFlows = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+    interface->fluidFlowLevel = -1;
+
     /* incoming packets get passed along to sockets */
     interface->boundSockets = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, descriptor_unref);
 
     /* sockets tell us when they want to start sending */
-    interface->rrQueue = g_queue_new();
     interface->fifoQueue = priorityqueue_new((GCompareDataFunc)_networkinterface_compareSocket, NULL, descriptor_unref);
+    interface->sendLinkIndex = address_toNetworkIP(address) == htonl(INADDR_LOOPBACK) ?
+            SOCKET_SEND_LINK_LOOPBACK : SOCKET_SEND_LINK_ETHERNET;
 
     /* parse queuing discipline */
     if (qdisc && !g_ascii_strcasecmp(qdisc, "rr")) {
         interface->qdisc = NIQ_RR;
+    } else if (qdisc && !g_ascii_strcasecmp(qdisc, "drr")) {
+        interface->qdisc = NIQ_DRR;
+    } else if (qdisc && !g_ascii_strcasecmp(qdisc, "fq_codel")) {
+        interface->qdisc = NIQ_FQCODEL;
     } else {
         interface->qdisc = NIQ_FIFO;
     }
@@ -101,7 +165,8 @@ NetworkInterface* networkinterface_new(Address* address, guint64 bwDownKiBps, gu
 
     info("bringing up network interface '%s' at '%s', %"G_GUINT64_FORMAT" KiB/s up and %"G_GUINT64_FORMAT" KiB/s down using queuing discipline %s",
             address_toHostName(interface->address), address_toHostIPString(interface->address), bwUpKiBps, bwDownKiBps,
-            interface->qdisc == NIQ_RR ? "rr" : "fifo");
+            interface->qdisc == NIQ_RR ? "rr" : interface->qdisc == NIQ_DRR ? "drr" :
+            interface->qdisc == NIQ_FQCODEL ? "fq_codel" : "fifo");
 
     return interface;
 }
@@ -117,16 +182,23 @@ void networkinterface_free(NetworkInterface* interface) {
     g_queue_free(interface->inBuffer);
 
     /* unref all sockets wanting to send */
-    while(interface->rrQueue && !g_queue_is_empty(interface->rrQueue)) {
-        Socket* socket = g_queue_pop_head(interface->rrQueue);
-        descriptor_unref(socket);
-    }
-    g_queue_free(interface->rrQueue);
+    _networkinterface_clearSendList(&(interface->sendList));
+    _networkinterface_clearSendList(&(interface->newFlowList));
 
     priorityqueue_free(interface->fifoQueue);
 
     g_hash_table_destroy(interface->boundSockets);
 
+    /* the host frees its interfaces before its sockets, so make sure the
+     * flows that outlive us do not try to leave us later */
+    GHashTableIter iter;
+    gpointer socket = NULL;
+    g_hash_table_iter_init(&iter, interface->fluidFlows);
+    while(g_hash_table_iter_next(&iter, &socket, NULL)) {
+        tcp_clearFluidInterface((TCP*)socket);
+    }
+    g_hash_table_destroy(interface->fluidFlows);
+
     dns_deregister(worker_getDNS(), interface->address);
     address_unref(interface->address);
 
@@ -202,6 +274,29 @@ void networkinterface_disassociate(NetworkInterface* interface, Socket* socket)
     g_hash_table_remove(interface->boundSockets, GINT_TO_POINTER(key));
 }
 
+static void _networkinterface_trackInput(NetworkInterface* interface, Packet* packet, gint socketHandle) {
+    /* the tracker and pcap see the segments as they would appear on the wire */
+    guint nSegments = packet_getSegmentCount(packet);
+    for(guint i = 0; i < MAX(nSegments, 1); i++) {
+        Packet* segment = nSegments > 0 ? packet_getSegment(packet, i) : packet;
+        tracker_addInputBytes(host_getTracker(worker_getCurrentHost()), segment, socketHandle);
+        if(interface->pcap) {
+            pcapwriter_writePacket(interface->pcap, segment);
+        }
+    }
+}
+
+static void _networkinterface_trackOutput(NetworkInterface* interface, Packet* packet, gint socketHandle) {
+    guint nSegments = packet_getSegmentCount(packet);
+    for(guint i = 0; i < MAX(nSegments, 1); i++) {
+        Packet* segment = nSegments > 0 ? packet_getSegment(packet, i) : packet;
+        tracker_addOutputBytes(host_getTracker(worker_getCurrentHost()), segment, socketHandle);
+        if(interface->pcap) {
+            pcapwriter_writePacket(interface->pcap, segment);
+        }
+    }
+}
+
 static void _networkinterface_scheduleNextReceive(NetworkInterface* interface) {
     /* the next packets need to be received and processed */
     SimulationTime batchTime = worker_getConfig()->interfaceBatchTime;
@@ -218,7 +313,11 @@ static void _networkinterface_scheduleNextReceive(NetworkInterface* interface) {
 
         /* free up buffer space */
         guint length = packet_getPayloadLength(packet) + packet_getHeaderSize(packet);
-        interface->inBufferLength -= length;
+        if(packet_isFluid(packet)) {
+            interface->inBufferFluidLength -= length;
+        } else {
+            interface->inBufferLength -= length;
+        }
 
         /* calculate how long it took to 'receive' this packet */
         interface->receiveNanosecondsConsumed += (length * interface->timePerByteDown);
@@ -237,10 +336,7 @@ static void _networkinterface_scheduleNextReceive(NetworkInterface* interface) {
         }
 
         /* count our bandwidth usage by interface, and by socket handle if possible */
-        tracker_addInputBytes(host_getTracker(worker_getCurrentHost()), packet, socketHandle);
-        if(interface->pcap) {
-            pcapwriter_writePacket(interface->pcap, packet);
-        }
+        _networkinterface_trackInput(interface, packet, socketHandle);
 
         packet_unref(packet);
     }
@@ -268,11 +364,18 @@ void networkinterface_packetArrived(NetworkInterface* interface, Packet* packet)
     gssize space = interface->inBufferSize - interface->inBufferLength;
     utility_assert(space >= 0);
 
-    if(length <= space) {
+    /* a flow-level window may be larger than our buffer, but its sender
+     * already limited it to its share of the bandwidth */
+    gboolean isFluid = packet_isFluid(packet);
+    if(length <= space || isFluid) {
         /* we have space to buffer it */
         packet_ref(packet);
         g_queue_push_tail(interface->inBuffer, packet);
-        interface->inBufferLength += length;
+        if(isFluid) {
+            interface->inBufferFluidLength += length;
+        } else {
+            interface->inBufferLength += length;
+        }
         packet_addDeliveryStatus(packet, PDS_RCV_INTERFACE_BUFFERED);
 
         /* we need a trigger if we are not currently receiving */
@@ -322,22 +425,225 @@ void networkinterface_received(NetworkInterface* interface) {
     _networkinterface_scheduleNextReceive(interface);
 }
 
+static gboolean _networkinterface_canCoalesce(Packet* packet, Packet* next) {
+    if(!next || packet_getProtocol(next) != PTCP || packet_getPayloadLength(next) == 0) {
+        return FALSE;
+    }
+
+    /* the socket output is a single flow, but make sure before we merge */
+    return packet_getDestinationIP(next) == packet_getDestinationIP(packet) &&
+            packet_getDestinationAssociationKey(next) == packet_getDestinationAssociationKey(packet);
+}
+
+/* segmentation offload: carry consecutive data segments of one socket as a single
+ * super-segment, so that they cost one event on the way to the receiver */
+static Packet* _networkinterface_pullOutPacket(NetworkInterface* interface, Socket* socket) {
+    Packet* packet = socket_pullOutPacket(socket);
+    gint maxSegments = worker_getConfig()->tcpSegmentOffload;
+
+    /* flow-level tcp flows send their whole window at once */
+    gboolean isFluid = descriptor_getType((Descriptor*)socket) == DT_TCPSOCKET &&
+            tcp_isFluid((TCP*)socket);
+    if(isFluid) {
+        maxSegments = G_MAXINT;
+    }
+
+    if(!packet || maxSegments <= 1 || packet_getProtocol(packet) != PTCP ||
+            packet_getPayloadLength(packet) == 0 ||
+            (!isFluid && !_networkinterface_canCoalesce(packet, socket_peekNextPacket(socket)))) {
+        return packet;
+    }
+
+    Packet* superSegment = packet_newSuperSegment(packet);
+    while(packet_getSegmentCount(superSegment) < (guint)maxSegments &&
+            _networkinterface_canCoalesce(packet, socket_peekNextPacket(socket))) {
+        packet_appendSegment(superSegment, socket_pullOutPacket(socket));
+    }
+
+    if(isFluid) {
+        packet_setFluid(superSegment);
+    }
+
+    return superSegment;
+}
+
 /* round robin queuing discipline ($ man tc)*/
 static Packet* _networkinterface_selectRoundRobin(NetworkInterface* interface, gint* socketHandle) {
     Packet* packet = NULL;
 
-    while(!packet && !g_queue_is_empty(interface->rrQueue)) {
+    while(!packet && interface->sendList.head) {
         /* do round robin to get the next packet from the next socket */
-        Socket* socket = g_queue_pop_head(interface->rrQueue);
-        packet = socket_pullOutPacket(socket);
+        SocketSendLink* link = _networkinterface_popSendLink(&(interface->sendList));
+        Socket* socket = link->socket;
+        packet = _networkinterface_pullOutPacket(interface, socket);
         *socketHandle = *descriptor_getHandleReference((Descriptor*)socket);
 
         if(socket_peekNextPacket(socket)) {
             /* socket has more packets, and is still reffed from before */
-            g_queue_push_tail(interface->rrQueue, socket);
+            _networkinterface_pushSendLink(&(interface->sendList), link);
         } else {
-            /* socket has no more packets, unref it from the sendable queue */
-            descriptor_unref((Descriptor*) socket);
+            _networkinterface_releaseSendLink(link);
+        }
+    }
+
+    return packet;
+}
+
+static guint _networkinterface_getWireLength(Packet* packet) {
+    return packet_getPayloadLength(packet) + packet_getHeaderSize(packet);
+}
+
+/* deficit round robin queuing discipline. every socket may send up to a quantum
+ * of bytes per round, so sockets sending small packets get their fair share */
+static Packet* _networkinterface_selectDeficitRoundRobin(NetworkInterface* interface, gint* socketHandle) {
+    Packet* packet = NULL;
+
+    while(!packet && interface->sendList.head) {
+        SocketSendLink* link = interface->sendList.head;
+        Socket* socket = link->socket;
+
+        /* another interface may have taken the packets of the socket */
+        Packet* next = socket_peekNextPacket(socket);
+        if(!next) {
+            _networkinterface_popSendLink(&(interface->sendList));
+            _networkinterface_releaseSendLink(link);
+            continue;
+        }
+
+        if(link->deficit < (gint64)_networkinterface_getWireLength(next)) {
+            /* out of credit for this round, move on to the next socket */
+            link->deficit += CONFIG_MTU;
+            _networkinterface_popSendLink(&(interface->sendList));
+            _networkinterface_pushSendLink(&(interface->sendList), link);
+            continue;
+        }
+
+        packet = _networkinterface_pullOutPacket(interface, socket);
+        *socketHandle = *descriptor_getHandleReference((Descriptor*)socket);
+        link->deficit -= _networkinterface_getWireLength(packet);
+
+        if(!socket_peekNextPacket(socket)) {
+            _networkinterface_popSendLink(&(interface->sendList));
+            _networkinterface_releaseSendLink(link);
+        }
+    }
+
+    return packet;
+}
+
+static gboolean _networkinterface_codelIsAboveTarget(SocketSendLink* link, Packet* packet, SimulationTime now) {
+    SimulationTime sojourn = now - packet_getBufferedTime(packet);
+
+    if(sojourn < CONFIG_CODEL_TARGET || socket_getOutputBufferLength(link->socket) <= CONFIG_MTU) {
+        /* the queue went below target, or is too small to need dropping */
+        link->firstAboveTime = 0;
+        return FALSE;
+    }
+
+    if(link->firstAboveTime == 0) {
+        /* wait an interval to see if the queue is standing */
+        link->firstAboveTime = now + CONFIG_CODEL_INTERVAL;
+        return FALSE;
+    }
+
+    return now >= link->firstAboveTime ? TRUE : FALSE;
+}
+
+static SimulationTime _networkinterface_codelControlLaw(SimulationTime time, guint count) {
+    /* drop more often the longer the queue stands */
+    return time + (SimulationTime)(CONFIG_CODEL_INTERVAL / sqrt((gdouble)count));
+}
+
+static void _networkinterface_codelDrop(NetworkInterface* interface, SocketSendLink* link) {
+    Packet* packet = socket_pullOutPacket(link->socket);
+    packet_addDeliveryStatus(packet, PDS_SND_INTERFACE_DROPPED);
+    link->dropCount++;
+    debug("fq_codel dropped a packet from a standing queue on socket %i",
+            *descriptor_getHandleReference((Descriptor*)link->socket));
+    packet_unref(packet);
+}
+
+/* the codel dequeue (rfc 8289): drop packets at the head of a socket that has had
+ * a standing queue for an interval, more often while it stays above target */
+static Packet* _networkinterface_codelDequeue(NetworkInterface* interface, SocketSendLink* link) {
+    SimulationTime now = worker_getCurrentTime();
+    Packet* next = socket_peekNextPacket(link->socket);
+    if(!next) {
+        link->flags &= ~SSL_DROPPING;
+        return NULL;
+    }
+
+    gboolean isAboveTarget = _networkinterface_codelIsAboveTarget(link, next, now);
+
+    if(link->flags & SSL_DROPPING) {
+        if(!isAboveTarget) {
+            link->flags &= ~SSL_DROPPING;
+        }
+        while((link->flags & SSL_DROPPING) && now >= link->dropNext) {
+            _networkinterface_codelDrop(interface, link);
+            next = socket_peekNextPacket(link->socket);
+            if(!next || !_networkinterface_codelIsAboveTarget(link, next, now)) {
+                link->flags &= ~SSL_DROPPING;
+            } else {
+                link->dropNext = _networkinterface_codelControlLaw(link->dropNext, link->dropCount);
+            }
+        }
+    } else if(isAboveTarget) {
+        _networkinterface_codelDrop(interface, link);
+        link->flags |= SSL_DROPPING;
+
+        /* start close to the previous drop rate if we were dropping recently */
+        guint delta = link->dropCount - link->lastDropCount;
+        if(delta > 1 && now < link->dropNext + (16 * CONFIG_CODEL_INTERVAL)) {
+            link->dropCount = delta;
+        } else {
+            link->dropCount = 1;
+        }
+        link->lastDropCount = link->dropCount;
+        link->dropNext = _networkinterface_codelControlLaw(now, link->dropCount);
+    }
+
+    return socket_peekNextPacket(link->socket) ?
+            _networkinterface_pullOutPacket(interface, link->socket) : NULL;
+}
+
+/* fair queuing with codel ($ man tc-fq_codel). sockets that just started sending
+ * are served before the others, every socket gets a quantum of bytes per round,
+ * and codel keeps the sockets from building standing queues */
+static Packet* _networkinterface_selectFairQueueCoDel(NetworkInterface* interface, gint* socketHandle) {
+    Packet* packet = NULL;
+
+    while(!packet) {
+        NetworkInterfaceSendList* list = interface->newFlowList.head ?
+                &(interface->newFlowList) : &(interface->sendList);
+        SocketSendLink* link = list->head;
+        if(!link) {
+            break;
+        }
+
+        if(link->deficit <= 0) {
+            /* out of credit, the socket continues as an old flow */
+            link->deficit += CONFIG_MTU;
+            link->flags &= ~SSL_NEW_FLOW;
+            _networkinterface_popSendLink(list);
+            _networkinterface_pushSendLink(&(interface->sendList), link);
+            continue;
+        }
+
+        packet = _networkinterface_codelDequeue(interface, link);
+
+        if(packet) {
+            *socketHandle = *descriptor_getHandleReference((Descriptor*)link->socket);
+            link->deficit -= _networkinterface_getWireLength(packet);
+        } else if(list == &(interface->newFlowList) && interface->sendList.head) {
+            /* an emptied new flow must wait behind the old flows before it can
+             * count as new again, so sparse sockets cannot starve the others */
+            link->flags &= ~SSL_NEW_FLOW;
+            _networkinterface_popSendLink(list);
+            _networkinterface_pushSendLink(&(interface->sendList), link);
+        } else {
+            _networkinterface_popSendLink(list);
+            _networkinterface_releaseSendLink(link);
         }
     }
 
@@ -353,7 +659,7 @@ static Packet* _networkinterface_selectFirstInFirstOut(NetworkInterface* interfa
     while(!packet && !priorityqueue_isEmpty(interface->fifoQueue)) {
         /* do fifo to get the next packet from the next socket */
         Socket* socket = priorityqueue_pop(interface->fifoQueue);
-        packet = socket_pullOutPacket(socket);
+        packet = _networkinterface_pullOutPacket(interface, socket);
         *socketHandle = *descriptor_getHandleReference((Descriptor*)socket);
 
         if(socket_peekNextPacket(socket)) {
@@ -384,6 +690,14 @@ static void _networkinterface_scheduleNextSend(NetworkInterface* interface) {
                 packet = _networkinterface_selectRoundRobin(interface, &socketHandle);
                 break;
             }
+            case NIQ_DRR: {
+                packet = _networkinterface_selectDeficitRoundRobin(interface, &socketHandle);
+                break;
+            }
+            case NIQ_FQCODEL: {
+                packet = _networkinterface_selectFairQueueCoDel(interface, &socketHandle);
+                break;
+            }
             case NIQ_FIFO:
             default: {
                 packet = _networkinterface_selectFirstInFirstOut(interface, &socketHandle);
@@ -396,6 +710,12 @@ static void _networkinterface_scheduleNextSend(NetworkInterface* interface) {
 
         packet_addDeliveryStatus(packet, PDS_SND_INTERFACE_SENT);
 
+        /* the wire time is for everything sent, even segments lost on the way */
+        guint length = packet_getPayloadLength(packet) + packet_getHeaderSize(packet);
+
+        /* track before the packet leaves, loss may remove segments from it */
+        _networkinterface_trackOutput(interface, packet, socketHandle);
+
         /* now actually send the packet somewhere */
         if(networkinterface_getIPAddress(interface) == packet_getDestinationIP(packet)) {
             /* packet will arrive on our own interface */
@@ -408,14 +728,8 @@ static void _networkinterface_scheduleNextSend(NetworkInterface* interface) {
         }
 
         /* successfully sent, calculate how long it took to 'send' this packet */
-        guint length = packet_getPayloadLength(packet) + packet_getHeaderSize(packet);
         interface->sendNanosecondsConsumed += (length * interface->timePerByteUp);
 
-        tracker_addOutputBytes(host_getTracker(worker_getCurrentHost()), packet, socketHandle);
-        if(interface->pcap) {
-            pcapwriter_writePacket(interface->pcap, packet);
-        }
-
         /* sending side is done with its ref */
         packet_unref(packet);
     }
@@ -439,11 +753,24 @@ void networkinterface_wantsSend(NetworkInterface* interface, Socket* socket) {
     MAGIC_ASSERT(interface);
 
     /* track the new socket for sending if not already tracking */
+    SocketSendLink* link = &(socket->sendLinks[interface->sendLinkIndex]);
     switch(interface->qdisc) {
-        case NIQ_RR: {
-            if(!g_queue_find(interface->rrQueue, socket)) {
+        case NIQ_RR:
+        case NIQ_DRR: {
+            if(!(link->flags & SSL_QUEUED)) {
                 descriptor_ref(socket);
-                g_queue_push_tail(interface->rrQueue, socket);
+                link->flags |= SSL_QUEUED;
+                link->deficit = CONFIG_MTU;
+                _networkinterface_pushSendLink(&(interface->sendList), link);
+            }
+            break;
+        }
+        case NIQ_FQCODEL: {
+            if(!(link->flags & SSL_QUEUED)) {
+                descriptor_ref(socket);
+                link->flags |= SSL_QUEUED | SSL_NEW_FLOW;
+                link->deficit = CONFIG_MTU;
+                _networkinterface_pushSendLink(&(interface->newFlowList), link);
             }
             break;
         }
@@ -463,6 +790,77 @@ void networkinterface_wantsSend(NetworkInterface* interface, Socket* socket) {
     }
 }
 
+void networkinterface_addFluidFlow(NetworkInterface* interface, Socket* socket) {
+    MAGIC_ASSERT(interface);
+    utility_assert(!g_hash_table_contains(interface->fluidFlows, socket));
+    g_hash_table_insert(interface->fluidFlows, socket, g_new0(gdouble, 1));
+    interface->fluidFlowLevel = -1;
+}
+
+void networkinterface_removeFluidFlow(NetworkInterface* interface, Socket* socket) {
+    MAGIC_ASSERT(interface);
+    if(g_hash_table_remove(interface->fluidFlows, socket)) {
+        interface->fluidFlowLevel = -1;
+    }
+}
+
+void networkinterface_setFluidFlowDemand(NetworkInterface* interface, Socket* socket, gdouble bytesPerSecond) {
+    MAGIC_ASSERT(interface);
+    gdouble* demand = g_hash_table_lookup(interface->fluidFlows, socket);
+    utility_assert(demand);
+    if(*demand != bytesPerSecond) {
+        *demand = bytesPerSecond;
+        interface->fluidFlowLevel = -1;
+    }
+}
+
+static gint _networkinterface_compareDemand(gconstpointer a, gconstpointer b) {
+    /* unlimited flows go last */
+    gdouble da = *((const gdouble*)a), db = *((const gdouble*)b);
+    if(da <= 0 || db <= 0) {
+        return da <= 0 ? (db <= 0 ? 0 : +1) : -1;
+    }
+    return da < db ? -1 : da > db ? +1 : 0;
+}
+
+/* max-min fairness by water-filling: flows that demand less than an equal share
+ * get their demand, and what they leave is split among the others */
+static gdouble _networkinterface_getFluidFlowLevel(NetworkInterface* interface) {
+    if(interface->fluidFlowLevel >= 0) {
+        return interface->fluidFlowLevel;
+    }
+
+    gdouble capacity = (gdouble)(interface->bwUpKiBps * 1024);
+    guint nFlows = g_hash_table_size(interface->fluidFlows);
+    gdouble level = capacity / MAX(nFlows, 1);
+
+    GList* demands = g_list_sort(g_hash_table_get_values(interface->fluidFlows), _networkinterface_compareDemand);
+    for(GList* item = demands; item != NULL; item = item->next) {
+        gdouble demand = *((gdouble*)item->data);
+        if(demand <= 0 || demand >= level) {
+            /* this and all following flows are limited by the level */
+            break;
+        }
+        capacity -= demand;
+        nFlows--;
+        level = capacity / MAX(nFlows, 1);
+    }
+    g_list_free(demands);
+
+    interface->fluidFlowLevel = level;
+    return level;
+}
+
+gdouble networkinterface_getFluidFlowShare(NetworkInterface* interface, Socket* socket) {
+    MAGIC_ASSERT(interface);
+    /* a share in bytes per second. bandwidth that no fluid flow can use is
+     * left to the packet-level traffic */
+    gdouble* demand = g_hash_table_lookup(interface->fluidFlows, socket);
+    utility_assert(demand);
+    gdouble level = _networkinterface_getFluidFlowLevel(interface);
+    return *demand > 0 ? MIN(*demand, level) : level;
+}
+
 void networkinterface_sent(NetworkInterface* interface) {
     MAGIC_ASSERT(interface);
 
@@ -32,5 +32,12 @@ void networkinterface_received(NetworkInterface* interface);
 void networkinterface_wantsSend(NetworkInterface* interface, Socket* transport);
 void networkinterface_sent(NetworkInterface* interface);
 
+void networkinterface_addFluidFlow(NetworkInterface* interface, Socket* socket);
+void networkinterface_removeFluidFlow(NetworkInterface* interface, Socket* socket);
+/* the rate the flow could use if it had the whole interface, 0 if unlimited */
+void networkinterface_setFluidFlowDemand(NetworkInterface* interface, Socket* socket, gdouble bytesPerSecond);
+/* the max-min fair share of the flow in bytes per second */
+gdouble networkinterface_getFluidFlowShare(NetworkInterface* interface, Socket* socket);
+
 
 #endif /* SHD_NETWORK_INTERFACE_H_ */
@@ -6,7 +6,14 @@
 
 #include "shadow.h"
 
-/* thread-safe structure representing a data/network packet */
+/* thread-safe structure representing a data/network packet.
+ *
+ * a packet is a single allocation. the reference count and delivery status are
+ * updated atomically. the local and udp headers are written by the sending host
+ * before the packet leaves it and are otherwise only read. the tcp header is
+ * rewritten by the sender each time the packet is retransmitted, while the
+ * receiver may still be reading it, so the tcp header and the debug status
+ * history are guarded by one of a few shared stripe locks. */
 
 typedef struct _PacketLocalHeader PacketLocalHeader;
 struct _PacketLocalHeader {
@@ -26,12 +33,14 @@ struct _PacketUDPHeader {
 };
 
 struct _Packet {
-    GMutex lock;
-    guint referenceCount;
+    /* fields touched for every packet come first */
+    volatile gint referenceCount;
+    volatile guint allStatus;
 
     enum ProtocolType protocol;
-    gpointer header;
-    gpointer payload;
+    /* the slice of a shared payload this packet carries */
+    Payload* payload;
+    guint payloadOffset;
     guint payloadLength;
 
     /* tracks application priority so we flush packets from the interface to
@@ -41,135 +50,216 @@ struct _Packet {
      */
     gdouble priority;
 
-    PacketDeliveryStatusFlags allStatus;
-    GQueue* orderedStatus;
+    /* the resolved route, set by sockets that cache it for their flow. both pointers
+     * are borrowed; the DNS and topology keep them alive for the whole simulation */
+    Address* routeDestination;
+    Path* routePath;
+
+    union {
+        PacketLocalHeader local;
+        PacketUDPHeader udp;
+        PacketTCPHeader tcp;
+    } header;
 
     SimulationTime dropNotificationDelay;
+    /* when the packet was last added to a socket output buffer */
+    SimulationTime bufferedTime;
+
+    /* status history in order, only created while debug logging is enabled */
+    GQueue* orderedStatus;
+
+    /* if this is a super-segment, the packets it carries across the network.
+     * the sizes above are then the sums over these segments. */
+    GPtrArray* segments;
+    /* a window of a flow-level approximated flow, which is not subject to loss */
+    gboolean isFluid;
 
     MAGIC_DECLARE;
 };
 
-Packet* packet_new(gconstpointer payload, gsize payloadLength) {
+/* guards the mutable state of a packet (tcp header, status history). static mutexes
+ * need no initialization, and striping keeps unrelated packets from contending */
+#define PACKET_NUM_STRIPE_LOCKS 16
+static GMutex packetStripeLocks[PACKET_NUM_STRIPE_LOCKS];
+
+static GMutex* _packet_getStripeLock(Packet* packet) {
+    guint index = (guint)((GPOINTER_TO_SIZE(packet) >> 6) % PACKET_NUM_STRIPE_LOCKS);
+    return &(packetStripeLocks[index]);
+}
+
+static void _packet_lock(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    g_mutex_lock(_packet_getStripeLock(packet));
+}
+
+static void _packet_unlock(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    g_mutex_unlock(_packet_getStripeLock(packet));
+}
+
+Packet* packet_newSlice(Payload* payload, gsize payloadOffset, gsize payloadLength) {
     Packet* packet = g_new0(Packet, 1);
     MAGIC_INIT(packet);
 
-    g_mutex_init(&(packet->lock));
     packet->referenceCount = 1;
 
     if(payload != NULL && payloadLength > 0) {
-        packet->payload = g_malloc0(payloadLength);
-        g_memmove(packet->payload, payload, payloadLength);
-        packet->payloadLength = payloadLength;
-        utility_assert(packet->payload);
+        utility_assert(payloadOffset + payloadLength <= payload_getLength(payload));
+        payload_ref(payload);
+        packet->payload = payload;
+        packet->payloadOffset = (guint) payloadOffset;
+        packet->payloadLength = (guint) payloadLength;
 
         /* application data needs a priority ordering for FIFO onto the wire */
         packet->priority = host_getNextPacketPriority(worker_getCurrentHost());
     }
 
-    packet->orderedStatus = g_queue_new();
+    return packet;
+}
 
+Packet* packet_new(gconstpointer payload, gsize payloadLength) {
+    if(payload == NULL || payloadLength == 0) {
+        return packet_newSlice(NULL, 0, 0);
+    }
+
+    Payload* data = payload_new(payload, payloadLength);
+    Packet* packet = packet_newSlice(data, 0, payloadLength);
+    payload_unref(data);
     return packet;
 }
 
 static void _packet_free(Packet* packet) {
     MAGIC_ASSERT(packet);
 
-    g_mutex_clear(&(packet->lock));
-
-    if(packet->protocol == PTCP) {
-        PacketTCPHeader* header = (PacketTCPHeader*)packet->header;
-        if(header->selectiveACKs) {
-            g_list_free(header->selectiveACKs);
-        }
-    }
-
-    if(packet->header) {
-        g_free(packet->header);
-    }
     if(packet->payload) {
-        g_free(packet->payload);
+        payload_unref(packet->payload);
     }
     if(packet->orderedStatus) {
         g_queue_free(packet->orderedStatus);
     }
+    if(packet->segments) {
+        g_ptr_array_free(packet->segments, TRUE);
+    }
 
     MAGIC_CLEAR(packet);
     g_free(packet);
 }
 
-static void _packet_lock(Packet* packet) {
+void packet_ref(Packet* packet) {
     MAGIC_ASSERT(packet);
-    g_mutex_lock(&(packet->lock));
+    g_atomic_int_inc(&(packet->referenceCount));
 }
 
-static void _packet_unlock(Packet* packet) {
+void packet_unref(Packet* packet) {
     MAGIC_ASSERT(packet);
-    g_mutex_unlock(&(packet->lock));
+    if(g_atomic_int_dec_and_test(&(packet->referenceCount))) {
+        packet_addDeliveryStatus(packet, PDS_DESTROYED);
+        _packet_free(packet);
+    }
 }
 
-void packet_ref(Packet* packet) {
-    _packet_lock(packet);
-    (packet->referenceCount)++;
-    _packet_unlock(packet);
+Packet* packet_newSuperSegment(Packet* firstSegment) {
+    MAGIC_ASSERT(firstSegment);
+    utility_assert(firstSegment->protocol == PTCP && !firstSegment->segments);
+
+    Packet* packet = g_new0(Packet, 1);
+    MAGIC_INIT(packet);
+
+    packet->referenceCount = 1;
+    packet->priority = firstSegment->priority;
+    packet->routeDestination = firstSegment->routeDestination;
+    packet->routePath = firstSegment->routePath;
+
+    /* addressing is all we need from the header; the sacks stay with the segment */
+    packet->protocol = PTCP;
+    packet->header.tcp = firstSegment->header.tcp;
+    packet->header.tcp.selectiveACKs.nBlocks = 0;
+
+    packet->segments = g_ptr_array_new_with_free_func((GDestroyNotify)packet_unref);
+    packet_appendSegment(packet, firstSegment);
+
+    return packet;
 }
 
-void packet_unref(Packet* packet) {
-    _packet_lock(packet);
+void packet_setFluid(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->segments);
+    packet->isFluid = TRUE;
+}
 
-    (packet->referenceCount)--;
-    if(packet->referenceCount == 0) {
-        _packet_unlock(packet);
-        packet_addDeliveryStatus(packet, PDS_DESTROYED);
-        _packet_free(packet);
-    } else {
-        _packet_unlock(packet);
-    }
+gboolean packet_isFluid(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    return packet->isFluid;
 }
 
-gint packet_compareTCPSequence(Packet* packet1, Packet* packet2, gpointer user_data) {
-    /* packet1 for one worker might be packet2 for another, dont lock both
-     * at once or a deadlock will occur */
-    guint sequence1 = 0, sequence2 = 0;
+void packet_appendSegment(Packet* packet, Packet* segment) {
+    MAGIC_ASSERT(packet);
+    MAGIC_ASSERT(segment);
+    utility_assert(packet->segments && !segment->segments);
+
+    /* we take over the caller's reference */
+    g_ptr_array_add(packet->segments, segment);
+    packet->payloadLength += segment->payloadLength;
+}
 
-    _packet_lock(packet1);
-    utility_assert(packet1->protocol == PTCP);
-    sequence1 = ((PacketTCPHeader*)(packet1->header))->sequence;
-    _packet_unlock(packet1);
+guint packet_getSegmentCount(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    return packet->segments ? packet->segments->len : 0;
+}
+
+Packet* packet_getSegment(Packet* packet, guint index) {
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->segments && index < packet->segments->len);
+    return g_ptr_array_index(packet->segments, index);
+}
+
+void packet_removeSegment(Packet* packet, guint index) {
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->segments && index < packet->segments->len);
+
+    Packet* segment = g_ptr_array_index(packet->segments, index);
+    packet->payloadLength -= segment->payloadLength;
+
+    /* keeps the order, and unrefs the segment */
+    g_ptr_array_remove_index(packet->segments, index);
+}
 
-    _packet_lock(packet2);
-    utility_assert(packet2->protocol == PTCP);
-    sequence2 = ((PacketTCPHeader*)(packet2->header))->sequence;
-    _packet_unlock(packet2);
+gint packet_compareTCPSequence(Packet* packet1, Packet* packet2, gpointer user_data) {
+    /* the sequence number never changes after the header is set */
+    MAGIC_ASSERT(packet1);
+    MAGIC_ASSERT(packet2);
+    utility_assert(packet1->protocol == PTCP && packet2->protocol == PTCP);
+
+    guint sequence1 = packet1->header.tcp.sequence;
+    guint sequence2 = packet2->header.tcp.sequence;
 
     return sequence1 < sequence2 ? -1 : sequence1 > sequence2 ? 1 : 0;
 }
 
 void packet_setLocal(Packet* packet, enum ProtocolLocalFlags flags,
         gint sourceDescriptorHandle, gint destinationDescriptorHandle, in_port_t port) {
-    _packet_lock(packet);
-    utility_assert(!(packet->header) && packet->protocol == PNONE);
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->protocol == PNONE);
     utility_assert(port > 0);
 
-    PacketLocalHeader* header = g_new0(PacketLocalHeader, 1);
+    PacketLocalHeader* header = &(packet->header.local);
 
     header->flags = flags;
     header->sourceDescriptorHandle = sourceDescriptorHandle;
     header->destinationDescriptorHandle = destinationDescriptorHandle;
     header->port = port;
 
-    packet->header = header;
     packet->protocol = PLOCAL;
-    _packet_unlock(packet);
 }
 
 void packet_setUDP(Packet* packet, enum ProtocolUDPFlags flags,
         in_addr_t sourceIP, in_port_t sourcePort,
         in_addr_t destinationIP, in_port_t destinationPort) {
-    _packet_lock(packet);
-    utility_assert(!(packet->header) && packet->protocol == PNONE);
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->protocol == PNONE);
     utility_assert(sourceIP && sourcePort && destinationIP && destinationPort);
 
-    PacketUDPHeader* header = g_new0(PacketUDPHeader, 1);
+    PacketUDPHeader* header = &(packet->header.udp);
 
     header->flags = flags;
     header->sourceIP = sourceIP;
@@ -177,19 +267,17 @@ void packet_setUDP(Packet* packet, enum ProtocolUDPFlags flags,
     header->destinationIP = destinationIP;
     header->destinationPort = destinationPort;
 
-    packet->header = header;
     packet->protocol = PUDP;
-    _packet_unlock(packet);
 }
 
 void packet_setTCP(Packet* packet, enum ProtocolTCPFlags flags,
         in_addr_t sourceIP, in_port_t sourcePort,
         in_addr_t destinationIP, in_port_t destinationPort, guint sequence) {
-    _packet_lock(packet);
-    utility_assert(!(packet->header) && packet->protocol == PNONE);
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->protocol == PNONE);
     utility_assert(sourceIP && sourcePort && destinationIP && destinationPort);
 
-    PacketTCPHeader* header = g_new0(PacketTCPHeader, 1);
+    PacketTCPHeader* header = &(packet->header.tcp);
 
     header->flags = flags;
     header->sourceIP = sourceIP;
@@ -198,28 +286,28 @@ void packet_setTCP(Packet* packet, enum ProtocolTCPFlags flags,
     header->destinationPort = destinationPort;
     header->sequence = sequence;
 
-    packet->header = header;
     packet->protocol = PTCP;
-    _packet_unlock(packet);
 }
 
-void packet_updateTCP(Packet* packet, guint acknowledgement, GList* selectiveACKs,
+void packet_updateTCP(Packet* packet, guint acknowledgement, const PacketTCPSelectiveACKs* selectiveACKs,
         guint window, SimulationTime timestampValue, SimulationTime timestampEcho) {
-    _packet_lock(packet);
-    utility_assert(packet->header && (packet->protocol == PTCP));
+    MAGIC_ASSERT(packet);
+    utility_assert(packet->protocol == PTCP);
 
-    PacketTCPHeader* header = (PacketTCPHeader*) packet->header;
+    PacketTCPHeader* header = &(packet->header.tcp);
+    guint nBlocks = selectiveACKs ? MIN(selectiveACKs->nBlocks, PACKET_TCP_SACK_BLOCKS_MAX) : 0;
 
-    if(selectiveACKs && g_list_length(selectiveACKs) > 0) {
-        /* free the old ack list if it exists */
-        if(header->selectiveACKs != NULL) {
-            g_list_free(header->selectiveACKs);
-            header->selectiveACKs = NULL;
-        }
+    /* a retransmitted packet may still be read by its receiver */
+    _packet_lock(packet);
 
-        /* set the new sacks */
+    for(guint i = 0; i < nBlocks; i++) {
+        header->selectiveACKs.blocks[i] = selectiveACKs->blocks[i];
+    }
+    header->selectiveACKs.nBlocks = nBlocks;
+    if(nBlocks > 0) {
         header->flags |= PTCP_SACK;
-        header->selectiveACKs = g_list_copy(selectiveACKs);
+    } else {
+        header->flags &= ~PTCP_SACK;
     }
 
     header->acknowledgment = acknowledgement;
@@ -240,16 +328,24 @@ gdouble packet_getPriority(Packet* packet) {
     return packet->priority;
 }
 
+enum ProtocolType packet_getProtocol(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    return packet->protocol;
+}
+
 guint packet_getHeaderSize(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
     guint size = packet->protocol == PUDP ? CONFIG_HEADER_SIZE_UDPIPETH :
             packet->protocol == PTCP ? CONFIG_HEADER_SIZE_TCPIPETH : 0;
-    _packet_unlock(packet);
+    if(packet->segments) {
+        /* every segment still pays for its own headers on the wire */
+        size *= packet->segments->len;
+    }
     return size;
 }
 
 in_addr_t packet_getDestinationIP(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     in_addr_t ip = 0;
 
@@ -260,13 +356,13 @@ in_addr_t packet_getDestinationIP(Packet* packet) {
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             ip = header->destinationIP;
             break;
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             ip = header->destinationIP;
             break;
         }
@@ -277,12 +373,11 @@ in_addr_t packet_getDestinationIP(Packet* packet) {
         }
     }
 
-    _packet_unlock(packet);
     return ip;
 }
 
 in_addr_t packet_getSourceIP(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     in_addr_t ip = 0;
 
@@ -293,13 +388,13 @@ in_addr_t packet_getSourceIP(Packet* packet) {
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             ip = header->sourceIP;
             break;
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             ip = header->sourceIP;
             break;
         }
@@ -310,30 +405,29 @@ in_addr_t packet_getSourceIP(Packet* packet) {
         }
     }
 
-    _packet_unlock(packet);
     return ip;
 }
 
 in_port_t packet_getSourcePort(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     in_port_t port = 0;
 
     switch (packet->protocol) {
         case PLOCAL: {
-            PacketLocalHeader* header = packet->header;
+            PacketLocalHeader* header = &(packet->header.local);
             port = header->port;
             break;
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             port = header->sourcePort;
             break;
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             port = header->sourcePort;
             break;
         }
@@ -344,12 +438,11 @@ in_port_t packet_getSourcePort(Packet* packet) {
         }
     }
 
-    _packet_unlock(packet);
     return port;
 }
 
 guint packet_copyPayload(Packet* packet, gsize payloadOffset, gpointer buffer, gsize bufferLength) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     utility_assert(payloadOffset <= packet->payloadLength);
 
@@ -357,32 +450,31 @@ guint packet_copyPayload(Packet* packet, gsize payloadOffset, gpointer buffer, g
     guint copyLength = MIN(targetLength, bufferLength);
 
     if(copyLength > 0) {
-        g_memmove(buffer, packet->payload + payloadOffset, copyLength);
+        payload_copy(packet->payload, packet->payloadOffset + payloadOffset, buffer, copyLength);
     }
 
-    _packet_unlock(packet);
     return copyLength;
 }
 
 gint packet_getDestinationAssociationKey(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     in_port_t port = 0;
     switch (packet->protocol) {
         case PLOCAL: {
-            PacketLocalHeader* header = packet->header;
+            PacketLocalHeader* header = &(packet->header.local);
             port = header->port;
             break;
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             port = header->destinationPort;
             break;
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             port = header->destinationPort;
             break;
         }
@@ -395,29 +487,28 @@ gint packet_getDestinationAssociationKey(Packet* packet) {
 
     gint key = PROTOCOL_DEMUX_KEY(packet->protocol, port);
 
-    _packet_unlock(packet);
     return key;
 }
 
 gint packet_getSourceAssociationKey(Packet* packet) {
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     in_port_t port = 0;
     switch (packet->protocol) {
         case PLOCAL: {
-            PacketLocalHeader* header = packet->header;
+            PacketLocalHeader* header = &(packet->header.local);
             port = header->port;
             break;
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             port = header->sourcePort;
             break;
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             port = header->sourcePort;
             break;
         }
@@ -430,26 +521,16 @@ gint packet_getSourceAssociationKey(Packet* packet) {
 
     gint key = PROTOCOL_DEMUX_KEY(packet->protocol, port);
 
-    _packet_unlock(packet);
     return key;
 }
 
-GList* packet_copyTCPSelectiveACKs(Packet* packet) {
+void packet_getTCPSelectiveACKs(Packet* packet, PacketTCPSelectiveACKs* selectiveACKs) {
+    utility_assert(selectiveACKs);
+
     _packet_lock(packet);
     utility_assert(packet->protocol == PTCP);
-
-    PacketTCPHeader* packetHeader = (PacketTCPHeader*)packet->header;
-
-    /* make sure to do a deep copy of all pointers to avoid concurrency issues */
-    GList* selectiveACKsCopy = NULL;
-    if(packetHeader->selectiveACKs) {
-        /* g_list_copy is shallow, but we store integers in the data pointers, so its OK here */
-        selectiveACKsCopy = g_list_copy(packetHeader->selectiveACKs);
-    }
-
+    *selectiveACKs = packet->header.tcp.selectiveACKs;
     _packet_unlock(packet);
-
-    return selectiveACKsCopy;
 }
 
 void packet_getTCPHeader(Packet* packet, PacketTCPHeader* header) {
@@ -457,11 +538,14 @@ void packet_getTCPHeader(Packet* packet, PacketTCPHeader* header) {
         return;
     }
 
-    _packet_lock(packet);
+    MAGIC_ASSERT(packet);
 
     utility_assert(packet->protocol == PTCP);
 
-    PacketTCPHeader* packetHeader = (PacketTCPHeader*)packet->header;
+    PacketTCPHeader* packetHeader = &(packet->header.tcp);
+
+    /* the sender may be updating the header for a retransmission */
+    _packet_lock(packet);
 
     /* copy all local non-malloc'd header state */
     header->flags = packetHeader->flags;
@@ -475,10 +559,10 @@ void packet_getTCPHeader(Packet* packet, PacketTCPHeader* header) {
     header->timestampValue = packetHeader->timestampValue;
     header->timestampEcho = packetHeader->timestampEcho;
 
-    /* don't copy the selective acks list here; use packet_copyTCPSelectiveACKs for that */
-    header->selectiveACKs = NULL;
-
     _packet_unlock(packet);
+
+    /* use packet_getTCPSelectiveACKs for the sacks */
+    header->selectiveACKs.nBlocks = 0;
 }
 
 static const gchar* _packet_deliveryStatusToAscii(PacketDeliveryStatusFlags status) {
@@ -491,6 +575,7 @@ static const gchar* _packet_deliveryStatusToAscii(PacketDeliveryStatusFlags stat
         case PDS_SND_TCP_RETRANSMITTED: return "SND_TCP_RETRANSMITTED";
         case PDS_SND_SOCKET_BUFFERED: return "SND_SOCKET_BUFFERED";
         case PDS_SND_INTERFACE_SENT: return "SND_INTERFACE_SENT";
+        case PDS_SND_INTERFACE_DROPPED: return "SND_INTERFACE_DROPPED";
         case PDS_INET_SENT: return "INET_SENT";
         case PDS_INET_DROPPED: return "INET_DROPPED";
         case PDS_RCV_INTERFACE_BUFFERED: return "RCV_INTERFACE_BUFFERED";
@@ -506,14 +591,13 @@ static const gchar* _packet_deliveryStatusToAscii(PacketDeliveryStatusFlags stat
     }
 }
 
+/* @warning the packet stripe lock must be held when calling this function!! */
 static gchar* _packet_getString(Packet* packet) {
     GString* packetString = g_string_new("");
 
-    //_packet_lock(packet);
-
     switch (packet->protocol) {
         case PLOCAL: {
-            PacketLocalHeader* header = packet->header;
+            PacketLocalHeader* header = &(packet->header.local);
             g_string_append_printf(packetString, "%i -> %i bytes=%u",
                     header->sourceDescriptorHandle, header->destinationDescriptorHandle,
                     packet->payloadLength);
@@ -521,7 +605,7 @@ static gchar* _packet_getString(Packet* packet) {
         }
 
         case PUDP: {
-            PacketUDPHeader* header = packet->header;
+            PacketUDPHeader* header = &(packet->header.udp);
             gchar* sourceIPString = address_ipToNewString(header->sourceIP);
             gchar* destinationIPString = address_ipToNewString(header->destinationIP);
 
@@ -537,7 +621,7 @@ static gchar* _packet_getString(Packet* packet) {
         }
 
         case PTCP: {
-            PacketTCPHeader* header = packet->header;
+            PacketTCPHeader* header = &(packet->header.tcp);
             gchar* sourceIPString = address_ipToNewString(header->sourceIP);
             gchar* destinationIPString = address_ipToNewString(header->destinationIP);
 
@@ -547,28 +631,12 @@ static gchar* _packet_getString(Packet* packet) {
                     destinationIPString, ntohs(header->destinationPort),
                     header->sequence, header->acknowledgment);
 
-            // Instead of printing out entire list of SACK, print out ranges to save space
-            gint firstSack = -1;
-            gint lastSack = -1;
-            for(GList *iter = header->selectiveACKs; iter; iter = g_list_next(iter)) {
-                gint seq = GPOINTER_TO_INT(iter->data);
-                if(firstSack == -1) {
-                    firstSack = seq;
-                } else if(lastSack == -1 || seq == lastSack + 1) {
-                    lastSack = seq;
-                } else {
-                    g_string_append_printf(packetString, "%d-%d ", firstSack, lastSack);
-                    firstSack = seq;
-                    lastSack = -1;
-                }
+            for(guint i = 0; i < header->selectiveACKs.nBlocks; i++) {
+                PacketTCPSelectiveACKBlock* block = &(header->selectiveACKs.blocks[i]);
+                g_string_append_printf(packetString, i > 0 ? " %u-%u" : "%u-%u",
+                        block->start, block->end - 1);
             }
-
-            if(firstSack != -1) {
-                g_string_append_printf(packetString, "%d", firstSack);
-                if(lastSack != -1) {
-                    g_string_append_printf(packetString,"-%d", lastSack);
-                }
-            } else {
+            if(header->selectiveACKs.nBlocks == 0) {
                 g_string_append_printf(packetString, "NA");
             }
 
@@ -617,46 +685,79 @@ static gchar* _packet_getString(Packet* packet) {
         g_queue_push_tail(packet->orderedStatus, statusPtr);
     }
 
-    //_packet_unlock(packet);
     return g_string_free(packetString, FALSE);
 }
 
 void packet_addDeliveryStatus(Packet* packet, PacketDeliveryStatusFlags status) {
-    gboolean skipDebug = worker_isFiltered(G_LOG_LEVEL_DEBUG);
-    gchar* packetStr = NULL;
+    MAGIC_ASSERT(packet);
+    g_atomic_int_or(&(packet->allStatus), (guint)status);
 
-    _packet_lock(packet);
-    packet->allStatus |= status;
+    /* whatever happens to a super-segment happens to everything it carries,
+     * but the segments may outlive it and get destroyed on their own */
+    if(packet->segments && status != PDS_DESTROYED) {
+        for(guint i = 0; i < packet->segments->len; i++) {
+            packet_addDeliveryStatus(g_ptr_array_index(packet->segments, i), status);
+        }
+    }
 
-    if(!skipDebug) {
-        g_queue_push_tail(packet->orderedStatus, GUINT_TO_POINTER(status));
-        packetStr = _packet_getString(packet);
+    /* the ordered history only exists for debug tracing */
+    if(worker_isFiltered(G_LOG_LEVEL_DEBUG)) {
+        return;
     }
 
+    _packet_lock(packet);
+    if(!packet->orderedStatus) {
+        packet->orderedStatus = g_queue_new();
+    }
+    g_queue_push_tail(packet->orderedStatus, GUINT_TO_POINTER(status));
+    gchar* packetStr = _packet_getString(packet);
     _packet_unlock(packet);
 
-    if(!skipDebug) {
-        message("[%s] %s", _packet_deliveryStatusToAscii(status), packetStr);
-    }
+    message("[%s] %s", _packet_deliveryStatusToAscii(status), packetStr);
+    g_free(packetStr);
 }
 
 PacketDeliveryStatusFlags packet_getDeliveryStatus(Packet* packet) {
-    _packet_lock(packet);
-    PacketDeliveryStatusFlags flags = packet->allStatus;
-    _packet_unlock(packet);
-    return flags;
+    MAGIC_ASSERT(packet);
+    return (PacketDeliveryStatusFlags) g_atomic_int_get(&(packet->allStatus));
 }
 
 void packet_setDropNotificationDelay(Packet* packet, SimulationTime delay) {
     MAGIC_ASSERT(packet);
-    _packet_lock(packet);
     packet->dropNotificationDelay = delay;
-    _packet_unlock(packet);
 }
+
 SimulationTime packet_getDropNotificationDelay(Packet* packet) {
     MAGIC_ASSERT(packet);
-    _packet_lock(packet);
-    SimulationTime delay = packet->dropNotificationDelay;
-    _packet_unlock(packet);
-    return delay;
+    return packet->dropNotificationDelay;
+}
+
+void packet_setBufferedTime(Packet* packet, SimulationTime time) {
+    MAGIC_ASSERT(packet);
+    packet->bufferedTime = time;
+}
+
+SimulationTime packet_getBufferedTime(Packet* packet) {
+    MAGIC_ASSERT(packet);
+    return packet->bufferedTime;
+}
+
+void packet_setRoute(Packet* packet, Address* destination, Path* path) {
+    MAGIC_ASSERT(packet);
+    packet->routeDestination = destination;
+    packet->routePath = path;
+}
+
+gboolean packet_getRoute(Packet* packet, Address** destination, Path** path) {
+    MAGIC_ASSERT(packet);
+    gboolean hasRoute = (packet->routeDestination && packet->routePath) ? TRUE : FALSE;
+    if(hasRoute) {
+        if(destination) {
+            *destination = packet->routeDestination;
+        }
+        if(path) {
+            *path = packet->routePath;
+        }
+    }
+    return hasRoute;
 }
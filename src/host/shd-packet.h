@@ -32,6 +32,23 @@ enum _PacketDeliveryStatusFlags {
     PDS_RCV_SOCKET_BUFFERED = 1 << 16,
     PDS_RCV_SOCKET_DELIVERED = 1 << 17,
     PDS_DESTROYED = 1 << 18,
+    PDS_SND_INTERFACE_DROPPED = 1 << 19,
+};
+
+/* the tcp options space fits at most this many sack blocks (rfc 2018) */
+#define PACKET_TCP_SACK_BLOCKS_MAX 4
+
+typedef struct _PacketTCPSelectiveACKBlock PacketTCPSelectiveACKBlock;
+struct _PacketTCPSelectiveACKBlock {
+    /* the received sequences [start, end) */
+    guint start;
+    guint end;
+};
+
+typedef struct _PacketTCPSelectiveACKs PacketTCPSelectiveACKs;
+struct _PacketTCPSelectiveACKs {
+    guint nBlocks;
+    PacketTCPSelectiveACKBlock blocks[PACKET_TCP_SACK_BLOCKS_MAX];
 };
 
 typedef struct _PacketTCPHeader PacketTCPHeader;
@@ -43,13 +60,23 @@ struct _PacketTCPHeader {
     in_port_t destinationPort;
     guint sequence;
     guint acknowledgment;
-    GList* selectiveACKs;
+    PacketTCPSelectiveACKs selectiveACKs;
     guint window;
     SimulationTime timestampValue;
     SimulationTime timestampEcho;
 };
 
 Packet* packet_new(gconstpointer payload, gsize payloadLength);
+Packet* packet_newSlice(Payload* payload, gsize payloadOffset, gsize payloadLength);
+
+/* a super-segment carries several tcp segments of one flow as a single network unit */
+Packet* packet_newSuperSegment(Packet* firstSegment);
+void packet_appendSegment(Packet* packet, Packet* segment);
+guint packet_getSegmentCount(Packet* packet);
+Packet* packet_getSegment(Packet* packet, guint index);
+void packet_removeSegment(Packet* packet, guint index);
+void packet_setFluid(Packet* packet);
+gboolean packet_isFluid(Packet* packet);
 
 void packet_ref(Packet* packet);
 void packet_unref(Packet* packet);
@@ -63,9 +90,10 @@ void packet_setTCP(Packet* packet, enum ProtocolTCPFlags flags,
         in_addr_t sourceIP, in_port_t sourcePort,
         in_addr_t destinationIP, in_port_t destinationPort, guint sequence);
 
-void packet_updateTCP(Packet* packet, guint acknowledgement, GList* selectiveACKs,
+void packet_updateTCP(Packet* packet, guint acknowledgement, const PacketTCPSelectiveACKs* selectiveACKs,
         guint window, SimulationTime timestampValue, SimulationTime timestampEcho);
 
+enum ProtocolType packet_getProtocol(Packet* packet);
 guint packet_getPayloadLength(Packet* packet);
 gdouble packet_getPriority(Packet* packet);
 guint packet_getHeaderSize(Packet* packet);
@@ -73,7 +101,7 @@ in_addr_t packet_getDestinationIP(Packet* packet);
 in_addr_t packet_getSourceIP(Packet* packet);
 in_port_t packet_getSourcePort(Packet* packet);
 guint packet_copyPayload(Packet* packet, gsize payloadOffset, gpointer buffer, gsize bufferLength);
-GList* packet_copyTCPSelectiveACKs(Packet* packet);
+void packet_getTCPSelectiveACKs(Packet* packet, PacketTCPSelectiveACKs* selectiveACKs);
 void packet_getTCPHeader(Packet* packet, PacketTCPHeader* header);
 gint packet_compareTCPSequence(Packet* packet1, Packet* packet2, gpointer user_data);
 
@@ -86,5 +114,11 @@ PacketDeliveryStatusFlags packet_getDeliveryStatus(Packet* packet);
 void packet_setDropNotificationDelay(Packet* packet, SimulationTime delay);
 SimulationTime packet_getDropNotificationDelay(Packet* packet);
 
+void packet_setBufferedTime(Packet* packet, SimulationTime time);
+SimulationTime packet_getBufferedTime(Packet* packet);
+
+void packet_setRoute(Packet* packet, Address* destination, Path* path);
+gboolean packet_getRoute(Packet* packet, Address** destination, Path** path);
+
 
 #endif /* SHD_PACKET_H_ */
@@ -0,0 +1,117 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#include "shadow.h"
+
+struct _Payload {
+    volatile gint referenceCount;
+    gsize length;
+    /* the bytes follow the struct in the same allocation, or NULL if virtual */
+    guchar* data;
+    /* virtual payloads generate their bytes from this when they are read */
+    guint64 seed;
+    MAGIC_DECLARE;
+};
+
+Payload* payload_new(gconstpointer data, gsize dataLength) {
+    utility_assert(data && dataLength > 0);
+
+    Payload* payload = g_malloc(sizeof(Payload) + dataLength);
+    MAGIC_INIT(payload);
+
+    payload->referenceCount = 1;
+    payload->length = dataLength;
+    payload->data = (guchar*)(payload + 1);
+
+    /* the only copy of application data on the send path */
+    memcpy(payload->data, data, dataLength);
+
+    return payload;
+}
+
+Payload* payload_newVirtual(gsize dataLength) {
+    utility_assert(dataLength > 0);
+
+    Payload* payload = g_new0(Payload, 1);
+    MAGIC_INIT(payload);
+
+    payload->referenceCount = 1;
+    payload->length = dataLength;
+
+    /* draw from the sending host so runs stay reproducible */
+    Random* random = host_getRandom(worker_getCurrentHost());
+    payload->seed = (((guint64)random_nextUInt(random)) << 32) | ((guint64)random_nextUInt(random));
+
+    return payload;
+}
+
+static guint64 _payload_mix(guint64 x) {
+    x = (x ^ (x >> 30)) * G_GUINT64_CONSTANT(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * G_GUINT64_CONSTANT(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+/* each 8 byte word of a virtual payload only depends on the seed and its index,
+ * so any slice can be generated without generating what comes before it */
+static void _payload_materialize(Payload* payload, gsize offset, guchar* buffer, gsize length) {
+    gsize position = offset;
+    gsize end = offset + length;
+
+    while(position < end) {
+        gsize wordIndex = position / sizeof(guint64);
+        gsize wordOffset = position % sizeof(guint64);
+        gsize n = MIN(sizeof(guint64) - wordOffset, end - position);
+
+        guint64 word = _payload_mix(payload->seed + (G_GUINT64_CONSTANT(0x9E3779B97F4A7C15) * (wordIndex + 1)));
+        memcpy(buffer + (position - offset), ((guchar*)&word) + wordOffset, n);
+
+        position += n;
+    }
+}
+
+static void _payload_free(Payload* payload) {
+    MAGIC_ASSERT(payload);
+    MAGIC_CLEAR(payload);
+    g_free(payload);
+}
+
+void payload_ref(Payload* payload) {
+    MAGIC_ASSERT(payload);
+    g_atomic_int_inc(&(payload->referenceCount));
+}
+
+void payload_unref(Payload* payload) {
+    MAGIC_ASSERT(payload);
+    if(g_atomic_int_dec_and_test(&(payload->referenceCount))) {
+        _payload_free(payload);
+    }
+}
+
+gboolean payload_isVirtual(Payload* payload) {
+    MAGIC_ASSERT(payload);
+    return payload->data == NULL;
+}
+
+gsize payload_getLength(Payload* payload) {
+    MAGIC_ASSERT(payload);
+    return payload->length;
+}
+
+gsize payload_copy(Payload* payload, gsize offset, gpointer buffer, gsize bufferLength) {
+    MAGIC_ASSERT(payload);
+    utility_assert(offset <= payload->length);
+
+    gsize copyLength = MIN(payload->length - offset, bufferLength);
+    if(copyLength > 0) {
+        if(payload->data) {
+            memcpy(buffer, payload->data + offset, copyLength);
+        } else {
+            _payload_materialize(payload, offset, (guchar*)buffer, copyLength);
+        }
+    }
+
+    return copyLength;
+}
@@ -0,0 +1,33 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_PAYLOAD_H_
+#define SHD_PAYLOAD_H_
+
+#include "shadow.h"
+
+/**
+ * An immutable, reference counted block of application bytes. Packets reference
+ * a slice of a payload instead of owning a copy, so segmenting a write,
+ * retransmitting, and buffering on the receive side all share the same bytes.
+ * The reference count is atomic since the sender and receiver may live on
+ * different workers.
+ *
+ * A virtual payload only records its length and a seed. Its bytes are generated
+ * when somebody copies them out, so bulk filler traffic needs no memory.
+ */
+typedef struct _Payload Payload;
+
+Payload* payload_new(gconstpointer data, gsize dataLength);
+Payload* payload_newVirtual(gsize dataLength);
+void payload_ref(Payload* payload);
+void payload_unref(Payload* payload);
+
+gboolean payload_isVirtual(Payload* payload);
+gsize payload_getLength(Payload* payload);
+gsize payload_copy(Payload* payload, gsize offset, gpointer buffer, gsize bufferLength);
+
+#endif /* SHD_PAYLOAD_H_ */
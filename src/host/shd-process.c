@@ -180,14 +180,27 @@ struct _Process {
 /* XXX temporary hack to lock tor process init, until we can find thread errors */
 G_LOCK_DEFINE_STATIC(globalProcessInitLock);
 
+/* tells the preload library which process' calls it should emulate on this thread */
+extern void interposer_setEmulatedProcess(Process* proc);
+
 static ProcessContext _process_changeContext(Process* proc, ProcessContext from, ProcessContext to) {
+    /* a plugin in a linker namespace sets the errno of its own libc */
+    if(from == PCTX_PLUGIN && proc && proc->prog) {
+        program_loadErrno(proc->prog);
+    }
+
     ProcessContext prevContext = PCTX_NONE;
     if(from == PCTX_SHADOW) {
         MAGIC_ASSERT(proc);
         prevContext = proc->activeContext;
         utility_assert(prevContext == from);
         proc->activeContext = to;
+        if(to != PCTX_SHADOW) {
+            interposer_setEmulatedProcess(proc);
+        }
     } else if(to == PCTX_SHADOW) {
+        /* stop emulating before anything below calls into libc */
+        interposer_setEmulatedProcess(NULL);
         prevContext = proc->activeContext;
         proc->activeContext = to;
         MAGIC_ASSERT(proc);
@@ -198,6 +211,10 @@ static ProcessContext _process_changeContext(Process* proc, ProcessContext from,
         prevContext = proc->activeContext;
         proc->activeContext = to;
     }
+
+    if(to == PCTX_PLUGIN && proc && proc->prog) {
+        program_storeErrno(proc->prog);
+    }
     return prevContext;
 }
 
@@ -334,6 +351,12 @@ static FILE* _process_getIOFile(Process* proc, gint fd){
     }
 }
 
+/* stack size for the pth threads of the plugin, as configured for its program */
+static guint _process_getStackSize(Process* proc) {
+    guint stackSize = proc->prog ? program_getStackSize(proc->prog) : 0;
+    return stackSize > 0 ? stackSize : PROC_PTH_STACK_SIZE;
+}
+
 static void _process_handleTimerResult(Process* proc, gdouble elapsedTimeSec) {
     SimulationTime delay = (SimulationTime) (elapsedTimeSec * SIMTIME_ONE_SECOND);
     Host* currentHost = worker_getCurrentHost();
@@ -694,7 +717,7 @@ void process_start(Process* proc) {
     /* spawn the program main thread: joinable by default, bigger stack */
     pth_attr_t programMainThreadAttr = pth_attr_new();
     pth_attr_set(programMainThreadAttr, PTH_ATTR_NAME, programMainThreadNameBuf->str);
-    pth_attr_set(programMainThreadAttr, PTH_ATTR_STACK_SIZE, PROC_PTH_STACK_SIZE);
+    pth_attr_set(programMainThreadAttr, PTH_ATTR_STACK_SIZE, _process_getStackSize(proc));
     proc->programMainThread = pth_spawn(programMainThreadAttr, (PthSpawnFunc)_process_executeMain, proc);
     pth_attr_destroy(programMainThreadAttr);
 
@@ -977,6 +1000,12 @@ static gssize _process_emu_sendHelper(Process* proc, gint fd, gconstpointer buf,
         return -1;
     }
 
+    /* a NULL buffer means virtual bytes below, never let real sends do that */
+    if(buf == NULL && n > 0) {
+        errno = EFAULT;
+        return -1;
+    }
+
     in_addr_t ip = 0;
     in_port_t port = 0;
 
@@ -1306,14 +1335,52 @@ static int _process_emu_epollWaitHelper(Process* proc, int epfd, struct epoll_ev
 
 /* memory allocation family */
 
-void* process_emu_malloc(Process* proc, size_t size) {
-    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+/* plugin memory comes from the arena of the host, so it is released in bulk
+ * when the host is freed and its size is known without a lookup table */
+static void* _process_allocate(Process* proc, size_t alignment, size_t size, gboolean clear) {
+    Arena* arena = host_getArena(proc->host);
+    gpointer ptr = alignment ? arena_allocAligned(arena, alignment, size) : arena_alloc(arena, size, clear);
+    if(ptr != NULL) {
+        tracker_addAllocatedBytes(host_getTracker(proc->host), size);
+    } else {
+        errno = ENOMEM;
+    }
+    return ptr;
+}
+
+static void _process_deallocate(Process* proc, void* ptr) {
+    Arena* arena = host_getArena(proc->host);
+    Tracker* tracker = host_getTracker(proc->host);
 
-    void* ptr = malloc(size);
-    if(size && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, size);
+    Arena* owner = arena_getOwner(ptr);
+    if(owner == arena) {
+        gsize size = arena_getRequestedSize(ptr);
+        if(arena_release(arena, ptr)) {
+            tracker_removeAllocatedBytes(tracker, size);
+        } else {
+            tracker_addFailedFree(tracker);
+        }
+    } else {
+        /* memory from another host's arena is reclaimed with that host */
+        if(owner == NULL) {
+            free(ptr);
+        }
+        tracker_addFailedFree(tracker);
     }
+}
+
+/* returns the power of two that is at least the given alignment */
+static size_t _process_roundAlignment(size_t alignment) {
+    size_t rounded = sizeof(void*);
+    while(rounded < alignment) {
+        rounded <<= 1;
+    }
+    return rounded;
+}
 
+void* process_emu_malloc(Process* proc, size_t size) {
+    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+    void* ptr = _process_allocate(proc, 0, size, FALSE);
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
@@ -1321,10 +1388,13 @@ void* process_emu_malloc(Process* proc, size_t size) {
 void* process_emu_calloc(Process* proc, size_t nmemb, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
 
-    void* ptr = calloc(nmemb, size);
-    if(size && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, size);
+    void* ptr = NULL;
+    if(size && nmemb > G_MAXSIZE / size) {
+        errno = ENOMEM;
+    } else {
+        ptr = _process_allocate(proc, 0, nmemb * size, TRUE);
     }
+
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
@@ -1332,21 +1402,30 @@ void* process_emu_calloc(Process* proc, size_t nmemb, size_t size) {
 void* process_emu_realloc(Process* proc, void *ptr, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
 
-    gpointer newptr = realloc(ptr, size);
-    if(newptr != NULL) {
-        if(ptr == NULL) {
-            /* equivalent to malloc */
-            if(size) {
-                tracker_addAllocatedBytes(host_getTracker(proc->host), newptr, size);
-            }
-        } else if (size == 0) {
-            /* equivalent to free */
-            tracker_removeAllocatedBytes(host_getTracker(proc->host), ptr);
+    gpointer newptr = NULL;
+    if(ptr == NULL) {
+        /* equivalent to malloc */
+        newptr = _process_allocate(proc, 0, size, FALSE);
+    } else if (size == 0) {
+        /* equivalent to free */
+        _process_deallocate(proc, ptr);
+    } else {
+        /* true realloc */
+        Arena* owner = arena_getOwner(ptr);
+        gsize oldSize = owner ? arena_getChunkSize(ptr) : malloc_usable_size(ptr);
+
+        if(owner == host_getArena(proc->host) && size <= oldSize && size >= oldSize / 2) {
+            /* the chunk is still a good fit */
+            Tracker* tracker = host_getTracker(proc->host);
+            tracker_removeAllocatedBytes(tracker, arena_getRequestedSize(ptr));
+            tracker_addAllocatedBytes(tracker, size);
+            arena_setRequestedSize(ptr, size);
+            newptr = ptr;
         } else {
-            /* true realloc */
-            tracker_removeAllocatedBytes(host_getTracker(proc->host), ptr);
-            if(size) {
-                tracker_addAllocatedBytes(host_getTracker(proc->host), newptr, size);
+            newptr = _process_allocate(proc, 0, size, FALSE);
+            if(newptr != NULL) {
+                memcpy(newptr, ptr, MIN(oldSize, size));
+                _process_deallocate(proc, ptr);
             }
         }
     }
@@ -1357,29 +1436,46 @@ void* process_emu_realloc(Process* proc, void *ptr, size_t size) {
 
 void process_emu_free(Process* proc, void *ptr) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    free(ptr);
     if(ptr != NULL) {
-        tracker_removeAllocatedBytes(host_getTracker(proc->host), ptr);
+        _process_deallocate(proc, ptr);
     }
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
 }
 
+size_t process_emu_malloc_usable_size(Process* proc, void *ptr) {
+    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+
+    size_t size = 0;
+    if(ptr != NULL) {
+        size = arena_getOwner(ptr) ? arena_getChunkSize(ptr) : malloc_usable_size(ptr);
+    }
+
+    _process_changeContext(proc, PCTX_SHADOW, prevCTX);
+    return size;
+}
+
 int process_emu_posix_memalign(Process* proc, void** memptr, size_t alignment, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    gint ret = posix_memalign(memptr, alignment, size);
-    if(ret == 0 && size) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), *memptr, size);
+
+    gint ret = 0;
+    if(alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0) {
+        ret = EINVAL;
+    } else {
+        gpointer ptr = _process_allocate(proc, alignment, size, FALSE);
+        if(ptr != NULL) {
+            *memptr = ptr;
+        } else {
+            ret = ENOMEM;
+        }
     }
+
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ret;
 }
 
 void* process_emu_memalign(Process* proc, size_t blocksize, size_t bytes) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    gpointer ptr = memalign(blocksize, bytes);
-    if(bytes && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, bytes);
-    }
+    gpointer ptr = _process_allocate(proc, _process_roundAlignment(blocksize), bytes, FALSE);
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
@@ -1387,30 +1483,24 @@ void* process_emu_memalign(Process* proc, size_t blocksize, size_t bytes) {
 /* aligned_alloc doesnt exist in glibc in the current LTS version of ubuntu */
 void* process_emu_aligned_alloc(Process* proc, size_t alignment, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    gpointer ptr = aligned_alloc(alignment, size);
-    if(size && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, size);
-    }
+    gpointer ptr = _process_allocate(proc, _process_roundAlignment(alignment), size, FALSE);
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
 
 void* process_emu_valloc(Process* proc, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    gpointer ptr = valloc(size);
-    if(size && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, size);
-    }
+    gpointer ptr = _process_allocate(proc, (size_t)sysconf(_SC_PAGESIZE), size, FALSE);
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
 
 void* process_emu_pvalloc(Process* proc, size_t size) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    gpointer ptr = pvalloc(size);
-    if(size && ptr != NULL) {
-        tracker_addAllocatedBytes(host_getTracker(proc->host), ptr, size);
-    }
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    /* pvalloc rounds the size up to whole pages */
+    size_t roundedSize = size ? ((size + pageSize - 1) / pageSize) * pageSize : pageSize;
+    gpointer ptr = _process_allocate(proc, pageSize, roundedSize, FALSE);
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ptr;
 }
@@ -1700,6 +1790,30 @@ ssize_t process_emu_sendto(Process* proc, int fd, const void *buf, size_t n, int
     return ret;
 }
 
+ssize_t process_emu_shadow_send_virtual(Process* proc, int fd, size_t n) {
+    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+    gssize ret = 0;
+
+    /* this does not go through pth, so it never blocks; the socket behaves as if
+     * it were non-blocking and the caller should wait for it to become writable */
+    if(!host_isShadowDescriptor(proc->host, fd)){
+        errno = EBADF;
+        ret = -1;
+    } else {
+        gsize bytes = 0;
+        gint result = host_sendUserData(proc->host, fd, NULL, n, 0, 0, &bytes);
+        if(result != 0) {
+            errno = result;
+            ret = -1;
+        } else {
+            ret = (gssize) bytes;
+        }
+    }
+
+    _process_changeContext(proc, PCTX_SHADOW, prevCTX);
+    return ret;
+}
+
 ssize_t process_emu_sendmsg(Process* proc, int fd, const struct msghdr *message, int flags) {
     /* TODO implement */
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
@@ -3599,8 +3713,18 @@ int process_emu_getaddrinfo(Process* proc, const char *name, const char *service
 
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
 
+    /* only these flags change the result, so only they are part of the cache key */
+    gint flags = hints ? (hints->ai_flags & (AI_PASSIVE|AI_NUMERICHOST|AI_NUMERICSERV)) : 0;
+    ResolverCache* cache = host_getResolverCache(proc->host);
+
+    *res = resolvercache_lookup(cache, name, service, flags);
+    tracker_addResolverLookup(host_getTracker(proc->host), *res != NULL);
+    if(*res != NULL) {
+        _process_changeContext(proc, PCTX_SHADOW, prevCTX);
+        return 0;
+    }
+
     gint result = 0;
-    *res = NULL;
 
     in_addr_t ip = INADDR_NONE;
     in_port_t port = 0;
@@ -3660,25 +3784,8 @@ int process_emu_getaddrinfo(Process* proc, const char *name, const char *service
     }
 
     if(ip != INADDR_NONE) {
-        /* should have address now */
-        struct sockaddr_in* sa = g_malloc(sizeof(struct sockaddr_in));
-        /* application will expect it in network order */
-        // sa->sin_addr.s_addr = (in_addr_t) htonl((guint32)(*addr));
-        sa->sin_addr.s_addr = ip;
-        sa->sin_family = AF_INET; /* libcurl expects this to be set */
-        sa->sin_port = port;
-
-        struct addrinfo* ai_out = g_malloc(sizeof(struct addrinfo));
-        ai_out->ai_addr = (struct sockaddr*) sa;
-        ai_out->ai_addrlen =  sizeof(struct sockaddr_in);
-        ai_out->ai_canonname = NULL;
-        ai_out->ai_family = AF_INET;
-        ai_out->ai_flags = 0;
-        ai_out->ai_next = NULL;
-        ai_out->ai_protocol = 0;
-        ai_out->ai_socktype = SOCK_STREAM;
-
-        *res = ai_out;
+        /* should have address now, which the application expects in network order */
+        *res = resolvercache_insert(cache, name, service, flags, ip, port);
         result = 0;
     }
 
@@ -3688,10 +3795,11 @@ int process_emu_getaddrinfo(Process* proc, const char *name, const char *service
 
 void process_emu_freeaddrinfo(Process* proc, struct addrinfo *res) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
-    if(res && res->ai_addr != NULL) {
-        g_free(res->ai_addr);
-        res->ai_addr = NULL;
-        g_free(res);
+    if(res) {
+        /* results are copies handed out by the resolver cache of the host */
+        if(!resolvercache_freeResult(host_getResolverCache(proc->host), res)) {
+            warning("freeaddrinfo() called with a result that getaddrinfo() did not return");
+        }
     }
     _process_changeContext(proc, PCTX_SHADOW, prevCTX);
 }
@@ -3885,6 +3993,8 @@ int process_emu_pthread_attr_init(Process* proc, pthread_attr_t *attr) {
         } else if ((na = pth_attr_new()) == NULL) {
             ret = errno;
         } else {
+            /* threads get the configured stack size unless the plugin sets one */
+            pth_attr_set(na, PTH_ATTR_STACK_SIZE, _process_getStackSize(proc));
             memmove(attr, &na, sizeof(void*));
             ret = 0;
         }
@@ -4488,7 +4598,7 @@ int process_emu_pthread_create(Process* proc, pthread_t *thread, const pthread_a
 
                 pth_attr_t defaultAttr = pth_attr_new();
                 pth_attr_set(defaultAttr, PTH_ATTR_NAME, programAuxThreadNameBuf->str);
-                pth_attr_set(defaultAttr, PTH_ATTR_STACK_SIZE, PROC_PTH_STACK_SIZE);
+                pth_attr_set(defaultAttr, PTH_ATTR_STACK_SIZE, _process_getStackSize(proc));
                 pth_attr_set(defaultAttr, PTH_ATTR_JOINABLE, TRUE);
 
                 auxThread = pth_spawn(defaultAttr, (PthSpawnFunc) _process_executeChild, data);
@@ -5261,27 +5371,43 @@ int process_emu_pthread_mutexattr_gettype(Process* proc, const pthread_mutexattr
 
 /* pthread mutex */
 
+/* emulated mutexes and condition variables keep their pth state inline in
+ * the pthread object. a zeroed object, as set by the static initializers, is
+ * an unlocked mutex or a condition without waiters. */
+G_STATIC_ASSERT(sizeof(pth_mutex_t) <= sizeof(pthread_mutex_t));
+G_STATIC_ASSERT(sizeof(pth_cond_t) <= sizeof(pthread_cond_t));
+
+static pth_mutex_t* _process_getMutex(pthread_mutex_t* mutex) {
+    pth_mutex_t* pm = (pth_mutex_t*) mutex;
+    /* the static initializers of other mutex kinds leave bits that pth
+     * would read as a locked mutex without an owner */
+    if(!(pm->mx_state & PTH_MUTEX_INITIALIZED) ||
+            ((pm->mx_state & PTH_MUTEX_LOCKED) && pm->mx_owner == NULL)) {
+        pth_mutex_init(pm);
+    }
+    return pm;
+}
+
+static pth_cond_t* _process_getCond(pthread_cond_t* cond) {
+    pth_cond_t* pcn = (pth_cond_t*) cond;
+    if(!(pcn->cn_state & PTH_COND_INITIALIZED)) {
+        pth_cond_init(pcn);
+    }
+    return pcn;
+}
+
 int process_emu_pthread_mutex_init(Process* proc, pthread_mutex_t *mutex, const pthread_mutexattr_t *attr) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if(prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
         if (mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
         } else {
-            pth_mutex_t* pm = g_malloc(sizeof(pth_mutex_t));
-            if (!pth_mutex_init(pm)) {
-                ret = errno;
-            } else {
-                memmove(mutex, &pm, sizeof(void*));
-                ret = 0;
-            }
+            memset(mutex, 0, sizeof(pthread_mutex_t));
+            pth_mutex_init((pth_mutex_t*) mutex);
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
         warning("pthread_mutex_init() is handled by pth but not implemented by shadow");
         errno = ENOSYS;
@@ -5295,26 +5421,16 @@ int process_emu_pthread_mutex_destroy(Process* proc, pthread_mutex_t *mutex) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
         if (mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(_process_getMutex(mutex)->mx_state & PTH_MUTEX_LOCKED) {
+            errno = EBUSY;
+            ret = EBUSY;
         } else {
-            pth_mutex_t* pm = NULL;
-            memmove(&pm, mutex, sizeof(void*));
-            if(pm == NULL) {
-                errno = EINVAL;
-                ret = EINVAL;
-            } else {
-                free(pm);
-                memset(mutex, 0, sizeof(void*));
-                ret = 0;
-            }
+            memset(mutex, 0, sizeof(pthread_mutex_t));
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
         warning(
                 "pthread_mutex_destroy() is handled by pth but not implemented by shadow");
@@ -5356,6 +5472,13 @@ int process_emu_pthread_mutex_getprioceiling(Process* proc, const pthread_mutex_
 }
 
 int process_emu_pthread_mutex_lock(Process* proc, pthread_mutex_t *mutex) {
+    /* taking a free or recursively held mutex never blocks, so it does not need
+     * to leave the plugin context. only contended locks wait in pth. */
+    if(proc->activeContext == PCTX_PLUGIN && mutex != NULL &&
+            pth_mutex_acquire(_process_getMutex(mutex), TRUE, NULL)) {
+        return 0;
+    }
+
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
@@ -5365,24 +5488,10 @@ int process_emu_pthread_mutex_lock(Process* proc, pthread_mutex_t *mutex) {
         if (mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_mutex_acquire(_process_getMutex(mutex), FALSE, NULL)) {
+            ret = errno;
         } else {
-            pth_mutex_t* pm = NULL;
-            memmove(&pm, mutex, sizeof(void*));
-
-            int init_result = 0;
-            if(pm == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_mutex_init(proc, mutex, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pm, mutex, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else if(!pth_mutex_acquire(pm, FALSE, NULL)) {
-                ret = errno;
-            } else {
-                ret = 0;
-            }
+            ret = 0;
         }
 
         _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
@@ -5396,82 +5505,49 @@ int process_emu_pthread_mutex_lock(Process* proc, pthread_mutex_t *mutex) {
 }
 
 int process_emu_pthread_mutex_trylock(Process* proc, pthread_mutex_t *mutex) {
-    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+    ProcessContext prevCTX = proc->activeContext;
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
+        /* never blocks, so we stay in the plugin context */
         if (mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_mutex_acquire(_process_getMutex(mutex), TRUE, NULL)) {
+            ret = errno;
         } else {
-            pth_mutex_t* pm = NULL;
-            memmove(&pm, mutex, sizeof(void*));
-
-            int init_result = 0;
-            if(pm == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_mutex_init(proc, mutex, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pm, mutex, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else if(!pth_mutex_acquire(pm, TRUE, NULL)) {
-                ret = errno;
-            } else {
-                ret = 0;
-            }
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
+        _process_changeContext(proc, prevCTX, PCTX_SHADOW);
         warning("pthread_mutex_trylock() is handled by pth but not implemented by shadow");
         errno = ENOSYS;
         ret = ENOSYS;
+        _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     }
-    _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ret;
 }
 
 int process_emu_pthread_mutex_unlock(Process* proc, pthread_mutex_t *mutex) {
-    ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
+    ProcessContext prevCTX = proc->activeContext;
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
+        /* waiting threads notice the release the next time pth schedules, so
+         * we stay in the plugin context */
         if (mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_mutex_release(_process_getMutex(mutex))) {
+            ret = errno;
         } else {
-            pth_mutex_t* pm = NULL;
-            memmove(&pm, mutex, sizeof(void*));
-
-            int init_result = 0;
-            if(pm == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_mutex_init(proc, mutex, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pm, mutex, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else if(!pth_mutex_release(pm)) {
-                ret = errno;
-            } else {
-                ret = 0;
-            }
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
+        _process_changeContext(proc, prevCTX, PCTX_SHADOW);
         warning("pthread_mutex_unlock() is handled by pth but not implemented by shadow");
         errno = ENOSYS;
         ret = ENOSYS;
+        _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     }
-    _process_changeContext(proc, PCTX_SHADOW, prevCTX);
     return ret;
 }
 
@@ -5855,23 +5931,14 @@ int process_emu_pthread_cond_init(Process* proc, pthread_cond_t *cond, const pth
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
         if (cond == NULL) {
             errno = EINVAL;
             ret = EINVAL;
         } else {
-            pth_cond_t *pcn = g_malloc(sizeof(pth_cond_t));
-            if (!pth_cond_init(pcn)) {
-                ret = errno;
-            } else {
-                memmove(cond, &pcn, sizeof(void*));
-                ret = 0;
-            }
+            memset(cond, 0, sizeof(pthread_cond_t));
+            pth_cond_init((pth_cond_t*) cond);
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
         warning("pthread_cond_init() is handled by pth but not implemented by shadow");
         errno = ENOSYS;
@@ -5885,26 +5952,16 @@ int process_emu_pthread_cond_destroy(Process* proc, pthread_cond_t *cond) {
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
-        _process_changeContext(proc, PCTX_SHADOW, PCTX_PTH);
-        utility_assert(proc->tstate == pth_gctx_get());
-
         if (cond == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(_process_getCond(cond)->cn_waiters > 0) {
+            errno = EBUSY;
+            ret = EBUSY;
         } else {
-            pth_cond_t* pcn = NULL;
-            memmove(&pcn, cond, sizeof(void*));
-            if(pcn == NULL) {
-                errno = EINVAL;
-                ret = EINVAL;
-            } else {
-                free(pcn);
-                memset(cond, 0, sizeof(void*));
-                ret = 0;
-            }
+            memset(cond, 0, sizeof(pthread_cond_t));
+            ret = 0;
         }
-
-        _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
     } else {
         warning("pthread_cond_destroy() is handled by pth but not implemented by shadow");
         errno = ENOSYS;
@@ -5915,6 +5972,12 @@ int process_emu_pthread_cond_destroy(Process* proc, pthread_cond_t *cond) {
 }
 
 int process_emu_pthread_cond_broadcast(Process* proc, pthread_cond_t *cond) {
+    /* without waiters there is nothing to wake, so we skip the pth scheduler */
+    if(proc->activeContext == PCTX_PLUGIN && cond != NULL &&
+            _process_getCond(cond)->cn_waiters == 0) {
+        return 0;
+    }
+
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
@@ -5924,23 +5987,10 @@ int process_emu_pthread_cond_broadcast(Process* proc, pthread_cond_t *cond) {
         if (cond == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_cond_notify(_process_getCond(cond), TRUE)) {
+            ret = errno;
         } else {
-            int init_result = 0;
-            pth_cond_t* pcn = NULL;
-            memmove(&pcn, cond, sizeof(void*));
-            if(pcn == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_cond_init(proc, cond, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pcn, cond, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else if(!pth_cond_notify(pcn, TRUE)) {
-                ret = errno;
-            } else {
-                ret = 0;
-            }
+            ret = 0;
         }
 
         _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
@@ -5954,6 +6004,12 @@ int process_emu_pthread_cond_broadcast(Process* proc, pthread_cond_t *cond) {
 }
 
 int process_emu_pthread_cond_signal(Process* proc, pthread_cond_t *cond) {
+    /* without waiters there is nothing to wake, so we skip the pth scheduler */
+    if(proc->activeContext == PCTX_PLUGIN && cond != NULL &&
+            _process_getCond(cond)->cn_waiters == 0) {
+        return 0;
+    }
+
     ProcessContext prevCTX = _process_changeContext(proc, proc->activeContext, PCTX_SHADOW);
     int ret = 0;
     if (prevCTX == PCTX_PLUGIN) {
@@ -5963,23 +6019,10 @@ int process_emu_pthread_cond_signal(Process* proc, pthread_cond_t *cond) {
         if (cond == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_cond_notify(_process_getCond(cond), FALSE)) {
+            ret = errno;
         } else {
-            int init_result = 0;
-            pth_cond_t* pcn = NULL;
-            memmove(&pcn, cond, sizeof(void*));
-            if(pcn == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_cond_init(proc, cond, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pcn, cond, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else if(!pth_cond_notify(pcn, FALSE)) {
-                ret = errno;
-            } else {
-                ret = 0;
-            }
+            ret = 0;
         }
 
         _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
@@ -6002,36 +6045,10 @@ int process_emu_pthread_cond_wait(Process* proc, pthread_cond_t *cond, pthread_m
         if (cond == NULL || mutex == NULL) {
             errno = EINVAL;
             ret = EINVAL;
+        } else if(!pth_cond_await(_process_getCond(cond), _process_getMutex(mutex), NULL)) {
+            ret = errno;
         } else {
-            int init_result = 0;
-            pth_cond_t* pcn = NULL;
-            memmove(&pcn, cond, sizeof(void*));
-            if(pcn == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_cond_init(proc, cond, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pcn, cond, sizeof(void*));
-            if(init_result != 0) {
-                ret = errno;
-            } else {
-                init_result = 0;
-                pth_mutex_t* pm = NULL;
-                memmove(&pm, mutex, sizeof(void*));
-                if(pm == NULL) {
-                    _process_changeContext(proc, PCTX_PTH, prevCTX);
-                    init_result = process_emu_pthread_mutex_init(proc, mutex, NULL);
-                    _process_changeContext(proc, prevCTX, PCTX_PTH);
-                }
-                memmove(&pm, mutex, sizeof(void*));
-                if(init_result != 0) {
-                    ret = errno;
-                } else if(!pth_cond_await(pcn, pm, NULL)) {
-                    ret = errno;
-                } else {
-                    ret = 0;
-                }
-            }
+            ret = 0;
         }
 
         _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
@@ -6056,43 +6073,16 @@ int process_emu_pthread_cond_timedwait(Process* proc, pthread_cond_t *cond, pthr
             errno = EINVAL;
             ret = EINVAL;
         } else {
-            int init_result = 0;
-            pth_cond_t* pcn = NULL;
-            memmove(&pcn, cond, sizeof(void*));
-            if(pcn == NULL) {
-                _process_changeContext(proc, PCTX_PTH, prevCTX);
-                init_result = process_emu_pthread_cond_init(proc, cond, NULL);
-                _process_changeContext(proc, prevCTX, PCTX_PTH);
-            }
-            memmove(&pcn, cond, sizeof(void*));
-            if(init_result != 0) {
+            pth_time_t t = pth_time(abstime->tv_sec, (abstime->tv_nsec)/1000);
+            pth_event_t ev = pth_event(PTH_EVENT_TIME, t);
+            if (!pth_cond_await(_process_getCond(cond), _process_getMutex(mutex), ev)) {
                 ret = errno;
+            } else if (pth_event_status(ev) == PTH_STATUS_OCCURRED) {
+                ret = ETIMEDOUT;
             } else {
-                pth_event_t ev;
-                init_result = 0;
-                pth_mutex_t* pm = NULL;
-                memmove(&pm, mutex, sizeof(void*));
-                if(pm == NULL) {
-                    _process_changeContext(proc, PCTX_PTH, prevCTX);
-                    init_result = process_emu_pthread_mutex_init(proc, mutex, NULL);
-                    _process_changeContext(proc, prevCTX, PCTX_PTH);
-                }
-                memmove(&pm, mutex, sizeof(void*));
-                if(init_result != 0) {
-                    ret = errno;
-                } else {
-                    pth_time_t t = pth_time(abstime->tv_sec, (abstime->tv_nsec)/1000);
-                    ev = pth_event(PTH_EVENT_TIME, t);
-                    if (!pth_cond_await(pcn, pm, ev)) {
-                        ret = errno;
-                    } else if (pth_event_status(ev) == PTH_STATUS_OCCURRED) {
-                        ret = ETIMEDOUT;
-                    } else {
-                        ret = 0;
-                    }
-                    pth_event_free(ev, PTH_FREE_THIS);
-                }
+                ret = 0;
             }
+            pth_event_free(ev, PTH_FREE_THIS);
         }
 
         _process_changeContext(proc, PCTX_PTH, PCTX_SHADOW);
@@ -47,6 +47,7 @@ void* process_emu_malloc(Process* proc, size_t size);
 void* process_emu_calloc(Process* proc, size_t nmemb, size_t size);
 void* process_emu_realloc(Process* proc, void *ptr, size_t size);
 void process_emu_free(Process* proc, void *ptr);
+size_t process_emu_malloc_usable_size(Process* proc, void *ptr);
 int process_emu_posix_memalign(Process* proc, void** memptr, size_t alignment, size_t size);
 void* process_emu_memalign(Process* proc, size_t blocksize, size_t bytes);
 void* process_emu_aligned_alloc(Process* proc, size_t alignment, size_t size);
@@ -73,6 +74,7 @@ int process_emu_getpeername(Process* proc, int fd, struct sockaddr* addr, sockle
 ssize_t process_emu_send(Process* proc, int fd, const void *buf, size_t n, int flags);
 ssize_t process_emu_sendto(Process* proc, int fd, const void *buf, size_t n, int flags, const struct sockaddr* addr, socklen_t addr_len);
 ssize_t process_emu_sendmsg(Process* proc, int fd, const struct msghdr *message, int flags);
+ssize_t process_emu_shadow_send_virtual(Process* proc, int fd, size_t n);
 ssize_t process_emu_recv(Process* proc, int fd, void *buf, size_t n, int flags);
 ssize_t process_emu_recvfrom(Process* proc, int fd, void *buf, size_t n, int flags, struct sockaddr* addr, socklen_t *restrict addr_len);
 ssize_t process_emu_recvmsg(Process* proc, int fd, struct msghdr *message, int flags);
@@ -4,6 +4,10 @@
  * See LICENSE for licensing information
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <dlfcn.h>
 #include <unistd.h>
 #include <glib/gstdio.h>
 
@@ -22,22 +26,52 @@
 #define PLUGIN_GLOBALS_SIZE_SYMBOL "__hoisted_globals_size"
 #define PLUGIN_GLOBALS_POINTER_SYMBOL "__hoisted_globals_pointer"
 
+/**
+ * Optional symbols added when the globals were hoisted in pointer mode, where
+ * the plugin reaches its globals through __hoisted_globals_pointer instead of
+ * directly. The relocations are the offsets of pointers in the state that are
+ * statically initialized to point into the state itself.
+ */
+#define PLUGIN_GLOBALS_INDIRECT_SYMBOL "__hoisted_globals_indirect"
+#define PLUGIN_GLOBALS_RELOCATIONS_SYMBOL "__hoisted_globals_relocations"
+#define PLUGIN_GLOBALS_RELOCATIONS_SIZE_SYMBOL "__hoisted_globals_relocations_size"
+
 /* Global symbols that plugins may define to hook changes in execution control */
 #define PLUGIN_POSTLOAD_SYMBOL "__shadow_plugin_load__"
 #define PLUGIN_PREUNLOAD_SYMBOL "__shadow_plugin_unload__"
 #define PLUGIN_PREENTER_SYMBOL "__shadow_plugin_enter__"
 #define PLUGIN_POSTEXIT_SYMBOL "__shadow_plugin_exit__"
 
+/* called in a copy of the interposer that we loaded into a new linker namespace */
+#define INTERPOSER_FORWARD_SYMBOL "interposer_forwardTo"
+
 typedef gint (*PluginMainFunc)(int argc, char* argv[]);
 typedef void (*PluginHookFunc)(void* uniqueid);
+typedef void (*InterposerForwardFunc)(void* handle);
+typedef int* (*ErrnoLocationFunc)(void);
+
+/* set once dlmopen ran out of linker namespaces, so we stop trying */
+static volatile gint namespacesExhausted = 0;
+
+/* the interposer in the main namespace, whose symbol we use to find its path */
+extern void interposer_setShadowIsLoaded();
 
 struct _Program {
     GQuark id;
 
     GString* name;
     GString* path;
-    GModule* handle;
-    gboolean isTemporary;
+    gpointer handle;
+
+    /* size of the pth stacks of the plugin threads, 0 for the default */
+    guint stackSize;
+
+    /* if loaded with dlmopen, the interposer copy that leads the namespace
+     * and the handle to the main interposer that it forwards to */
+    gpointer namespaceInterposer;
+    gpointer mainInterposer;
+    /* the libc of that namespace keeps its own errno, which the plugin sees */
+    ErrnoLocationFunc namespaceErrno;
 
     PluginMainFunc main;
 
@@ -53,6 +87,16 @@ struct _Program {
     gpointer residentState;
     ProgramState defaultState;
 
+    /* TRUE if the plugin accesses its globals through residentStatePointer,
+     * so switching state only requires changing the pointer */
+    gboolean isIndirect;
+    guint32* relocations;
+    gsize numRelocations;
+
+    /* in copy mode, the state whose contents are in the resident memory. its
+     * own copy is stale until another state is swapped in and we write back. */
+    ProgramState residentOwner;
+
     /*
      * TRUE from when we've called into plug-in code until the call completes.
      * Note that the plug-in may get back into shadow code during execution, by
@@ -68,14 +112,20 @@ void program_swapInState(Program* prog, ProgramState state) {
     MAGIC_ASSERT(prog);
     utility_assert(!prog->isExecuting);
 
-    /* context switch from shadow to plug-in library
-     *
-     * TODO: we can be smarter here - save a pointer to the last plugin that
-     * was loaded... if the physical memory locations still has our state,
-     * there is no need to copy it in again. similarly for stopExecuting()
-     */
-    /* destination, source, size */
-    g_memmove(prog->residentState, state, prog->residentStateSize);
+    /* context switch from shadow to plug-in library */
+    if(prog->isIndirect) {
+        /* the plugin finds its globals through the pointer */
+        *((gpointer*)prog->residentStatePointer) = state;
+    } else if(prog->residentOwner != state) {
+        /* write back the previous owner before its memory gets overwritten.
+         * if the state is already resident, there is nothing to copy at all. */
+        if(prog->residentOwner) {
+            /* destination, source, size */
+            g_memmove(prog->residentOwner, prog->residentState, prog->residentStateSize);
+        }
+        g_memmove(prog->residentState, state, prog->residentStateSize);
+        prog->residentOwner = state;
+    }
 
     prog->isExecuting = TRUE;
 }
@@ -83,11 +133,17 @@ void program_swapInState(Program* prog, ProgramState state) {
 void program_swapOutState(Program* prog, ProgramState state) {
     MAGIC_ASSERT(prog);
     utility_assert(prog->isExecuting);
+    utility_assert(prog->isIndirect || prog->residentOwner == state);
 
+    /* the state stays resident until someone else needs the memory */
     prog->isExecuting = FALSE;
+}
 
-    /* destination, source, size */
-    g_memmove(state, prog->residentState, prog->residentStateSize);
+/* returns NULL if the symbol was found, otherwise the error message */
+static const gchar* _program_lookupSymbol(Program* prog, const gchar* name, gpointer* symbol) {
+    dlerror();
+    *symbol = dlsym(prog->handle, name);
+    return dlerror();
 }
 
 static void program_callPostLibraryLoadHookFunc(Program* prog) {
@@ -177,8 +233,63 @@ static gboolean _program_copyFile(gchar* fromPath, gchar* toPath) {
     return TRUE;
 }
 
-Program* program_new(const gchar* name, const gchar* path) {
-    utility_assert(path);
+static gpointer _program_openInNamespace(const gchar* path, gpointer* namespaceInterposer, gpointer* mainInterposer) {
+    if(g_atomic_int_get(&namespacesExhausted)) {
+        return NULL;
+    }
+
+    /* the path of the interposer that shadow was preloaded with */
+    Dl_info info;
+    memset(&info, 0, sizeof(Dl_info));
+    if(!dladdr((void*)interposer_setShadowIsLoaded, &info) || !info.dli_fname) {
+        warning("unable to find the path of the interposer library");
+        return NULL;
+    }
+
+    /* the interposer copy must be the first object in the namespace and have
+     * global scope there, so it intercepts libc just like LD_PRELOAD does in
+     * the main namespace. glibc refuses RTLD_GLOBAL for a new namespace, so
+     * we promote it after the namespace exists. */
+    gpointer interposer = dlmopen(LM_ID_NEWLM, info.dli_fname, RTLD_LAZY|RTLD_LOCAL);
+    if(!interposer) {
+        message("dlmopen() failed for '%s', falling back to private file copies: %s", info.dli_fname, dlerror());
+        g_atomic_int_set(&namespacesExhausted, 1);
+        return NULL;
+    }
+
+    Lmid_t namespaceID = 0;
+    InterposerForwardFunc forwardTo = dlsym(interposer, INTERPOSER_FORWARD_SYMBOL);
+    gpointer mainHandle = dlopen(info.dli_fname, RTLD_LAZY|RTLD_NOLOAD);
+    if(dlinfo(interposer, RTLD_DI_LMID, &namespaceID) != 0 || !forwardTo || !mainHandle ||
+            !dlmopen(namespaceID, info.dli_fname, RTLD_LAZY|RTLD_NOLOAD|RTLD_GLOBAL)) {
+        warning("unable to set up the interposer in a new namespace: %s", dlerror());
+        if(mainHandle) {
+            dlclose(mainHandle);
+        }
+        dlclose(interposer);
+        return NULL;
+    }
+
+    /* the copy sends every call to the main interposer, which knows about shadow.
+     * the extra reference from the promotion is dropped when we close the copy. */
+    forwardTo(mainHandle);
+
+    gpointer handle = dlmopen(namespaceID, path, RTLD_LAZY|RTLD_LOCAL);
+    if(!handle) {
+        warning("dlmopen() failed for '%s': %s", path, dlerror());
+        dlclose(interposer);
+        dlclose(interposer);
+        dlclose(mainHandle);
+        return NULL;
+    }
+
+    *namespaceInterposer = interposer;
+    *mainInterposer = mainHandle;
+    return handle;
+}
+
+static Program* _program_new(const gchar* name, const gchar* path, guint stackSize, gpointer handle) {
+    utility_assert(path && handle);
 
     Program* prog = g_new0(Program, 1);
     MAGIC_INIT(prog);
@@ -186,109 +297,104 @@ Program* program_new(const gchar* name, const gchar* path) {
     prog->id = g_quark_from_string((const gchar*) name);;
     prog->name = g_string_new(name);
     prog->path = g_string_new(path);
-
-    /*
-     * now get the plugin handle from the library at filename.
-     *
-     * @warning only global dlopens are searchable with dlsym
-     * we cant use G_MODULE_BIND_LOCAL if we want to be able to lookup
-     * functions using dlsym in the plugin itself. if G_MODULE_BIND_LOCAL
-     * functionality is desired, then we must require plugins to separate their
-     * intercepted functions to a SHARED library, and link the plugin to that.
-     *
-     * @note this will call g_module_check_init() in the plug-in if it contains
-     * that function.
-     */
-    prog->handle = g_module_open(prog->path->str, G_MODULE_BIND_LAZY|G_MODULE_BIND_LOCAL);
-    if(prog->handle) {
-        message("successfully loaded private plug-in '%s' at %p", prog->path->str, prog);
-    } else {
-        const gchar* errorMessage = g_module_error();
-        critical("g_module_open() failed: %s", errorMessage);
-        error("unable to load private plug-in '%s'", prog->path->str);
-    }
+    prog->handle = handle;
+    prog->stackSize = stackSize;
 
     /* make sure it has the required init function */
     gpointer function = NULL;
-    gboolean success = FALSE;
+    const gchar* errorMessage = NULL;
 
-    success = g_module_symbol(prog->handle, PLUGIN_MAIN_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_MAIN_SYMBOL, &function);
+    if(!errorMessage) {
         prog->main = function;
         message("found '%s' at %p", PLUGIN_MAIN_SYMBOL, function);
     } else {
-        const gchar* errorMessage = g_module_error();
-        critical("g_module_symbol() failed: %s", errorMessage);
+        critical("dlsym() failed: %s", errorMessage);
         error("unable to find the required function symbol '%s' in plug-in '%s'",
                 PLUGIN_MAIN_SYMBOL, path);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_GLOBALS_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_GLOBALS_SYMBOL, &function);
+    if(!errorMessage) {
         prog->residentState = function;
         message("found '%s' at %p", PLUGIN_GLOBALS_SYMBOL, function);
     } else {
-        const gchar* errorMessage = g_module_error();
-        critical("g_module_symbol() failed: %s", errorMessage);
+        critical("dlsym() failed: %s", errorMessage);
         error("unable to find the required merged globals struct symbol '%s' in plug-in '%s'",
                 PLUGIN_GLOBALS_SYMBOL, path);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_GLOBALS_POINTER_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_GLOBALS_POINTER_SYMBOL, &function);
+    if(!errorMessage) {
         prog->residentStatePointer = function;
         message("found '%s' at %p", PLUGIN_GLOBALS_POINTER_SYMBOL, function);
     } else {
-        const gchar* errorMessage = g_module_error();
-        critical("g_module_symbol() failed: %s", errorMessage);
+        critical("dlsym() failed: %s", errorMessage);
         error("unable to find the required merged globals struct symbol '%s' in plug-in '%s'",
                 PLUGIN_GLOBALS_POINTER_SYMBOL, path);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_GLOBALS_SIZE_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_GLOBALS_SIZE_SYMBOL, &function);
+    if(!errorMessage) {
         utility_assert(function);
         gint s = *((gint*) function);
         prog->residentStateSize = (gsize) s;
         message("found '%s' of value '%i' at %p", PLUGIN_GLOBALS_SIZE_SYMBOL, s, function);
     } else {
-        const gchar* errorMessage = g_module_error();
-        critical("g_module_symbol() failed: %s", errorMessage);
+        critical("dlsym() failed: %s", errorMessage);
         error("unable to find the required merged globals struct symbol '%s' in plug-in '%s'",
                 PLUGIN_GLOBALS_SIZE_SYMBOL, path);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_POSTLOAD_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_POSTLOAD_SYMBOL, &function);
+    if(!errorMessage) {
         prog->postLibraryLoad = function;
         message("found '%s' at %p", PLUGIN_POSTLOAD_SYMBOL, function);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_PREUNLOAD_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_PREUNLOAD_SYMBOL, &function);
+    if(!errorMessage) {
         prog->preLibraryUnload = function;
         message("found '%s' at %p", PLUGIN_PREUNLOAD_SYMBOL, function);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_PREENTER_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_PREENTER_SYMBOL, &function);
+    if(!errorMessage) {
         prog->preProcessEnter = function;
         message("found '%s' at %p", PLUGIN_PREENTER_SYMBOL, function);
     }
 
     function = NULL;
-    success = g_module_symbol(prog->handle, PLUGIN_POSTEXIT_SYMBOL, &function);
-    if(success) {
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_POSTEXIT_SYMBOL, &function);
+    if(!errorMessage) {
         prog->postProcessExit = function;
         message("found '%s' at %p", PLUGIN_POSTEXIT_SYMBOL, function);
     }
 
+    function = NULL;
+    errorMessage = _program_lookupSymbol(prog, PLUGIN_GLOBALS_INDIRECT_SYMBOL, &function);
+    if(!errorMessage && function && *((gint*) function)) {
+        prog->isIndirect = TRUE;
+        message("found '%s' at %p, plug-in globals are accessed through '%s'",
+                PLUGIN_GLOBALS_INDIRECT_SYMBOL, function, PLUGIN_GLOBALS_POINTER_SYMBOL);
+
+        gpointer relocations = NULL;
+        function = NULL;
+        if(!_program_lookupSymbol(prog, PLUGIN_GLOBALS_RELOCATIONS_SYMBOL, &relocations) &&
+                !_program_lookupSymbol(prog, PLUGIN_GLOBALS_RELOCATIONS_SIZE_SYMBOL, &function)) {
+            prog->relocations = relocations;
+            prog->numRelocations = (gsize) *((gint*) function);
+            message("found %"G_GSIZE_FORMAT" relocations in '%s' at %p",
+                    prog->numRelocations, PLUGIN_GLOBALS_RELOCATIONS_SYMBOL, relocations);
+        }
+    }
+
     program_callPostLibraryLoadHookFunc(prog);
 
     /* finally, store a copy of the defaults as they exist now */
@@ -300,24 +406,49 @@ Program* program_new(const gchar* name, const gchar* path) {
     return prog;
 }
 
+Program* program_new(const gchar* name, const gchar* path, guint stackSize) {
+    utility_assert(path);
+
+    /*
+     * now get the plugin handle from the library at filename.
+     *
+     * @warning the plugin is loaded locally, so the symbols of one plugin
+     * never resolve the undefined symbols of another plugin.
+     */
+    gpointer handle = dlopen(path, RTLD_LAZY|RTLD_LOCAL);
+    if(handle) {
+        message("successfully loaded plug-in '%s' at %p", path, handle);
+    } else {
+        critical("dlopen() failed: %s", dlerror());
+        error("unable to load plug-in '%s'", path);
+    }
+
+    return _program_new(name, path, stackSize, handle);
+}
+
 void program_free(Program* prog) {
     MAGIC_ASSERT(prog);
 
     if(prog->handle) {
+        /* the hook runs in the original memory, not in the state of a process */
+        if(prog->isIndirect) {
+            *((gpointer*)prog->residentStatePointer) = prog->residentState;
+        }
         program_callPreLibraryUnloadHookFunc(prog);
-        gboolean success = g_module_close(prog->handle);
-        if(!success) {
-            const gchar* errorMessage = g_module_error();
-            warning("g_module_close() failed: %s", errorMessage);
+        if(dlclose(prog->handle) != 0) {
+            warning("dlclose() failed: %s", dlerror());
             warning("failed closing plugin '%s'", prog->path->str);
         }
     }
 
-    /* TODO: this unlink should be removed when we no longer copy plugins
-     * before loading them. see the other TODO above in this file.
-     */
-    if(prog->isTemporary) {
-        g_unlink(prog->path->str);
+    /* the namespace goes away with its last object. the interposer copy holds
+     * two references, one from loading it and one from making it global. */
+    if(prog->namespaceInterposer) {
+        dlclose(prog->namespaceInterposer);
+        dlclose(prog->namespaceInterposer);
+    }
+    if(prog->mainInterposer) {
+        dlclose(prog->mainInterposer);
     }
     if(prog->path) {
         g_string_free(prog->path, TRUE);
@@ -337,10 +468,24 @@ void program_free(Program* prog) {
 Program* program_getTemporaryCopy(Program* prog) {
     utility_assert(prog);
 
-    /* do not open the path directly, but rather copy to tmp directory first
-     * to avoid multiple threads using the same memory space.
-     * TODO: this should eventually be replaced when we have thread-local
-     * storage working correctly in the LLVM module-pass code */
+    /* each worker needs its own memory space for the plugin. a new linker
+     * namespace gives us that while mapping the original file. */
+    gpointer namespaceInterposer = NULL, mainInterposer = NULL;
+    gpointer handle = _program_openInNamespace(prog->path->str, &namespaceInterposer, &mainInterposer);
+    if(handle) {
+        message("successfully loaded private plug-in '%s' in a new namespace at %p", prog->path->str, handle);
+        Program* progCopy = _program_new(prog->name->str, prog->path->str, prog->stackSize, handle);
+        progCopy->namespaceInterposer = namespaceInterposer;
+        progCopy->mainInterposer = mainInterposer;
+        progCopy->namespaceErrno = dlsym(handle, "__errno_location");
+        if(!progCopy->namespaceErrno) {
+            warning("unable to find errno in the namespace of '%s': %s", prog->path->str, dlerror());
+        }
+        return progCopy;
+    }
+
+    /* otherwise, copy to tmp directory first, since dlopen would share the
+     * mapping of the same file between threads */
     GString* pathCopy = _program_getTemporaryFilePath(prog->path->str);
 
     /* now we need to copy the actual contents to our new file */
@@ -349,9 +494,20 @@ Program* program_getTemporaryCopy(Program* prog) {
         return NULL;
     }
 
-    Program* progCopy = program_new(prog->name->str, pathCopy->str);
-    progCopy->isTemporary = TRUE;
+    handle = dlopen(pathCopy->str, RTLD_LAZY|RTLD_LOCAL);
 
+    /* the mapping stays valid without the file, and removing it right away
+     * means it is never left behind, no matter how we exit */
+    g_unlink(pathCopy->str);
+
+    if(handle) {
+        message("successfully loaded private plug-in copy '%s' at %p", pathCopy->str, handle);
+    } else {
+        critical("dlopen() failed: %s", dlerror());
+        error("unable to load private plug-in copy '%s'", pathCopy->str);
+    }
+
+    Program* progCopy = _program_new(prog->name->str, pathCopy->str, prog->stackSize, handle);
     g_string_free(pathCopy, TRUE);
 
     return progCopy;
@@ -359,11 +515,30 @@ Program* program_getTemporaryCopy(Program* prog) {
 
 ProgramState program_newDefaultState(Program* prog) {
     MAGIC_ASSERT(prog);
-    return g_slice_copy(prog->residentStateSize, prog->defaultState);
+    ProgramState state = g_slice_copy(prog->residentStateSize, prog->defaultState);
+
+    /* pointers into the state were initialized relative to the original
+     * memory, but in pointer mode the state never gets copied there */
+    if(prog->isIndirect) {
+        for(gsize i = 0; i < prog->numRelocations; i++) {
+            utility_assert(prog->relocations[i] + sizeof(gpointer) <= prog->residentStateSize);
+            gchar** target = (gchar**) (((gchar*)state) + prog->relocations[i]);
+            *target = ((gchar*)state) + (*target - ((gchar*)prog->residentState));
+        }
+    }
+
+    return state;
 }
 
 void program_freeState(Program* prog, gpointer state) {
     MAGIC_ASSERT(prog);
+    utility_assert(!prog->isExecuting || prog->residentOwner != state);
+
+    /* the resident copy is garbage now, don't write it back */
+    if(prog->residentOwner == state) {
+        prog->residentOwner = NULL;
+    }
+
     g_slice_free1(prog->residentStateSize, state);
 }
 
@@ -386,3 +561,22 @@ void* program_getHandle(Program* prog) {
     MAGIC_ASSERT(prog);
     return prog->handle;
 }
+
+guint program_getStackSize(Program* prog) {
+    MAGIC_ASSERT(prog);
+    return prog->stackSize;
+}
+
+void program_loadErrno(Program* prog) {
+    MAGIC_ASSERT(prog);
+    if(prog->namespaceErrno) {
+        errno = *(prog->namespaceErrno());
+    }
+}
+
+void program_storeErrno(Program* prog) {
+    MAGIC_ASSERT(prog);
+    if(prog->namespaceErrno) {
+        *(prog->namespaceErrno()) = errno;
+    }
+}
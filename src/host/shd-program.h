@@ -12,7 +12,7 @@
 typedef struct _Program Program;
 typedef gpointer ProgramState;
 
-Program* program_new(const gchar* name, const gchar* path);
+Program* program_new(const gchar* name, const gchar* path, guint stackSize);
 void program_free(Program* prog);
 
 void program_swapInState(Program* prog, ProgramState state);
@@ -26,6 +26,14 @@ GQuark* program_getID(Program* prog);
 const gchar* program_getName(Program* prog);
 const gchar* program_getPath(Program* prog);
 void* program_getHandle(Program* prog);
+/* the stack size for the plugin threads, or 0 to use the default */
+guint program_getStackSize(Program* prog);
+
+/* a plugin in its own linker namespace has its own errno. load copies it
+ * into ours when the plugin calls into shadow, store copies ours back when
+ * we return to the plugin. both do nothing for plugins sharing our libc. */
+void program_loadErrno(Program* prog);
+void program_storeErrno(Program* prog);
 
 gint program_callMainFunc(Program* prog, gchar** argv, gint argc);
 void program_callPreProcessEnterHookFunc(Program* prog);
@@ -0,0 +1,199 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#include "shadow.h"
+
+typedef struct _ResolverKey ResolverKey;
+typedef struct _ResolverEntry ResolverEntry;
+typedef struct _ResolverResult ResolverResult;
+
+/* lookups build one on the stack that points at the caller's strings */
+struct _ResolverKey {
+    gchar* name;
+    gchar* service;
+    gint flags;
+};
+
+struct _ResolverEntry {
+    /* our key in the cache, owning its strings */
+    ResolverKey key;
+    /* in network order */
+    in_addr_t ip;
+    in_port_t port;
+    /* our position in the lru queue */
+    GList* lruLink;
+    MAGIC_DECLARE;
+};
+
+/* the copy of an entry that a caller owns, in a single allocation */
+struct _ResolverResult {
+    /* must be first, the plugin only ever sees this part */
+    struct addrinfo info;
+    struct sockaddr_in address;
+};
+
+struct _ResolverCache {
+    guint capacity;
+    /* key -> entry, the key is part of the entry */
+    GHashTable* entries;
+    /* most recently used entry at the head */
+    GQueue* lru;
+    /* the results we handed out that were not freed yet */
+    GHashTable* results;
+    MAGIC_DECLARE;
+};
+
+/* a missing string is different from an empty one */
+static guint _resolverkey_hash(gconstpointer data) {
+    const ResolverKey* key = data;
+    guint hash = key->name ? g_str_hash(key->name) : 0;
+    hash = (hash * 31) + (key->service ? g_str_hash(key->service) : 0);
+    return (hash * 31) + (guint)key->flags;
+}
+
+static gboolean _resolverkey_equal(gconstpointer a, gconstpointer b) {
+    const ResolverKey* keyA = a;
+    const ResolverKey* keyB = b;
+    return keyA->flags == keyB->flags && g_strcmp0(keyA->name, keyB->name) == 0 &&
+            g_strcmp0(keyA->service, keyB->service) == 0;
+}
+
+static ResolverEntry* _resolverentry_new(const gchar* name, const gchar* service, gint flags,
+        in_addr_t ip, in_port_t port) {
+    ResolverEntry* entry = g_new0(ResolverEntry, 1);
+    MAGIC_INIT(entry);
+
+    entry->key.name = g_strdup(name);
+    entry->key.service = g_strdup(service);
+    entry->key.flags = flags;
+    entry->ip = ip;
+    entry->port = port;
+
+    return entry;
+}
+
+static void _resolverentry_free(ResolverEntry* entry) {
+    MAGIC_ASSERT(entry);
+    g_free(entry->key.name);
+    g_free(entry->key.service);
+    MAGIC_CLEAR(entry);
+    g_free(entry);
+}
+
+ResolverCache* resolvercache_new(guint capacity) {
+    utility_assert(capacity > 0);
+
+    ResolverCache* cache = g_new0(ResolverCache, 1);
+    MAGIC_INIT(cache);
+
+    cache->capacity = capacity;
+    cache->entries = g_hash_table_new(_resolverkey_hash, _resolverkey_equal);
+    cache->lru = g_queue_new();
+    cache->results = g_hash_table_new_full(g_direct_hash, g_direct_equal, g_free, NULL);
+
+    return cache;
+}
+
+static void _resolvercache_evict(ResolverCache* cache, ResolverEntry* entry) {
+    g_hash_table_remove(cache->entries, &(entry->key));
+    g_queue_delete_link(cache->lru, entry->lruLink);
+    _resolverentry_free(entry);
+}
+
+void resolvercache_free(ResolverCache* cache) {
+    MAGIC_ASSERT(cache);
+
+    while(!g_queue_is_empty(cache->lru)) {
+        _resolvercache_evict(cache, g_queue_peek_tail(cache->lru));
+    }
+
+    /* the processes of the host are gone, so nobody frees their results */
+    g_hash_table_destroy(cache->results);
+    g_hash_table_destroy(cache->entries);
+    g_queue_free(cache->lru);
+
+    MAGIC_CLEAR(cache);
+    g_free(cache);
+}
+
+/* the caller may modify the result like any other getaddrinfo result */
+static struct addrinfo* _resolvercache_newResult(ResolverCache* cache, ResolverEntry* entry) {
+    ResolverResult* result = g_new0(ResolverResult, 1);
+
+    result->address.sin_family = AF_INET; /* libcurl expects this to be set */
+    result->address.sin_addr.s_addr = entry->ip;
+    result->address.sin_port = entry->port;
+
+    result->info.ai_addr = (struct sockaddr*) &(result->address);
+    result->info.ai_addrlen = sizeof(struct sockaddr_in);
+    result->info.ai_canonname = NULL;
+    result->info.ai_family = AF_INET;
+    result->info.ai_flags = 0;
+    result->info.ai_next = NULL;
+    result->info.ai_protocol = 0;
+    result->info.ai_socktype = SOCK_STREAM;
+
+    g_hash_table_add(cache->results, result);
+    return &(result->info);
+}
+
+struct addrinfo* resolvercache_lookup(ResolverCache* cache, const gchar* name,
+        const gchar* service, gint flags) {
+    MAGIC_ASSERT(cache);
+
+    ResolverKey key = {(gchar*)name, (gchar*)service, flags};
+    ResolverEntry* entry = g_hash_table_lookup(cache->entries, &key);
+
+    if(!entry) {
+        return NULL;
+    }
+
+    /* move to the front of the lru queue */
+    g_queue_unlink(cache->lru, entry->lruLink);
+    g_queue_push_head_link(cache->lru, entry->lruLink);
+
+    return _resolvercache_newResult(cache, entry);
+}
+
+struct addrinfo* resolvercache_insert(ResolverCache* cache, const gchar* name,
+        const gchar* service, gint flags, in_addr_t ip, in_port_t port) {
+    MAGIC_ASSERT(cache);
+
+    ResolverKey key = {(gchar*)name, (gchar*)service, flags};
+
+    ResolverEntry* existing = g_hash_table_lookup(cache->entries, &key);
+    if(existing) {
+        _resolvercache_evict(cache, existing);
+    }
+    while(g_queue_get_length(cache->lru) >= cache->capacity) {
+        _resolvercache_evict(cache, g_queue_peek_tail(cache->lru));
+    }
+
+    ResolverEntry* entry = _resolverentry_new(name, service, flags, ip, port);
+    g_queue_push_head(cache->lru, entry);
+    entry->lruLink = g_queue_peek_head_link(cache->lru);
+    g_hash_table_insert(cache->entries, &(entry->key), entry);
+
+    return _resolvercache_newResult(cache, entry);
+}
+
+gboolean resolvercache_freeResult(ResolverCache* cache, struct addrinfo* result) {
+    MAGIC_ASSERT(cache);
+
+    /* frees the result through the destroy function */
+    if(g_hash_table_remove(cache->results, result)) {
+        return TRUE;
+    }
+
+    /* not one of ours, the best we can do is free it like one */
+    g_free(result);
+    return FALSE;
+}
+
+guint resolvercache_getNumResults(ResolverCache* cache) {
+    MAGIC_ASSERT(cache);
+    return g_hash_table_size(cache->results);
+}
@@ -0,0 +1,42 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_RESOLVER_CACHE_H_
+#define SHD_RESOLVER_CACHE_H_
+
+#include "shadow.h"
+
+/**
+ * A least-recently-used cache of the getaddrinfo results of a host, keyed by
+ * the queried name, service, and the hint flags that affect the result.
+ * Every caller gets its own copy of the cached result, which it may modify
+ * like any getaddrinfo result and must return with resolvercache_freeResult.
+ * Results are not shared, so a plugin that writes to its result (e.g., to
+ * set the port) cannot change what the next caller resolves. The cache keeps
+ * track of the copies it handed out, so it recognizes results that are not
+ * its own. Lookups do not allocate anything but the copy.
+ */
+
+typedef struct _ResolverCache ResolverCache;
+
+ResolverCache* resolvercache_new(guint capacity);
+void resolvercache_free(ResolverCache* cache);
+
+/* returns a copy of the cached result, or NULL if it is not cached */
+struct addrinfo* resolvercache_lookup(ResolverCache* cache, const gchar* name,
+        const gchar* service, gint flags);
+/* caches the resolved address and port (both in network order), returning
+ * a copy of the result */
+struct addrinfo* resolvercache_insert(ResolverCache* cache, const gchar* name,
+        const gchar* service, gint flags, in_addr_t ip, in_port_t port);
+
+/* frees a result returned by the cache and returns TRUE. anything else is
+ * freed with g_free, and FALSE is returned. */
+gboolean resolvercache_freeResult(ResolverCache* cache, struct addrinfo* result);
+/* the number of results that were handed out and not freed yet */
+guint resolvercache_getNumResults(ResolverCache* cache);
+
+#endif /* SHD_RESOLVER_CACHE_H_ */
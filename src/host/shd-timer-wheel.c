@@ -0,0 +1,387 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#include "shadow.h"
+
+/* every level has 64 slots, and one slot spans all of the slots of the level
+ * below it. lowest level slots span 2^20 ns (about 1 ms), and eight levels
+ * cover the full range of simulation time. */
+#define TIMERWHEEL_LEVELS 8
+#define TIMERWHEEL_SLOT_BITS 6
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_SLOT_BITS)
+#define TIMERWHEEL_BASE_SHIFT 20
+
+/* the level of timers that are waiting in the expired list */
+#define TIMERWHEEL_EXPIRED TIMERWHEEL_LEVELS
+
+#define _SHIFT(level) (TIMERWHEEL_BASE_SHIFT + ((level) * TIMERWHEEL_SLOT_BITS))
+#define _SLOTNUMBER(time, level) ((guint64)(time) >> _SHIFT(level))
+#define _SLOTINDEX(number) ((guint)((number) & (TIMERWHEEL_SLOTS - 1)))
+
+struct _WheelTimer {
+    TimerWheel* wheel;
+
+    CallbackFunc callback;
+    gpointer data;
+    gpointer callbackArgument;
+
+    SimulationTime expireTime;
+    /* orders timers that expire at the same time by when they were armed */
+    guint64 armOrder;
+
+    /* the slot or expired list we are linked into, NULL if we are not armed */
+    WheelTimer** list;
+    WheelTimer* prev;
+    WheelTimer* next;
+    guint level;
+    guint index;
+
+    /* we were freed while our callback was running */
+    gboolean isFreed;
+
+    MAGIC_DECLARE;
+};
+
+struct _TimerWheel {
+    WheelTimer* slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS];
+    /* one bit for every slot that holds timers */
+    guint64 occupied[TIMERWHEEL_LEVELS];
+
+    /* timers whose callbacks are about to run, earliest first */
+    WheelTimer* expired;
+    WheelTimer* running;
+    gboolean isRunning;
+
+    /* the time the wheel was last run. higher level timers are never stored in
+     * the slot containing this time, they are cascaded down when we reach it. */
+    SimulationTime now;
+    guint64 armCounter;
+
+    /* times of the run events we have in the host event queue, earliest first */
+    GArray* scheduledRunTimes;
+
+    MAGIC_DECLARE;
+};
+
+TimerWheel* timerwheel_new() {
+    TimerWheel* wheel = g_new0(TimerWheel, 1);
+    MAGIC_INIT(wheel);
+
+    wheel->scheduledRunTimes = g_array_new(FALSE, FALSE, sizeof(SimulationTime));
+
+    return wheel;
+}
+
+static void _timerwheel_link(TimerWheel* wheel, WheelTimer** list, WheelTimer* timer) {
+    timer->list = list;
+    timer->prev = NULL;
+    timer->next = *list;
+    if(timer->next) {
+        timer->next->prev = timer;
+    }
+    *list = timer;
+}
+
+static void _timerwheel_unlink(TimerWheel* wheel, WheelTimer* timer) {
+    utility_assert(timer->list);
+
+    if(timer->prev) {
+        timer->prev->next = timer->next;
+    } else {
+        *(timer->list) = timer->next;
+    }
+    if(timer->next) {
+        timer->next->prev = timer->prev;
+    }
+
+    if(timer->level != TIMERWHEEL_EXPIRED && *(timer->list) == NULL) {
+        wheel->occupied[timer->level] &= ~(G_GUINT64_CONSTANT(1) << timer->index);
+    }
+
+    timer->list = NULL;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+static void _timerwheel_insert(TimerWheel* wheel, WheelTimer* timer) {
+    /* use the lowest level that has a slot for the expire time */
+    guint level = 0;
+    if(timer->expireTime > wheel->now) {
+        while(level < TIMERWHEEL_LEVELS - 1 &&
+                _SLOTNUMBER(timer->expireTime, level) - _SLOTNUMBER(wheel->now, level) >= TIMERWHEEL_SLOTS) {
+            level++;
+        }
+    }
+
+    timer->level = level;
+    timer->index = _SLOTINDEX(_SLOTNUMBER(timer->expireTime, level));
+    _timerwheel_link(wheel, &(wheel->slots[level][timer->index]), timer);
+    wheel->occupied[level] |= G_GUINT64_CONSTANT(1) << timer->index;
+}
+
+static void _timerwheel_addExpired(TimerWheel* wheel, WheelTimer* timer) {
+    timer->level = TIMERWHEEL_EXPIRED;
+    timer->index = 0;
+
+    /* keep the list ordered so callbacks run in the order the timers expire */
+    WheelTimer* before = NULL;
+    WheelTimer* after = wheel->expired;
+    while(after && (after->expireTime < timer->expireTime ||
+            (after->expireTime == timer->expireTime && after->armOrder < timer->armOrder))) {
+        before = after;
+        after = after->next;
+    }
+
+    if(before) {
+        timer->list = &(wheel->expired);
+        timer->prev = before;
+        timer->next = after;
+        before->next = timer;
+        if(after) {
+            after->prev = timer;
+        }
+    } else {
+        _timerwheel_link(wheel, &(wheel->expired), timer);
+    }
+}
+
+static void _timerwheel_collectExpired(TimerWheel* wheel, SimulationTime lastRunTime) {
+    /* lowest level slots between the last run and now may hold expired timers */
+    guint64 first = _SLOTNUMBER(lastRunTime, 0);
+    guint64 count = MIN(_SLOTNUMBER(wheel->now, 0) - first + 1, (guint64)TIMERWHEEL_SLOTS);
+
+    for(guint64 i = 0; i < count; i++) {
+        WheelTimer* timer = wheel->slots[0][_SLOTINDEX(first + i)];
+        while(timer) {
+            WheelTimer* next = timer->next;
+            if(timer->expireTime <= wheel->now) {
+                _timerwheel_unlink(wheel, timer);
+                _timerwheel_addExpired(wheel, timer);
+            }
+            timer = next;
+        }
+    }
+}
+
+static void _timerwheel_advance(TimerWheel* wheel, SimulationTime now) {
+    utility_assert(now >= wheel->now);
+    SimulationTime lastRunTime = wheel->now;
+    wheel->now = now;
+
+    /* cascade the timers in every higher level slot we reached down to the
+     * lower levels, starting at the top so they can move down more than once */
+    for(gint level = TIMERWHEEL_LEVELS - 1; level > 0; level--) {
+        guint64 first = _SLOTNUMBER(lastRunTime, level);
+        guint64 count = MIN(_SLOTNUMBER(now, level) - first, (guint64)TIMERWHEEL_SLOTS);
+
+        for(guint64 i = 1; i <= count; i++) {
+            guint index = _SLOTINDEX(first + i);
+            WheelTimer* timer = wheel->slots[level][index];
+            wheel->slots[level][index] = NULL;
+            wheel->occupied[level] &= ~(G_GUINT64_CONSTANT(1) << index);
+
+            while(timer) {
+                WheelTimer* next = timer->next;
+                timer->list = NULL;
+                timer->prev = NULL;
+                timer->next = NULL;
+                _timerwheel_insert(wheel, timer);
+                timer = next;
+            }
+        }
+    }
+
+    _timerwheel_collectExpired(wheel, lastRunTime);
+}
+
+static SimulationTime _timerwheel_getNextRunTime(TimerWheel* wheel) {
+    SimulationTime nextRunTime = SIMTIME_INVALID;
+
+    for(guint level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        guint64 occupied = wheel->occupied[level];
+        if(!occupied) {
+            continue;
+        }
+
+        /* rotate the slot containing the last run time to the first bit,
+         * the first occupied slot after that is the earliest for this level */
+        guint64 nowNumber = _SLOTNUMBER(wheel->now, level);
+        guint shift = _SLOTINDEX(nowNumber);
+        if(shift > 0) {
+            occupied = (occupied >> shift) | (occupied << (TIMERWHEEL_SLOTS - shift));
+        }
+        guint64 number = nowNumber + (guint64)__builtin_ctzll(occupied);
+
+        if(level == 0) {
+            /* lowest level timers run at their exact expire time */
+            for(WheelTimer* timer = wheel->slots[0][_SLOTINDEX(number)]; timer; timer = timer->next) {
+                nextRunTime = MIN(nextRunTime, timer->expireTime);
+            }
+        } else {
+            /* higher level timers get cascaded when we reach their slot */
+            nextRunTime = MIN(nextRunTime, (SimulationTime)(number << _SHIFT(level)));
+        }
+    }
+
+    return nextRunTime;
+}
+
+static void _timerwheel_run(TimerWheel* wheel, gpointer argument);
+
+static void _timerwheel_scheduleRun(TimerWheel* wheel, SimulationTime runTime) {
+    /* we check for the next run time when the current run finishes */
+    if(wheel->isRunning || runTime == SIMTIME_INVALID) {
+        return;
+    }
+
+    SimulationTime now = worker_getCurrentTime();
+    runTime = MAX(runTime, now);
+
+    /* an earlier run will schedule the following one */
+    if(wheel->scheduledRunTimes->len > 0 &&
+            g_array_index(wheel->scheduledRunTimes, SimulationTime, 0) <= runTime) {
+        return;
+    }
+
+    CallbackEvent* event = callback_new((CallbackFunc)_timerwheel_run, wheel, NULL);
+    worker_scheduleEvent((Event*)event, runTime - now, 0);
+    g_array_prepend_val(wheel->scheduledRunTimes, runTime);
+}
+
+static void _wheeltimer_free(WheelTimer* timer) {
+    MAGIC_CLEAR(timer);
+    g_free(timer);
+}
+
+static void _timerwheel_run(TimerWheel* wheel, gpointer argument) {
+    MAGIC_ASSERT(wheel);
+
+    SimulationTime now = worker_getCurrentTime();
+
+    /* run events fire in order, so this is always our earliest one */
+    utility_assert(wheel->scheduledRunTimes->len > 0);
+    g_array_remove_index(wheel->scheduledRunTimes, 0);
+
+    wheel->isRunning = TRUE;
+    _timerwheel_advance(wheel, now);
+
+    while(wheel->expired) {
+        WheelTimer* timer = wheel->expired;
+        _timerwheel_unlink(wheel, timer);
+
+        wheel->running = timer;
+        timer->callback(timer->data, timer->callbackArgument);
+        wheel->running = NULL;
+
+        if(timer->isFreed) {
+            _wheeltimer_free(timer);
+        }
+
+        /* callbacks may have armed timers that expire right now */
+        if(!wheel->expired) {
+            _timerwheel_collectExpired(wheel, now);
+        }
+    }
+
+    wheel->isRunning = FALSE;
+    _timerwheel_scheduleRun(wheel, _timerwheel_getNextRunTime(wheel));
+}
+
+static void _timerwheel_detachList(WheelTimer* timer) {
+    while(timer) {
+        WheelTimer* next = timer->next;
+        timer->wheel = NULL;
+        timer->list = NULL;
+        timer->prev = NULL;
+        timer->next = NULL;
+        timer = next;
+    }
+}
+
+void timerwheel_free(TimerWheel* wheel) {
+    MAGIC_ASSERT(wheel);
+
+    /* the owners of the remaining timers still free them later */
+    for(guint level = 0; level < TIMERWHEEL_LEVELS; level++) {
+        for(guint index = 0; index < TIMERWHEEL_SLOTS; index++) {
+            _timerwheel_detachList(wheel->slots[level][index]);
+        }
+    }
+    _timerwheel_detachList(wheel->expired);
+
+    g_array_free(wheel->scheduledRunTimes, TRUE);
+
+    MAGIC_CLEAR(wheel);
+    g_free(wheel);
+}
+
+WheelTimer* wheeltimer_new(TimerWheel* wheel, CallbackFunc callback, gpointer data, gpointer callbackArgument) {
+    MAGIC_ASSERT(wheel);
+    utility_assert(callback);
+
+    WheelTimer* timer = g_new0(WheelTimer, 1);
+    MAGIC_INIT(timer);
+
+    timer->wheel = wheel;
+    timer->callback = callback;
+    timer->data = data;
+    timer->callbackArgument = callbackArgument;
+
+    return timer;
+}
+
+void wheeltimer_free(WheelTimer* timer) {
+    MAGIC_ASSERT(timer);
+
+    if(timer->list) {
+        _timerwheel_unlink(timer->wheel, timer);
+    }
+
+    /* the wheel still needs us until our callback returns */
+    if(timer->wheel && timer->wheel->running == timer) {
+        timer->isFreed = TRUE;
+    } else {
+        _wheeltimer_free(timer);
+    }
+}
+
+void wheeltimer_arm(WheelTimer* timer, SimulationTime expireTime) {
+    MAGIC_ASSERT(timer);
+    TimerWheel* wheel = timer->wheel;
+    MAGIC_ASSERT(wheel);
+
+    if(timer->list) {
+        _timerwheel_unlink(wheel, timer);
+    }
+
+    timer->expireTime = MAX(expireTime, worker_getCurrentTime());
+    timer->armOrder = wheel->armCounter++;
+    _timerwheel_insert(wheel, timer);
+
+    /* we only need a new run event if this timer is now the earliest */
+    SimulationTime runTime = timer->expireTime;
+    if(timer->level > 0) {
+        runTime = (SimulationTime)(_SLOTNUMBER(timer->expireTime, timer->level) << _SHIFT(timer->level));
+    }
+    _timerwheel_scheduleRun(wheel, runTime);
+}
+
+void wheeltimer_cancel(WheelTimer* timer) {
+    MAGIC_ASSERT(timer);
+    if(timer->list) {
+        _timerwheel_unlink(timer->wheel, timer);
+    }
+}
+
+gboolean wheeltimer_isArmed(WheelTimer* timer) {
+    MAGIC_ASSERT(timer);
+    return timer->list != NULL ? TRUE : FALSE;
+}
+
+SimulationTime wheeltimer_getExpireTime(WheelTimer* timer) {
+    MAGIC_ASSERT(timer);
+    return timer->list != NULL ? timer->expireTime : 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_TIMER_WHEEL_H_
+#define SHD_TIMER_WHEEL_H_
+
+#include "shadow.h"
+
+/**
+ * A hierarchical timing wheel holding all of the timers of a host. Arming,
+ * re-arming, and canceling a timer are O(1) and never touch the host event
+ * queue; the wheel keeps a single callback event scheduled for the earliest
+ * slot that holds a timer, so timers that are reset or canceled before they
+ * expire never produce an event.
+ *
+ * Timers must be armed while running in the context of the host that owns
+ * the wheel. Expired timers are disarmed before their callback is run, and
+ * may be re-armed or freed from inside the callback.
+ */
+
+typedef struct _TimerWheel TimerWheel;
+typedef struct _WheelTimer WheelTimer;
+
+TimerWheel* timerwheel_new();
+void timerwheel_free(TimerWheel* wheel);
+
+WheelTimer* wheeltimer_new(TimerWheel* wheel, CallbackFunc callback, gpointer data, gpointer callbackArgument);
+void wheeltimer_free(WheelTimer* timer);
+
+/* (re)arms the timer to expire at the given absolute time */
+void wheeltimer_arm(WheelTimer* timer, SimulationTime expireTime);
+void wheeltimer_cancel(WheelTimer* timer);
+gboolean wheeltimer_isArmed(WheelTimer* timer);
+SimulationTime wheeltimer_getExpireTime(WheelTimer* timer);
+
+#endif /* SHD_TIMER_WHEEL_H_ */
@@ -12,6 +12,7 @@ enum _TrackerFlags {
     TRACKER_FLAGS_NODE = 1<<0,
     TRACKER_FLAGS_SOCKET = 1<<1,
     TRACKER_FLAGS_RAM = 1<<2,
+    TRACKER_FLAGS_RESOLVER = 1<<3,
 };
 
 /* a packet is a 'data' packet if it has a payload attached, and a 'control' packet otherwise.
@@ -54,6 +55,7 @@ struct _Tracker {
     gboolean didLogNodeHeader;
     gboolean didLogRAMHeader;
     gboolean didLogSocketHeader;
+    gboolean didLogResolverHeader;
 
     SimulationTime processingTimeTotal;
     SimulationTime processingTimeLastInterval;
@@ -66,12 +68,17 @@ struct _Tracker {
     IFaceCounters local;
     IFaceCounters remote;
 
-    GHashTable* allocatedLocations;
     gsize allocatedBytesTotal;
+    guint numAllocatedPointers;
     gsize allocatedBytesLastInterval;
     gsize deallocatedBytesLastInterval;
     guint numFailedFrees;
 
+    gsize resolverHitsTotal;
+    gsize resolverMissesTotal;
+    gsize resolverHitsLastInterval;
+    gsize resolverMissesLastInterval;
+
     GHashTable* socketStats;
 
     SimulationTime lastHeartbeat;
@@ -135,8 +142,10 @@ static TrackerFlags _tracker_parseFlagString(gchar* flagString) {
                 flags |= TRACKER_FLAGS_SOCKET;
             } else if(!g_ascii_strcasecmp(parts[idx], "ram")) {
                 flags |= TRACKER_FLAGS_RAM;
+            } else if(!g_ascii_strcasecmp(parts[idx], "resolver")) {
+                flags |= TRACKER_FLAGS_RESOLVER;
             } else {
-                warning("Did not recognize log info '%s', possible choices are 'node','socket','ram'.", parts[idx]);
+                warning("Did not recognize log info '%s', possible choices are 'node','socket','ram','resolver'.", parts[idx]);
             }
         }
         g_strfreev(parts);
@@ -186,23 +195,14 @@ Tracker* tracker_new(SimulationTime interval, GLogLevelFlags loglevel, gchar* fl
     tracker->privateFlags = _tracker_parseFlagString(flagString);
     tracker->globalFlags = _tracker_parseGlobalFlags();
 
-    tracker->allocatedLocations = g_hash_table_new(g_direct_hash, g_direct_equal);
     tracker->socketStats = g_hash_table_new_full(g_int_hash, g_int_equal, NULL, (GDestroyNotify)_socketstats_free);
 
     return tracker;
 }
 
-static void _tracker_freeAllocatedLocations(gpointer key, gpointer value, gpointer userData) {
-    if(key) {
-        g_free(key);
-    }
-}
-
 void tracker_free(Tracker* tracker) {
     MAGIC_ASSERT(tracker);
 
-    g_hash_table_foreach(tracker->allocatedLocations, _tracker_freeAllocatedLocations, NULL);
-    g_hash_table_destroy(tracker->allocatedLocations);
     g_hash_table_destroy(tracker->socketStats);
 
     MAGIC_CLEAR(tracker);
@@ -328,30 +328,44 @@ void tracker_addOutputBytes(Tracker* tracker, Packet* packet, gint handle) {
     }
 }
 
-void tracker_addAllocatedBytes(Tracker* tracker, gpointer location, gsize allocatedBytes) {
+void tracker_addAllocatedBytes(Tracker* tracker, gsize allocatedBytes) {
     MAGIC_ASSERT(tracker);
 
     if(_tracker_getFlags(tracker) & TRACKER_FLAGS_RAM) {
         tracker->allocatedBytesTotal += allocatedBytes;
         tracker->allocatedBytesLastInterval += allocatedBytes;
-        g_hash_table_insert(tracker->allocatedLocations, location, GSIZE_TO_POINTER(allocatedBytes));
+        (tracker->numAllocatedPointers)++;
     }
 }
 
-void tracker_removeAllocatedBytes(Tracker* tracker, gpointer location) {
+void tracker_removeAllocatedBytes(Tracker* tracker, gsize deallocatedBytes) {
     MAGIC_ASSERT(tracker);
 
     if(_tracker_getFlags(tracker) & TRACKER_FLAGS_RAM) {
-        gpointer value = NULL;
-        gboolean exists = g_hash_table_lookup_extended(tracker->allocatedLocations, location, NULL, &value);
-        if(exists) {
-            gboolean b = g_hash_table_remove(tracker->allocatedLocations, location);
-            utility_assert(b);
-            gsize allocatedBytes = GPOINTER_TO_SIZE(value);
-            tracker->allocatedBytesTotal -= allocatedBytes;
-            tracker->deallocatedBytesLastInterval += allocatedBytes;
+        tracker->allocatedBytesTotal -= deallocatedBytes;
+        tracker->deallocatedBytesLastInterval += deallocatedBytes;
+        (tracker->numAllocatedPointers)--;
+    }
+}
+
+void tracker_addFailedFree(Tracker* tracker) {
+    MAGIC_ASSERT(tracker);
+
+    if(_tracker_getFlags(tracker) & TRACKER_FLAGS_RAM) {
+        (tracker->numFailedFrees)++;
+    }
+}
+
+void tracker_addResolverLookup(Tracker* tracker, gboolean wasCached) {
+    MAGIC_ASSERT(tracker);
+
+    if(_tracker_getFlags(tracker) & TRACKER_FLAGS_RESOLVER) {
+        if(wasCached) {
+            tracker->resolverHitsTotal++;
+            tracker->resolverHitsLastInterval++;
         } else {
-            (tracker->numFailedFrees)++;
+            tracker->resolverMissesTotal++;
+            tracker->resolverMissesLastInterval++;
         }
     }
 }
@@ -594,7 +608,6 @@ static void _tracker_logSocket(Tracker* tracker, GLogLevelFlags level, Simulatio
 
 static void _tracker_logRAM(Tracker* tracker, GLogLevelFlags level, SimulationTime interval) {
     guint seconds = (guint) (interval / SIMTIME_ONE_SECOND);
-    guint numptrs = g_hash_table_size(tracker->allocatedLocations);
 
     if(!tracker->didLogRAMHeader) {
         tracker->didLogRAMHeader = TRUE;
@@ -605,7 +618,22 @@ static void _tracker_logRAM(Tracker* tracker, GLogLevelFlags level, SimulationTi
     logging_log(G_LOG_DOMAIN, level, __FILE__, __FUNCTION__, __LINE__,
         "[shadow-heartbeat] [ram] %u,%"G_GSIZE_FORMAT",%"G_GSIZE_FORMAT",%"G_GSIZE_FORMAT",%u,%u",
         seconds, tracker->allocatedBytesLastInterval, tracker->deallocatedBytesLastInterval,
-        tracker->allocatedBytesTotal, numptrs, tracker->numFailedFrees);
+        tracker->allocatedBytesTotal, tracker->numAllocatedPointers, tracker->numFailedFrees);
+}
+
+static void _tracker_logResolver(Tracker* tracker, GLogLevelFlags level, SimulationTime interval) {
+    guint seconds = (guint) (interval / SIMTIME_ONE_SECOND);
+
+    if(!tracker->didLogResolverHeader) {
+        tracker->didLogResolverHeader = TRUE;
+        logging_log(G_LOG_DOMAIN, level, __FILE__, __FUNCTION__, __LINE__,
+                "[shadow-heartbeat] [resolver-header] interval-seconds,hit-count,miss-count,total-hit-count,total-miss-count");
+    }
+
+    logging_log(G_LOG_DOMAIN, level, __FILE__, __FUNCTION__, __LINE__,
+        "[shadow-heartbeat] [resolver] %u,%"G_GSIZE_FORMAT",%"G_GSIZE_FORMAT",%"G_GSIZE_FORMAT",%"G_GSIZE_FORMAT,
+        seconds, tracker->resolverHitsLastInterval, tracker->resolverMissesLastInterval,
+        tracker->resolverHitsTotal, tracker->resolverMissesTotal);
 }
 
 void tracker_heartbeat(Tracker* tracker) {
@@ -630,6 +658,11 @@ void tracker_heartbeat(Tracker* tracker) {
         _tracker_logRAM(tracker, level, interval);
     }
 
+    /* check to see if name resolution info is being logged */
+    if(flags & TRACKER_FLAGS_RESOLVER) {
+        _tracker_logResolver(tracker, level, interval);
+    }
+
     /* make sure we have the latest global configured flags */
     tracker->globalFlags = _tracker_parseGlobalFlags();
 
@@ -639,6 +672,8 @@ void tracker_heartbeat(Tracker* tracker) {
     tracker->numDelayedLastInterval = 0;
     tracker->allocatedBytesLastInterval = 0;
     tracker->deallocatedBytesLastInterval = 0;
+    tracker->resolverHitsLastInterval = 0;
+    tracker->resolverMissesLastInterval = 0;
 
     /* clear the counters */
     memset(&tracker->local, 0, sizeof(IFaceCounters));
@@ -39,6 +39,8 @@
 #include "llvm/IR/BasicBlock.h"
 #endif
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #if ((__clang_major__ < 3) || (__clang_major__ == 3 && __clang_minor__ < 5))
 #include "llvm/Support/CallSite.h"
@@ -57,12 +59,114 @@
 //#endif
 
 #include <string>
+#include <vector>
 
 using namespace llvm;
 using std::string;
 
 #define HOIST_LOG_PREFIX "hoist-globals: "
 
+// in pointer mode, every access to a global loads __hoisted_globals_pointer
+// first, so shadow can switch plugin state by storing a single pointer
+// instead of copying the whole struct in and out
+static cl::opt<bool> HoistPointerMode("hoist-globals-pointer",
+        cl::desc("Access hoisted globals through __hoisted_globals_pointer"),
+        cl::init(false));
+
+static void collectUsers(Value* V, SmallVectorImpl<User*>& Users) {
+#if ((__clang_major__ > 3) || (__clang_major__ == 3 && __clang_minor__ >= 5))
+    for (Value::user_iterator i = V->user_begin(), e = V->user_end(); i != e; ++i)
+        Users.push_back(*i);
+#else
+    for (Value::use_iterator i = V->use_begin(), e = V->use_end(); i != e; ++i)
+        Users.push_back(*i);
+#endif
+}
+
+// instructions that use V, in front of which we can insert new instructions.
+// a phi needs the new instruction at the end of the incoming block instead.
+static void forEachInstructionUse(Value* V, Instruction* I, std::vector<std::pair<Instruction*, unsigned> >& Uses) {
+    for (unsigned op = 0; op < I->getNumOperands(); op++) {
+        if (I->getOperand(op) != V)
+            continue;
+        if (PHINode* PN = dyn_cast<PHINode>(I)) {
+            Uses.push_back(std::make_pair(PN->getIncomingBlock(op)->getTerminator(), op));
+        } else {
+            Uses.push_back(std::make_pair(I, op));
+        }
+    }
+}
+
+// rewrite constant expressions that use C and are used by instructions into
+// instructions, so that every instruction uses C directly. constants that are
+// only used by other constants (e.g. global initializers) are left alone.
+static void expandConstantExprUsers(Constant* C) {
+    SmallVector<User*, 16> Users;
+    collectUsers(C, Users);
+
+    // a user shows up once per use, but we may destroy it on the first visit
+    SmallPtrSet<ConstantExpr*, 16> Expanded;
+    for (User** u = Users.begin(), **e = Users.end(); u != e; ++u) {
+        ConstantExpr* CE = dyn_cast<ConstantExpr>(*u);
+        if (!CE || Expanded.count(CE))
+            continue;
+        Expanded.insert(CE);
+
+        expandConstantExprUsers(CE);
+
+        SmallVector<User*, 16> CEUsers;
+        collectUsers(CE, CEUsers);
+        for (User** cu = CEUsers.begin(), **ce = CEUsers.end(); cu != ce; ++cu) {
+            Instruction* I = dyn_cast<Instruction>(*cu);
+            if (!I)
+                continue;
+
+            std::vector<std::pair<Instruction*, unsigned> > Uses;
+            forEachInstructionUse(CE, I, Uses);
+            for (unsigned j = 0; j < Uses.size(); j++) {
+                Instruction* NewI = CE->getAsInstruction();
+                NewI->insertBefore(Uses[j].first);
+                I->setOperand(Uses[j].second, NewI);
+            }
+        }
+
+        CE->removeDeadConstantUsers();
+        if (CE->use_empty())
+            CE->destroyConstant();
+    }
+}
+
+// true if the constant is computed from the address of G
+static bool referencesGlobal(Constant* C, GlobalValue* G) {
+    if (C == G)
+        return true;
+    if (isa<GlobalValue>(C))
+        return false;
+    for (unsigned i = 0; i < C->getNumOperands(); i++) {
+        if (Constant* Op = dyn_cast<Constant>(C->getOperand(i)))
+            if (referencesGlobal(Op, G))
+                return true;
+    }
+    return false;
+}
+
+// collect the offsets of pointer-sized values in the initializer that point
+// into G, so they can be relocated when a copy of G is placed elsewhere
+static void collectRelocations(DataLayout* DL, Constant* C, uint64_t Offset, GlobalValue* G, SmallVectorImpl<uint64_t>& Relocations) {
+    if (ConstantStruct* CS = dyn_cast<ConstantStruct>(C)) {
+        const StructLayout* SL = DL->getStructLayout(CS->getType());
+        for (unsigned i = 0; i < CS->getNumOperands(); i++)
+            collectRelocations(DL, CS->getOperand(i), Offset + SL->getElementOffset(i), G, Relocations);
+    } else if (ConstantArray* CA = dyn_cast<ConstantArray>(C)) {
+        uint64_t ElementSize = DL->getTypeAllocSize(CA->getType()->getElementType());
+        for (unsigned i = 0; i < CA->getNumOperands(); i++)
+            collectRelocations(DL, CA->getOperand(i), Offset + i * ElementSize, G, Relocations);
+    } else if (isa<ConstantExpr>(C) && DL->getTypeAllocSize(C->getType()) == DL->getPointerSize() &&
+            referencesGlobal(C, G)) {
+        Relocations.push_back(Offset);
+    }
+}
+
 static std::vector<Function*> parseGlobalCtors(GlobalVariable *GV) {
 	if (GV->getInitializer()->isNullValue())
 		return std::vector<Function *>();
@@ -241,6 +345,22 @@ public:
 				GlobalValue::ExternalLinkage, HoistedStructSize,
 				"__hoisted_globals_size", 0, GlobalVariable::NotThreadLocal, 0);
 
+		// a pointer variable that is loaded and evaluated before accessing
+		// the hoisted globals struct in pointer mode
+
+		PointerType *HoistedPointerType = PointerType::get(HoistedStructType, 0);
+
+		GlobalVariable *HoistedPointer = new GlobalVariable(M,
+				HoistedPointerType, false, GlobalValue::ExternalLinkage,
+				HoistedStruct, "__hoisted_globals_pointer", 0,
+				GlobalVariable::NotThreadLocal, 0);
+
+		// tell shadow which access mode it should use when switching state
+		Constant *HoistedIndirectValue = ConstantInt::get(Int32Ty, HoistPointerMode ? 1 : 0, false);
+		new GlobalVariable(M, Int32Ty, true,
+				GlobalValue::ExternalLinkage, HoistedIndirectValue,
+				"__hoisted_globals_indirect", 0, GlobalVariable::NotThreadLocal, 0);
+
 #ifdef VERBOSE
 		errs() << HOIST_LOG_PREFIX << "Hoisting globals: ";
 #endif
@@ -262,6 +382,32 @@ public:
             Constant *GEP = ConstantExpr::getGetElementPtr(HoistedStruct, GEPIndexes, true);
 #endif
 
+			if(HoistPointerMode) {
+				// instructions compute the address from the current pointer
+				expandConstantExprUsers(GV);
+
+				SmallVector<User*, 16> Users;
+				collectUsers(GV, Users);
+				for (User** u = Users.begin(), **ue = Users.end(); u != ue; ++u) {
+					Instruction* I = dyn_cast<Instruction>(*u);
+					if (!I)
+						continue;
+
+					std::vector<std::pair<Instruction*, unsigned> > Uses;
+					forEachInstructionUse(GV, I, Uses);
+					for (unsigned j = 0; j < Uses.size(); j++) {
+						Instruction* InsertBefore = Uses[j].first;
+						LoadInst* Base = new LoadInst(HoistedPointer, "hoisted.base", InsertBefore);
+#if ((__clang_major__ > 3) || (__clang_major__ == 3 && __clang_minor__ > 6))
+						Instruction* Address = GetElementPtrInst::CreateInBounds(HoistedStructType, Base, GEPIndexes, GV->getName(), InsertBefore);
+#else
+						Instruction* Address = GetElementPtrInst::CreateInBounds(Base, GEPIndexes, GV->getName(), InsertBefore);
+#endif
+						I->setOperand(Uses[j].second, Address);
+					}
+				}
+			}
+
 			// we have to do this manually so we can preserve debug info
 //			GV->replaceAllUsesWith(GEP);
 			replaceAllUsesWithKeepDebugInfo(GV, GEP);
@@ -282,15 +428,24 @@ public:
 		errs() << "\n";
 #endif
 
-		// now create a new pointer variable that will be loaded and evaluated
-		// before accessing the hoisted globals struct
-
-		PointerType *HoistedPointerType = PointerType::get(HoistedStructType, 0);
+		// in pointer mode each process gets its own copy of the struct, so
+		// statically initialized pointers into the struct must be relocated
+		SmallVector<uint64_t, 16> Relocations;
+		if(HoistPointerMode) {
+			collectRelocations(DL, HoistedStruct->getInitializer(), 0, HoistedStruct, Relocations);
+		}
 
-		GlobalVariable *HoistedPointer = new GlobalVariable(M,
-				HoistedPointerType, false, GlobalValue::ExternalLinkage,
-				HoistedStruct, "__hoisted_globals_pointer", 0,
-				GlobalVariable::NotThreadLocal, 0);
+		SmallVector<Constant*, 16> RelocationOffsets;
+		for (unsigned i = 0; i < Relocations.size(); i++) {
+			RelocationOffsets.push_back(ConstantInt::get(Int32Ty, Relocations[i], false));
+		}
+		ArrayType *RelocationsType = ArrayType::get(Int32Ty, RelocationOffsets.size());
+		new GlobalVariable(M, RelocationsType, true,
+				GlobalValue::ExternalLinkage, ConstantArray::get(RelocationsType, RelocationOffsets),
+				"__hoisted_globals_relocations", 0, GlobalVariable::NotThreadLocal, 0);
+		new GlobalVariable(M, Int32Ty, true,
+				GlobalValue::ExternalLinkage, ConstantInt::get(Int32Ty, Relocations.size(), false),
+				"__hoisted_globals_relocations_size", 0, GlobalVariable::NotThreadLocal, 0);
 
 //      Constant *GEPIndexes[] = {ConstantInt::get(Int32Ty, 0), ConstantInt::get(Int32Ty, 0)};
 //      Constant *GEP = ConstantExpr::getGetElementPtr(HoistedPointer, GEPIndexes, true);
@@ -300,7 +455,8 @@ public:
 #ifndef NDEBUG
 		verifyModule(M);
 #endif
-        errs() << HOIST_LOG_PREFIX << "LLVM ModulePass is complete, hoisted " << Globals.size() << " variables\n";
+        errs() << HOIST_LOG_PREFIX << "LLVM ModulePass is complete, hoisted " << Globals.size() << " variables"
+                << (HoistPointerMode ? " behind __hoisted_globals_pointer" : "") << "\n";
 		return true;
 	}
 };
@@ -41,8 +41,13 @@
 #include <pthread.h>
 
 #include "shadow.h"
+#include "shd-plugin-api.h"
 
-#define SETSYM(funcptr, funcstr) {funcptr = dlsym(RTLD_NEXT, funcstr);}
+/* when loaded into a separate linker namespace, we look up the functions in
+ * the interposer of the main namespace instead of in the next library */
+static void* forwardHandle = NULL;
+
+#define SETSYM(funcptr, funcstr) {funcptr = dlsym(forwardHandle ? forwardHandle : RTLD_NEXT, funcstr);}
 
 #define SETSYM_OR_FAIL(funcptr, funcstr) { \
     dlerror(); \
@@ -91,6 +96,7 @@ typedef void* (*memalign_func)(size_t, size_t);
 typedef void* (*aligned_alloc_func)(size_t, size_t);
 typedef void* (*valloc_func)(size_t);
 typedef void* (*pvalloc_func)(size_t);
+typedef size_t (*malloc_usable_size_func)(void*);
 typedef void (*free_func)(void*);
 typedef void* (*mmap_func)(void *, size_t, int, int, int, off_t);
 
@@ -249,6 +255,10 @@ typedef int (*on_exit_func)(void (*function)(int , void *), void *arg);
 typedef int (*atexit_func)(void (*func)(void));
 typedef int (*__cxa_atexit_func)(void (*func) (void *), void * arg, void * dso_handle);
 
+/* shadow-specific functions */
+
+typedef ssize_t (*shadow_send_virtual_func)(int, size_t);
+
 /* pthread thread attribute */
 
 typedef int (*pthread_attr_init_func)(pthread_attr_t *);
@@ -386,6 +396,7 @@ typedef struct {
     aligned_alloc_func aligned_alloc;
     valloc_func valloc;
     pvalloc_func pvalloc;
+    malloc_usable_size_func malloc_usable_size;
     free_func free;
     mmap_func mmap;
 
@@ -525,6 +536,8 @@ typedef struct {
     atexit_func atexit;
     __cxa_atexit_func __cxa_atexit;
 
+    shadow_send_virtual_func shadow_send_virtual;
+
     pthread_attr_init_func pthread_attr_init;
     pthread_attr_destroy_func pthread_attr_destroy;
     pthread_attr_setinheritsched_func pthread_attr_setinheritsched;
@@ -652,6 +665,16 @@ static __thread unsigned long isRecursive = 0;
 /* provide a way to disable and enable interposition */
 static __thread unsigned long disableCount = 0;
 
+/* the process whose plugin or pth code is running on this thread, if any.
+ * shadow sets it whenever a process leaves or re-enters the shadow context,
+ * so deciding whether to emulate a call is a single thread-local read */
+static __thread Process* emulatedProcess = NULL;
+
+/* the clock of the worker running on this thread. the worker publishes its
+ * current time there, so plugins read the time like from a vdso page,
+ * without switching into shadow. it is SIMTIME_INVALID between events. */
+static __thread const SimulationTime* workerClock = NULL;
+
 /* we must use the & operator to get the current thread's version */
 void interposer_enable() {__sync_fetch_and_sub(&disableCount, 1);}
 void interposer_disable() {__sync_fetch_and_add(&disableCount, 1);}
@@ -684,6 +707,14 @@ void interposer_setShadowIsLoaded() {
     director.shadowIsLoaded = 1;
 }
 
+void interposer_setEmulatedProcess(Process* proc) {
+    *(&emulatedProcess) = proc;
+}
+
+void interposer_setWorkerClock(const SimulationTime* clock) {
+    *(&workerClock) = clock;
+}
+
 static void _interposer_globalInitializeHelper() {
     if(directorIsInitialized) {
         return;
@@ -714,6 +745,7 @@ static void _interposer_globalInitializeHelper() {
     SETSYM_OR_FAIL(director.next.memalign, "memalign");
     SETSYM_OR_FAIL(director.next.valloc, "valloc");
     SETSYM_OR_FAIL(director.next.pvalloc, "pvalloc");
+    SETSYM_OR_FAIL(director.next.malloc_usable_size, "malloc_usable_size");
     SETSYM_OR_FAIL(director.next.mmap, "mmap");
     SETSYM_OR_FAIL(director.next.epoll_create, "epoll_create");
     SETSYM_OR_FAIL(director.next.epoll_create1, "epoll_create1");
@@ -952,6 +984,18 @@ static void _interposer_globalInitialize() {
     __sync_fetch_and_sub(&isRecursive, 1);
 }
 
+/* shadow calls this in a copy of this library that it loaded first into a new
+ * linker namespace with dlmopen. shadow does not exist in that namespace, so
+ * the copy never emulates anything itself but sends every call to the
+ * interposer in the main namespace, which then decides as usual. errno is
+ * not forwarded: the namespace libc keeps its own, and shadow syncs it with
+ * ours whenever control passes between shadow and the plugin. */
+void interposer_forwardTo(void* handle) {
+    forwardHandle = handle;
+    directorIsInitialized = 0;
+    _interposer_globalInitialize();
+}
+
 /* this function is called when the library is loaded,
  * and only once per process not once per thread */
 void __attribute__((constructor)) construct() {
@@ -972,21 +1016,14 @@ static inline Process* _doEmulate() {
     if(!directorIsInitialized) {
         _interposer_globalInitialize();
     }
-    Process* proc = NULL;
-    /* recursive calls always go to libc */
-    if(!__sync_fetch_and_add(&isRecursive, 1)) {
-        proc = director.shadowIsLoaded && (*(&disableCount)) <= 0 && worker_isAlive() ? worker_getActiveProcess() : NULL;
-        /* check if the shadow intercept library is loaded yet, but dont fail if its not */
-        if(proc) {
-            /* ask shadow if this call is a plug-in that should be intercepted */
-            proc = process_shouldEmulate(proc) ? proc : NULL;
-        } else {
-            /* intercept library is not yet loaded, don't redirect */
-            proc = NULL;
-        }
+    /* the emulated process is only set while shadow runs plugin or pth code on
+     * this thread, and is cleared before shadow itself calls back into libc,
+     * so the check needs no atomics or calls into shadow. it is never set in
+     * an interposer copy that forwards to the main namespace. */
+    if((*(&disableCount)) > 0) {
+        return NULL;
     }
-    __sync_fetch_and_sub(&isRecursive, 1);
-    return proc;
+    return *(&emulatedProcess);
 }
 
 /****************************************************************************
@@ -1027,11 +1064,112 @@ void free(void *ptr) {
             return;
         }
 
+        /* plugin memory that shadow frees for a plugin, e.g. in a plugin
+         * callback, stays in the host arena until the host is freed */
+        if(ptr != NULL && director.shadowIsLoaded && arena_getOwner(ptr) != NULL) {
+            return;
+        }
+
         ENSURE(free);
         director.next.free(ptr);
     }
 }
 
+/* realloc and malloc_usable_size may also see plugin memory outside of the plugin */
+void* realloc(void *ptr, size_t size) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        return process_emu_realloc(proc, ptr, size);
+    } else {
+        if(ptr != NULL && director.shadowIsLoaded && arena_getOwner(ptr) != NULL) {
+            /* move it to the system allocator, the arena keeps the old chunk */
+            ENSURE(malloc);
+            void* newptr = director.next.malloc(size);
+            if(newptr != NULL) {
+                size_t oldSize = arena_getChunkSize(ptr);
+                memcpy(newptr, ptr, oldSize < size ? oldSize : size);
+            }
+            return newptr;
+        }
+
+        ENSURE(realloc);
+        return director.next.realloc(ptr, size);
+    }
+}
+
+size_t malloc_usable_size(void *ptr) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        return process_emu_malloc_usable_size(proc, ptr);
+    } else {
+        if(ptr != NULL && director.shadowIsLoaded && arena_getOwner(ptr) != NULL) {
+            return arena_getChunkSize(ptr);
+        }
+
+        ENSURE(malloc_usable_size);
+        return director.next.malloc_usable_size(ptr);
+    }
+}
+
+/* time is special because plugins read it from the published worker clock */
+
+static inline SimulationTime _interposer_getPublishedTime() {
+    const SimulationTime* clock = *(&workerClock);
+    return clock ? *clock : SIMTIME_INVALID;
+}
+
+time_t time(time_t *t) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        SimulationTime now = _interposer_getPublishedTime();
+        if(now == SIMTIME_INVALID) {
+            return process_emu_time(proc, t);
+        }
+        time_t secs = (time_t) (now / SIMTIME_ONE_SECOND);
+        if(t != NULL) {
+            *t = secs;
+        }
+        return secs;
+    } else {
+        ENSURE(time);
+        return director.next.time(t);
+    }
+}
+
+int clock_gettime(clockid_t clk_id, struct timespec *tp) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        SimulationTime now = _interposer_getPublishedTime();
+        if(now == SIMTIME_INVALID || tp == NULL) {
+            return process_emu_clock_gettime(proc, clk_id, tp);
+        }
+        tp->tv_sec = now / SIMTIME_ONE_SECOND;
+        tp->tv_nsec = now % SIMTIME_ONE_SECOND;
+        return 0;
+    } else {
+        ENSURE(clock_gettime);
+        return director.next.clock_gettime(clk_id, tp);
+    }
+}
+
+int gettimeofday(struct timeval* tv, struct timezone* tz) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        SimulationTime now = _interposer_getPublishedTime();
+        if(now == SIMTIME_INVALID) {
+            return process_emu_gettimeofday(proc, tv, tz);
+        }
+        if(tv) {
+            tv->tv_sec = (time_t) (now / SIMTIME_ONE_SECOND);
+            tv->tv_usec = (suseconds_t) ((now % SIMTIME_ONE_SECOND) / SIMTIME_ONE_MICROSECOND);
+        }
+        return 0;
+    } else {
+        ENSURE(gettimeofday);
+        return director.next.gettimeofday(tv, tz);
+    }
+}
+
 /* use variable args */
 
 int fcntl(int fd, int cmd, ...) {
@@ -1142,7 +1280,6 @@ int fprintf(FILE *stream, const char *format, ...) {
 /* memory allocation family */
 
 INTERPOSE(void* malloc(size_t a), malloc, a);
-INTERPOSE(void* realloc(void* a, size_t b), realloc, a, b);
 INTERPOSE(int posix_memalign(void** a, size_t b, size_t c), posix_memalign, a, b, c);
 INTERPOSE(void* memalign(size_t a, size_t b), memalign, a, b);
 INTERPOSE(void* aligned_alloc(size_t a, size_t b), aligned_alloc, a, b);
@@ -1263,9 +1400,6 @@ INTERPOSE(int fflush(FILE *a), fflush, a);
 
 /* time family */
 
-INTERPOSE(time_t time(time_t *a), time, a);
-INTERPOSE(int clock_gettime(clockid_t a, struct timespec *b), clock_gettime, a, b);
-INTERPOSE(int gettimeofday(struct timeval* a, struct timezone* b), gettimeofday, a, b);
 INTERPOSE(struct tm *localtime(const time_t *a), localtime, a);
 INTERPOSE(struct tm *localtime_r(const time_t *a, struct tm *b), localtime_r, a, b);
 
@@ -1439,3 +1573,19 @@ INTERPOSE(int pthread_cond_broadcast(pthread_cond_t *a), pthread_cond_broadcast,
 INTERPOSE(int pthread_cond_signal(pthread_cond_t *a), pthread_cond_signal, a);
 INTERPOSE(int pthread_cond_wait(pthread_cond_t *a, pthread_mutex_t *b), pthread_cond_wait, a, b);
 INTERPOSE(int pthread_cond_timedwait(pthread_cond_t *a, pthread_mutex_t *b, const struct timespec *c), pthread_cond_timedwait, a, b, c);
+
+/* shadow-specific functions that plug-ins may declare and call directly */
+
+/* declared for plug-ins in shd-plugin-api.h */
+ssize_t shadow_send_virtual(int fd, size_t n) {
+    Process* proc = NULL;
+    if((proc = _doEmulate()) != NULL) {
+        return process_emu_shadow_send_virtual(proc, fd, n);
+    } else if(forwardHandle) {
+        ENSURE(shadow_send_virtual);
+        return director.next.shadow_send_virtual(fd, n);
+    } else {
+        errno = ENOSYS;
+        return -1;
+    }
+}
@@ -0,0 +1,24 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_PLUGIN_API_H_
+#define SHD_PLUGIN_API_H_
+
+#include <sys/types.h>
+
+/*
+ * Functions that shadow provides to plug-ins in addition to the libc calls it
+ * intercepts. They are declared weak so that a plug-in also links and runs
+ * outside of shadow, where they resolve to NULL; check the symbol before use.
+ */
+
+/* send n bytes of generated filler on a socket without handing over a buffer.
+ * the bytes only exist if the receiver reads them. the socket behaves as if it
+ * were non-blocking: returns the number of bytes accepted, or -1 with errno
+ * set to EAGAIN when the send buffer is full. fails with ENOSYS when the
+ * plug-in is not running in shadow. */
+extern ssize_t shadow_send_virtual(int fd, size_t n) __attribute__((weak));
+
+#endif /* SHD_PLUGIN_API_H_ */
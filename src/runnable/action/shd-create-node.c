@@ -202,25 +202,51 @@ void createnodes_run(CreateNodesAction* action) {
 
     const gchar* dataDirPath = worker_getHostsRootPath();
 
-    for(gint i = 0; i < action->quantity; i++) {
+    /* generate all of the names first so we can register their addresses in one batch */
+    guint quantity = (guint) action->quantity;
+    GQuark* ids = g_new0(GQuark, quantity);
+    gchar** names = g_new0(gchar*, quantity);
+
+    for(guint i = 0; i < quantity; i++) {
         /* hostname */
         GString* hostnameBuffer = g_string_new(hostname);
-        if(action->quantity > 1) {
+        if(quantity > 1) {
             gchar prefix[20];
             g_snprintf(prefix, 20, "%u", ++hostnameCounter);
             hostnameBuffer = g_string_append(hostnameBuffer, (const char*) prefix);
         }
-        GQuark id = g_quark_from_string((const gchar*) hostnameBuffer->str);
+        ids[i] = g_quark_from_string((const gchar*) hostnameBuffer->str);
+        names[i] = g_string_free(hostnameBuffer, FALSE);
+    }
+
+    Address** addresses = dns_registerBatch(worker_getDNS(), ids, names, quantity,
+            action->requestedIP ? action->requestedIP->str : NULL);
+
+    for(guint i = 0; i < quantity; i++) {
+        GQuark id = ids[i];
 
         /* the node is part of the internet */
         guint nodeSeed = (guint) worker_nextRandomInt();
+        Random* random = random_new(nodeSeed);
 
-        Host* host = host_new(id, hostnameBuffer->str,
+        /* connect to topology and get the default bandwidth */
+        guint64 bwDownKiBps = 0, bwUpKiBps = 0;
+        topology_attach(worker_getTopology(), addresses[i], random,
                 action->requestedIP ? action->requestedIP->str : NULL,
                 action->requestedGeocode ? action->requestedGeocode->str : NULL,
                 action->requestedType ? action->requestedType->str : NULL,
-                action->bandwidthdown, action->bandwidthup,
-                cpuFrequency, cpuThreshold, cpuPrecision, nodeSeed,
+                &bwDownKiBps, &bwUpKiBps);
+
+        /* prefer assigned bandwidth if available */
+        if(action->bandwidthdown) {
+            bwDownKiBps = action->bandwidthdown;
+        }
+        if(action->bandwidthup) {
+            bwUpKiBps = action->bandwidthup;
+        }
+
+        Host* host = host_new(id, names[i], addresses[i], random, bwDownKiBps, bwUpKiBps,
+                cpuFrequency, cpuThreshold, cpuPrecision,
                 heartbeatInterval, heartbeatLogLevel, heartbeatLogInfo,
                 logLevel, logPcap, pcapDir, qdisc,
                 receiveBufferSize, autotuneReceiveBuffer, sendBufferSize, autotuneSendBuffer,
@@ -229,7 +255,7 @@ void createnodes_run(CreateNodesAction* action) {
         /* save the node somewhere */
         worker_addHost(host, (guint) id);
 
-        g_string_free(hostnameBuffer, TRUE);
+        g_free(names[i]);
 
         /* loop through and create, add, and boot all applications */
         GList* item = action->applications;
@@ -251,6 +277,10 @@ void createnodes_run(CreateNodesAction* action) {
         worker_scheduleEvent((Event*)heartbeat, heartbeatInterval, id);
         worker_setCurrentTime(SIMTIME_INVALID);
     }
+
+    g_free(addresses);
+    g_free(names);
+    g_free(ids);
 }
 
 void createnodes_free(CreateNodesAction* action) {
@@ -11,6 +11,7 @@ struct _LoadPluginAction {
     Action super;
     GString* name;
     GString* path;
+    guint stackSize;
     MAGIC_DECLARE;
 };
 
@@ -20,7 +21,7 @@ RunnableFunctionTable loadplugin_functions = {
     MAGIC_VALUE
 };
 
-LoadPluginAction* loadplugin_new(GString* name, GString* path) {
+LoadPluginAction* loadplugin_new(GString* name, GString* path, guint stackSize) {
     utility_assert(name && path);
     LoadPluginAction* action = g_new0(LoadPluginAction, 1);
     MAGIC_INIT(action);
@@ -29,6 +30,7 @@ LoadPluginAction* loadplugin_new(GString* name, GString* path) {
 
     action->name = g_string_new(name->str);
     action->path = g_string_new(path->str);
+    action->stackSize = stackSize;
 
     return action;
 }
@@ -42,7 +44,7 @@ void loadplugin_run(LoadPluginAction* action) {
      * event will be run by a worker. For now, we just track the default
      * original plug-in library, so the worker can copy it later.
      */
-    Program* prog = program_new(action->name->str, action->path->str);
+    Program* prog = program_new(action->name->str, action->path->str, action->stackSize);
     worker_storeProgram(prog);
 }
 
@@ -11,7 +11,7 @@
 
 typedef struct _LoadPluginAction LoadPluginAction;
 
-LoadPluginAction* loadplugin_new(GString* name, GString* path);
+LoadPluginAction* loadplugin_new(GString* name, GString* path, guint stackSize);
 void loadplugin_run(LoadPluginAction* action);
 void loadplugin_free(LoadPluginAction* action);
 
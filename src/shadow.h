@@ -66,6 +66,9 @@ typedef struct _Process Process;
 #include "runnable/event/shd-event.h"
 #include "runnable/action/shd-action.h"
 #include "support/shd-parser.h"
+#include "topology/shd-address.h"
+#include "topology/shd-path.h"
+#include "host/shd-payload.h"
 #include "host/shd-packet.h"
 #include "host/shd-cpu.h"
 #include "support/shd-pcap-writer.h"
@@ -73,15 +76,15 @@ typedef struct _Process Process;
 /* utilities with limited dependencies */
 #include "utility/shd-byte-queue.h"
 #include "utility/shd-priority-queue.h"
+#include "utility/shd-sequence-ring.h"
 #include "utility/shd-async-priority-queue.h"
 #include "utility/shd-count-down-latch.h"
 #include "utility/shd-random.h"
+#include "utility/shd-arena.h"
 
 #include "support/shd-event-queue.h"
 
-#include "topology/shd-address.h"
 #include "topology/shd-dns.h"
-#include "topology/shd-path.h"
 
 #include "host/descriptor/shd-epoll.h"
 #include "host/descriptor/shd-timer.h"
@@ -99,6 +102,8 @@ typedef struct _Process Process;
 #include "host/shd-process.h"
 #include "host/shd-network-interface.h"
 #include "host/shd-tracker.h"
+#include "host/shd-timer-wheel.h"
+#include "host/shd-resolver-cache.h"
 #include "host/shd-host.h"
 
 #include "topology/shd-topology.h"
@@ -113,7 +118,6 @@ typedef struct _Process Process;
 #include "runnable/event/shd-start-application.h"
 #include "runnable/event/shd-stop-application.h"
 #include "runnable/event/shd-tcp-close-timer-expired.h"
-#include "runnable/event/shd-tcp-retransmit-timer-expired.h"
 #include "runnable/action/shd-create-node.h"
 #include "runnable/action/shd-kill-engine.h"
 #include "runnable/action/shd-load-plugin.h"
@@ -26,6 +26,9 @@ Configuration* configuration_new(gint argc, gchar* argv[]) {
 
     /* set defaults */
     c->initialTCPWindow = 10;
+    c->tcpSegmentOffload = 1;
+    c->tcpDelayedACKSegments = 1;
+    c->tcpFluidAfter = 0;
     c->interfaceBufferSize = 1024000;
     c->interfaceBatchTime = 10;
     c->randomSeed = 1;
@@ -39,10 +42,11 @@ Configuration* configuration_new(gint argc, gchar* argv[]) {
       { "debug", 'd', 0, G_OPTION_ARG_NONE, &(c->debug), "Pause at startup for debugger attachment", NULL },
       { "heartbeat-frequency", 'h', 0, G_OPTION_ARG_INT, &(c->heartbeatInterval), "Log node statistics every N seconds [1]", "N" },
       { "heartbeat-log-level", 'j', 0, G_OPTION_ARG_STRING, &(c->heartbeatLogLevelInput), "Log LEVEL at which to print node statistics ['message']", "LEVEL" },
-      { "heartbeat-log-info", 'i', 0, G_OPTION_ARG_STRING, &(c->heartbeatLogInfo), "Comma separated list of information contained in heartbeat ('node','socket','ram') ['node']", "LIST"},
+      { "heartbeat-log-info", 'i', 0, G_OPTION_ARG_STRING, &(c->heartbeatLogInfo), "Comma separated list of information contained in heartbeat ('node','socket','ram','resolver') ['node']", "LIST"},
       { "log-level", 'l', 0, G_OPTION_ARG_STRING, &(c->logLevelInput), "Log LEVEL above which to filter messages ('error' < 'critical' < 'warning' < 'message' < 'info' < 'debug') ['message']", "LEVEL" },
       { "preload", 'p', 0, G_OPTION_ARG_STRING, &(c->preloads), "LD_PRELOAD environment VALUE to use for function interposition (/path/to/lib:...) [None]", "VALUE" },
       { "runahead", 'r', 0, G_OPTION_ARG_INT, &(c->minRunAhead), "If set, overrides the automatically calculated minimum TIME workers may run ahead when sending events between nodes, in milliseconds [0]", "TIME" },
+      { "runahead-observed", 0, 0, G_OPTION_ARG_INT, &(c->runAheadObservedWindows), "Size the runahead by the minimum latency between hosts that exchanged packets in the last N execution windows instead of over all known paths; events that would violate it are delayed and logged; requires --workers of at least 1 (0 to disable) [0]", "N" },
       { "seed", 's', 0, G_OPTION_ARG_INT, &(c->randomSeed), "Initialize randomness for each thread using seed N [1]", "N" },
       { "workers", 'w', 0, G_OPTION_ARG_INT, &(c->nWorkerThreads), "Run concurrently with N worker threads [0]", "N" },
       { "valgrind", 'x', 0, G_OPTION_ARG_NONE, &(c->runValgrind), "Run through valgrind for debugging", NULL },
@@ -77,11 +81,14 @@ Configuration* configuration_new(gint argc, gchar* argv[]) {
       { "cpu-threshold", 0, 0, G_OPTION_ARG_INT, &(c->cpuThreshold), "TIME delay threshold after which the CPU becomes blocked, in microseconds (negative value to disable CPU delays) (experimental!) [-1]", "TIME" },
       { "interface-batch", 0, 0, G_OPTION_ARG_INT, &(c->interfaceBatchTime), "Batch TIME for network interface sends and receives, in milliseconds [10]", "TIME" },
       { "interface-buffer", 0, 0, G_OPTION_ARG_INT, &(c->interfaceBufferSize), "Size of the network interface receive buffer, in bytes [1024000]", "N" },
-      { "interface-qdisc", 0, 0, G_OPTION_ARG_STRING, &(c->interfaceQueuingDiscipline), "The interface queuing discipline QDISC used to select the next sendable socket ('fifo' or 'rr') ['fifo']", "QDISC" },
+      { "interface-qdisc", 0, 0, G_OPTION_ARG_STRING, &(c->interfaceQueuingDiscipline), "The interface queuing discipline QDISC used to select the next sendable socket ('fifo', 'rr', 'drr', or 'fq_codel') ['fifo']", "QDISC" },
       { "socket-recv-buffer", 0, 0, G_OPTION_ARG_INT, &(c->initialSocketReceiveBufferSize), sockrecv->str, "N" },
       { "socket-send-buffer", 0, 0, G_OPTION_ARG_INT, &(c->initialSocketSendBufferSize), socksend->str, "N" },
       { "tcp-congestion-control", 0, 0, G_OPTION_ARG_STRING, &(c->tcpCongestionControl), "Congestion control algorithm to use for TCP ('aimd', 'reno', 'cubic') ['cubic']", "TCPCC" },
       { "tcp-ssthresh", 0, 0, G_OPTION_ARG_INT, &(c->tcpSlowStartThreshold), "Set TCP ssthresh value instead of discovering it via packet loss or hystart [0]", "N" },
+      { "tcp-fluid-after", 0, 0, G_OPTION_ARG_INT, &(c->tcpFluidAfter), "Approximate bulk TCP flows at the flow level once they spent TIME seconds in congestion avoidance, sending a window at the analytic rate every round trip (0 to disable) [0]", "TIME" },
+      { "tcp-delayed-ack", 0, 0, G_OPTION_ARG_INT, &(c->tcpDelayedACKSegments), "Delay ACKs for in-order TCP data until N full segments arrived or the delayed ACK timer fires (1 to ACK every segment) [1]", "N" },
+      { "tcp-segment-offload", 0, 0, G_OPTION_ARG_INT, &(c->tcpSegmentOffload), "Coalesce up to N consecutive TCP data segments of a flow into one super-segment on the wire; loss still applies per segment (1 to disable) [1]", "N" },
       { "tcp-windows", 0, 0, G_OPTION_ARG_INT, &(c->initialTCPWindow), "Initialize the TCP send, receive, and congestion windows to N packets [10]", "N" },
       { NULL },
     };
@@ -127,9 +134,27 @@ Configuration* configuration_new(gint argc, gchar* argv[]) {
     if(c->heartbeatInterval < 1) {
         c->heartbeatInterval = 1;
     }
+    if(c->runAheadObservedWindows < 0) {
+        c->runAheadObservedWindows = 0;
+    }
+    if(c->runAheadObservedWindows > 0 && c->nWorkerThreads == 0) {
+        /* the observed latencies are only collected between worker threads */
+        g_printerr("** --runahead-observed has no effect without worker threads, use --workers N with N > 0 **\n");
+        configuration_free(c);
+        return NULL;
+    }
     if(c->initialTCPWindow < 1) {
         c->initialTCPWindow = 1;
     }
+    if(c->tcpSegmentOffload < 1) {
+        c->tcpSegmentOffload = 1;
+    }
+    if(c->tcpDelayedACKSegments < 1) {
+        c->tcpDelayedACKSegments = 1;
+    }
+    if(c->tcpFluidAfter < 0) {
+        c->tcpFluidAfter = 0;
+    }
     if(c->interfaceBufferSize < CONFIG_MTU) {
         c->interfaceBufferSize = CONFIG_MTU;
     }
@@ -171,6 +171,11 @@ typedef guint ShadowID;
  */
 #define CONFIG_PIPE_BUFFER_SIZE 65536
 
+/**
+ * Number of getaddrinfo results each host keeps cached for its plugins
+ */
+#define CONFIG_RESOLVER_CACHE_SIZE 256
+
 /**
  * Default batching time when the network interface receives packets
  */
@@ -205,6 +210,23 @@ typedef guint ShadowID;
  */
 #define CONFIG_TCPCLOSETIMER_DELAY (60 * SIMTIME_ONE_SECOND)
 
+/**
+ * Delay in nanoseconds before a delayed TCP ACK is sent anyway.
+ * TCP_DELACK_MIN=40ms from net/tcp.h
+ */
+#define CONFIG_TCPDELAYEDACK_DELAY (40 * SIMTIME_ONE_MILLISECOND)
+
+/**
+ * Sojourn time a packet may wait in a socket output buffer before the
+ * fq_codel queuing discipline considers the queue standing (rfc 8289).
+ */
+#define CONFIG_CODEL_TARGET (5 * SIMTIME_ONE_MILLISECOND)
+
+/**
+ * Interval over which fq_codel must see a standing queue before it drops.
+ */
+#define CONFIG_CODEL_INTERVAL (100 * SIMTIME_ONE_MILLISECOND)
+
 /**
  * Filename to find the CPU speed.
  */
@@ -233,6 +255,7 @@ struct _Configuration {
     gint cpuThreshold;
     gint cpuPrecision;
     gint minRunAhead;
+    gint runAheadObservedWindows;
     gint initialTCPWindow;
     gint interfaceBufferSize;
     gint initialSocketReceiveBufferSize;
@@ -243,6 +266,9 @@ struct _Configuration {
     SimulationTime interfaceBatchTime;
     gchar* tcpCongestionControl;
     gint tcpSlowStartThreshold;
+    gint tcpSegmentOffload;
+    gint tcpDelayedACKSegments;
+    gint tcpFluidAfter;
 
     GOptionGroup* pluginsOptionGroup;
     gboolean runTGenExample;
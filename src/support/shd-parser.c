@@ -122,6 +122,7 @@ static GError* _parser_handleTopologyAttributes(Parser* parser, const gchar** at
 static GError* _parser_handlePluginAttributes(Parser* parser, const gchar** attributeNames, const gchar** attributeValues) {
     GString* id = NULL;
     GString* path = NULL;
+    guint64 stacksize = 0;
 
     GError* error = NULL;
 
@@ -139,6 +140,14 @@ static GError* _parser_handlePluginAttributes(Parser* parser, const gchar** attr
             id = g_string_new(value);
         } else if (!path && !g_ascii_strcasecmp(name, "path")) {
             path = g_string_new(utility_getHomePath(value));
+        } else if (!stacksize && !g_ascii_strcasecmp(name, "stacksize")) {
+            gchar* end = NULL;
+            stacksize = g_ascii_strtoull(value, &end, 10);
+            /* strtoull happily negates and skips, take plain digits only */
+            if(!g_ascii_isdigit(value[0]) || *end != '\0' || stacksize == 0) {
+                error = g_error_new(G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                        "attribute 'stacksize': '%s' is not a positive number of bytes", value);
+            }
         } else {
             error = g_error_new(G_MARKUP_ERROR, G_MARKUP_ERROR_UNKNOWN_ATTRIBUTE,
                             "unknown 'plugin' attribute '%s'", name);
@@ -153,6 +162,10 @@ static GError* _parser_handlePluginAttributes(Parser* parser, const gchar** attr
         error = g_error_new(G_MARKUP_ERROR, G_MARKUP_ERROR_MISSING_ATTRIBUTE,
                 "element 'plugin' requires attributes 'id' 'path'");
     }
+    if(!error && stacksize > G_MAXUINT) {
+        error = g_error_new(G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                "attribute 'stacksize': '%"G_GUINT64_FORMAT"' is too large", stacksize);
+    }
     if(path) {
         /* make sure the path is absolute */
         if(!g_path_is_absolute(path->str)) {
@@ -172,7 +185,7 @@ static GError* _parser_handlePluginAttributes(Parser* parser, const gchar** attr
 
     if(!error) {
         /* no error, create the action */
-        Action* a = (Action*) loadplugin_new(id, path);
+        Action* a = (Action*) loadplugin_new(id, path, (guint) stacksize);
         action_setPriority(a, 0);
         _parser_addAction(parser, a);
 
@@ -0,0 +1,124 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define MYLOG(...) _mylog(__FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
+
+static void _mylog(const char* fileName, const int lineNum, const char* funcName, const char* format, ...) {
+    struct timeval t;
+    memset(&t, 0, sizeof(struct timeval));
+    gettimeofday(&t, NULL);
+    fprintf(stdout, "[%ld.%.06ld] [%s:%i] [%s] ", (long)t.tv_sec, (long)t.tv_usec, fileName, lineNum, funcName);
+
+    va_list vargs;
+    va_start(vargs, format);
+    vfprintf(stdout, format, vargs);
+    va_end(vargs);
+
+    fprintf(stdout, "\n");
+    fflush(stdout);
+}
+
+static int _check_errno(const char* call, int result, int expectedResult, int expectedErrno) {
+    /* save errno before the logging below changes it */
+    int err = errno;
+
+    if(result != expectedResult || err != expectedErrno) {
+        MYLOG("%s returned %i with errno %i (%s), expected %i with errno %i (%s)",
+                call, result, err, strerror(err), expectedResult, expectedErrno, strerror(expectedErrno));
+        return EXIT_FAILURE;
+    }
+
+    MYLOG("%s correctly failed with errno %i (%s)", call, err, strerror(err));
+    return EXIT_SUCCESS;
+}
+
+/* libc functions that shadow does not intercept set errno themselves */
+static int _test_libc() {
+    errno = 0;
+    long value = strtol("99999999999999999999999", NULL, 10);
+    if(_check_errno("strtol()", value == LONG_MAX, 1, ERANGE) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    errno = 0;
+    int result = access("/shadow-test-errno/does/not/exist", F_OK);
+    if(_check_errno("access()", result, -1, ENOENT) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* shadow sets errno when it emulates a call that fails */
+static int _test_emulated() {
+    errno = 0;
+    int result = close(-1);
+    if(_check_errno("close()", result, -1, EBADF) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    char buffer[8];
+    errno = 0;
+    result = (int) read(-1, buffer, sizeof(buffer));
+    if(_check_errno("read()", result, -1, EBADF) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/* an errno set by libc must not be lost when control passes to shadow and back */
+static int _test_mixed() {
+    errno = 0;
+    int result = access("/shadow-test-errno/does/not/exist", F_OK);
+    if(_check_errno("access()", result, -1, ENOENT) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    /* an emulated failure replaces it */
+    result = close(-1);
+    if(_check_errno("close()", result, -1, EBADF) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    /* and a libc failure replaces that again */
+    result = access("/shadow-test-errno/does/not/exist", F_OK);
+    if(_check_errno("access()", result, -1, ENOENT) != EXIT_SUCCESS) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+    fprintf(stdout, "########## errno test starting ##########\n");
+
+    if(_test_libc() != EXIT_SUCCESS) {
+        fprintf(stdout, "########## _test_libc() failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(_test_emulated() != EXIT_SUCCESS) {
+        fprintf(stdout, "########## _test_emulated() failed\n");
+        return EXIT_FAILURE;
+    }
+
+    if(_test_mixed() != EXIT_SUCCESS) {
+        fprintf(stdout, "########## _test_mixed() failed\n");
+        return EXIT_FAILURE;
+    }
+
+    fprintf(stdout, "########## errno test passed! ##########\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,101 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* a large plugin state, so that switching between processes is expensive
+ * when the state is copied in and out */
+#define STATE_SIZE (512*1024)
+#define NUM_ROUNDS 1000
+
+static unsigned char state[STATE_SIZE];
+
+/* a pointer into the hoisted state that is initialized statically */
+static unsigned char* stateCursor = &state[STATE_SIZE/2];
+
+/* shadow returns the simulated time from clock_gettime(), but it does not
+ * intercept the raw system call, which still reads the real clock */
+static long long _get_real_nanos() {
+    struct timespec t;
+    memset(&t, 0, sizeof(struct timespec));
+    syscall(SYS_clock_gettime, CLOCK_MONOTONIC, &t);
+    return ((long long)t.tv_sec) * 1000000000LL + (long long)t.tv_nsec;
+}
+
+static int _test_state(unsigned char pattern, int numProcesses) {
+    /* make sure we start from our own state */
+    if(stateCursor != &state[STATE_SIZE/2]) {
+        fprintf(stdout, "static pointer does not point into our own state\n");
+        return -1;
+    }
+
+    long long sleepNanos = 0;
+
+    for(int round = 0; round < NUM_ROUNDS; round++) {
+        /* touch one byte per page, so our own work is small next to a switch */
+        unsigned char value = (unsigned char)(pattern + round);
+        for(int i = 0; i < STATE_SIZE; i += 4096) {
+            state[i] = value;
+        }
+        *stateCursor = value;
+
+        /* every sleep lets the other processes run with their own state. they
+         * all wake up together, so each process switches in and out once. */
+        long long start = _get_real_nanos();
+        if(usleep(1000) != 0) {
+            return -1;
+        }
+        sleepNanos += _get_real_nanos() - start;
+
+        for(int i = 0; i < STATE_SIZE; i += 4096) {
+            if(state[i] != value || *stateCursor != value) {
+                fprintf(stdout, "state was changed by another process in round %i\n", round);
+                return -1;
+            }
+        }
+    }
+
+    /* the mean real time of a round, spread over the process switches in it */
+    fprintf(stdout, "########## %lld ns of real time per process switch (%i rounds, %i processes)\n",
+            sleepNanos / NUM_ROUNDS / numProcesses, NUM_ROUNDS, numProcesses);
+
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    fprintf(stdout, "########## globals test starting ##########\n");
+
+    char hostname[128];
+    memset(hostname, 0, sizeof(hostname));
+    if(gethostname(hostname, sizeof(hostname)-1) < 0) {
+        fprintf(stdout, "########## gethostname() failed\n");
+        return -1;
+    }
+
+    /* each process writes its own pattern */
+    unsigned char pattern = 0;
+    for(int i = 0; hostname[i] != '\0'; i++) {
+        pattern = (unsigned char)(pattern * 31 + hostname[i]);
+    }
+
+    /* the number of processes that run the rounds together */
+    int numProcesses = argc > 1 ? atoi(argv[1]) : 1;
+    if(numProcesses < 1) {
+        numProcesses = 1;
+    }
+
+    if(_test_state(pattern, numProcesses) < 0) {
+        fprintf(stdout, "########## _test_state() failed\n");
+        return -1;
+    }
+
+    fprintf(stdout, "########## globals test passed! ##########\n");
+    return 0;
+}
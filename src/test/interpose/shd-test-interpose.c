@@ -0,0 +1,51 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* a plugin that does nothing but make cheap libc calls, so that its run time
+ * is dominated by the cost of intercepting them */
+#define DEFAULT_NUM_CALLS 100000000L
+
+int main(int argc, char* argv[]) {
+    fprintf(stdout, "########## interpose test starting ##########\n");
+
+    long numCalls = DEFAULT_NUM_CALLS;
+    if(argc > 1) {
+        numCalls = atol(argv[1]);
+    }
+    if(numCalls <= 0) {
+        fprintf(stdout, "########## invalid number of calls '%s'\n", argv[1]);
+        return -1;
+    }
+
+    unsigned long checksum = 0;
+
+    for(long i = 0; i < numCalls; i++) {
+        void* ptr = malloc(16);
+        if(ptr == NULL) {
+            fprintf(stdout, "########## malloc() failed\n");
+            return -1;
+        }
+        checksum += ((unsigned long)ptr) & 0xF;
+        free(ptr);
+    }
+
+    for(long i = 0; i < numCalls; i++) {
+        time_t now = time(NULL);
+        if(now == (time_t)-1) {
+            fprintf(stdout, "########## time() failed\n");
+            return -1;
+        }
+        checksum += (unsigned long)now;
+    }
+
+    fprintf(stdout, "made %li malloc/free pairs and %li time calls, checksum %lu\n",
+            numCalls, numCalls, checksum);
+    fprintf(stdout, "########## interpose test passed! ##########\n");
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+
+#include <glib.h>
+
+#include "host/shd-resolver-cache.h"
+
+/* failed assertions in the cache end up here, instead of in the shadow logger */
+void utility_handleError(const gchar* file, gint line, const gchar* function, const gchar* message) {
+    fprintf(stderr, "assertion '%s' failed in %s at %s:%i\n", message, function, file, line);
+    abort();
+}
+
+static in_addr_t _ip(const gchar* string) {
+    return inet_addr(string);
+}
+
+static void _checkResult(struct addrinfo* result, const gchar* ip, guint16 port) {
+    g_assert(result != NULL);
+    g_assert(result->ai_family == AF_INET);
+    g_assert(result->ai_next == NULL);
+    g_assert(result->ai_addrlen == sizeof(struct sockaddr_in));
+
+    struct sockaddr_in* address = (struct sockaddr_in*) result->ai_addr;
+    g_assert(address->sin_family == AF_INET);
+    g_assert(address->sin_addr.s_addr == _ip(ip));
+    g_assert(address->sin_port == htons(port));
+}
+
+static void _test_hitMiss() {
+    ResolverCache* cache = resolvercache_new(8);
+
+    g_assert(resolvercache_lookup(cache, "server", "80", 0) == NULL);
+
+    struct addrinfo* inserted = resolvercache_insert(cache, "server", "80", 0, _ip("11.0.0.1"), htons(80));
+    _checkResult(inserted, "11.0.0.1", 80);
+
+    struct addrinfo* hit = resolvercache_lookup(cache, "server", "80", 0);
+    _checkResult(hit, "11.0.0.1", 80);
+
+    /* the service, the flags, and missing strings are all part of the key */
+    g_assert(resolvercache_lookup(cache, "server", "443", 0) == NULL);
+    g_assert(resolvercache_lookup(cache, "server", "80", AI_PASSIVE) == NULL);
+    g_assert(resolvercache_lookup(cache, "server", NULL, 0) == NULL);
+    g_assert(resolvercache_lookup(cache, NULL, "80", 0) == NULL);
+    g_assert(resolvercache_lookup(cache, "other", "80", 0) == NULL);
+
+    struct addrinfo* noService = resolvercache_insert(cache, "server", NULL, 0, _ip("11.0.0.1"), 0);
+    _checkResult(noService, "11.0.0.1", 0);
+    g_assert(resolvercache_lookup(cache, "server", "", 0) == NULL);
+
+    g_assert(resolvercache_freeResult(cache, inserted));
+    g_assert(resolvercache_freeResult(cache, hit));
+    g_assert(resolvercache_freeResult(cache, noService));
+    g_assert(resolvercache_getNumResults(cache) == 0);
+
+    resolvercache_free(cache);
+}
+
+/* each caller owns its copy, so changing one does not change the cache */
+static void _test_copies() {
+    ResolverCache* cache = resolvercache_new(8);
+
+    struct addrinfo* first = resolvercache_insert(cache, "server", "80", 0, _ip("11.0.0.1"), htons(80));
+    struct addrinfo* second = resolvercache_lookup(cache, "server", "80", 0);
+    g_assert(first != second);
+    g_assert(first->ai_addr != second->ai_addr);
+
+    ((struct sockaddr_in*) first->ai_addr)->sin_port = htons(9999);
+    first->ai_socktype = SOCK_DGRAM;
+
+    _checkResult(second, "11.0.0.1", 80);
+    struct addrinfo* third = resolvercache_lookup(cache, "server", "80", 0);
+    _checkResult(third, "11.0.0.1", 80);
+    g_assert(third->ai_socktype == SOCK_STREAM);
+
+    resolvercache_freeResult(cache, first);
+    resolvercache_freeResult(cache, second);
+    resolvercache_freeResult(cache, third);
+    resolvercache_free(cache);
+}
+
+static void _test_eviction() {
+    ResolverCache* cache = resolvercache_new(2);
+
+    struct addrinfo* a = resolvercache_insert(cache, "a", NULL, 0, _ip("11.0.0.1"), 0);
+    struct addrinfo* b = resolvercache_insert(cache, "b", NULL, 0, _ip("11.0.0.2"), 0);
+
+    /* a is now the most recently used, so b goes first */
+    struct addrinfo* a2 = resolvercache_lookup(cache, "a", NULL, 0);
+    struct addrinfo* c = resolvercache_insert(cache, "c", NULL, 0, _ip("11.0.0.3"), 0);
+
+    g_assert(resolvercache_lookup(cache, "b", NULL, 0) == NULL);
+    struct addrinfo* a3 = resolvercache_lookup(cache, "a", NULL, 0);
+    _checkResult(a3, "11.0.0.1", 0);
+
+    /* now c is the least recently used */
+    struct addrinfo* d = resolvercache_insert(cache, "d", NULL, 0, _ip("11.0.0.4"), 0);
+    g_assert(resolvercache_lookup(cache, "c", NULL, 0) == NULL);
+
+    /* inserting a cached key replaces its entry without evicting another */
+    struct addrinfo* a4 = resolvercache_insert(cache, "a", NULL, 0, _ip("11.0.0.5"), 0);
+    struct addrinfo* a5 = resolvercache_lookup(cache, "a", NULL, 0);
+    _checkResult(a5, "11.0.0.5", 0);
+    struct addrinfo* d2 = resolvercache_lookup(cache, "d", NULL, 0);
+    _checkResult(d2, "11.0.0.4", 0);
+
+    /* results of evicted and replaced entries stay valid */
+    _checkResult(b, "11.0.0.2", 0);
+    _checkResult(c, "11.0.0.3", 0);
+    _checkResult(a, "11.0.0.1", 0);
+
+    struct addrinfo* all[] = {a, b, a2, c, a3, d, a4, a5, d2};
+    g_assert(resolvercache_getNumResults(cache) == G_N_ELEMENTS(all));
+    for(guint i = 0; i < G_N_ELEMENTS(all); i++) {
+        g_assert(resolvercache_freeResult(cache, all[i]));
+    }
+    g_assert(resolvercache_getNumResults(cache) == 0);
+
+    resolvercache_free(cache);
+}
+
+/* the cache tracks the results it hands out until they are freed */
+static void _test_results() {
+    ResolverCache* cache = resolvercache_new(4);
+
+    struct addrinfo* held = resolvercache_insert(cache, "server", NULL, 0, _ip("11.0.0.1"), 0);
+    struct addrinfo* freed = resolvercache_lookup(cache, "server", NULL, 0);
+    g_assert(resolvercache_getNumResults(cache) == 2);
+
+    g_assert(resolvercache_freeResult(cache, freed));
+    g_assert(resolvercache_getNumResults(cache) == 1);
+
+    /* an addrinfo the cache did not create is freed, but not accepted */
+    struct addrinfo* foreign = g_new0(struct addrinfo, 1);
+    g_assert(!resolvercache_freeResult(cache, foreign));
+    g_assert(resolvercache_getNumResults(cache) == 1);
+
+    /* results that were never freed go away with the cache */
+    _checkResult(held, "11.0.0.1", 0);
+    resolvercache_free(cache);
+}
+
+int main(int argc, char* argv[]) {
+    _test_hitMiss();
+    _test_copies();
+    _test_eviction();
+    _test_results();
+
+    fprintf(stdout, "all resolver cache tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,234 @@
+/*
+ * The Shadow Simulator
+ * See LICENSE for licensing information
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "utility/shd-sequence-ring.h"
+
+/* items are the sequence itself, offset so that sequence 0 is not NULL */
+#define ITEM(sequence) GUINT_TO_POINTER((sequence) + 1)
+#define ITEM_SEQUENCE(item) (GPOINTER_TO_UINT(item) - 1)
+
+static guint numFreed = 0;
+
+/* failed assertions in the ring end up here, instead of in the shadow logger */
+void utility_handleError(const gchar* file, gint line, const gchar* function, const gchar* message) {
+    fprintf(stderr, "assertion '%s' failed in %s at %s:%i\n", message, function, file, line);
+    abort();
+}
+
+static void _countFree(gpointer item) {
+    numFreed++;
+}
+
+static void _checkAcked(gpointer item, gpointer userData) {
+    guint32* nextAcked = userData;
+    /* cumulative removal must go in sequence order */
+    g_assert(ITEM_SEQUENCE(item) == *nextAcked);
+    (*nextAcked)++;
+}
+
+static void _test_insertLookup() {
+    SequenceRing* ring = sequencering_new(NULL);
+    g_assert(sequencering_isEmpty(ring));
+    g_assert(sequencering_peekFirst(ring) == NULL);
+
+    /* out of order, including sequence 0 for control packets */
+    guint32 order[] = {5, 2, 9, 0, 7};
+    for(guint i = 0; i < G_N_ELEMENTS(order); i++) {
+        g_assert(sequencering_insert(ring, order[i], ITEM(order[i])));
+    }
+    g_assert(sequencering_getLength(ring) == G_N_ELEMENTS(order));
+    g_assert(sequencering_getFirstSequence(ring) == 0);
+
+    /* duplicates are refused and leave the original in place */
+    g_assert(!sequencering_insert(ring, 7, ITEM(100)));
+    g_assert(sequencering_lookup(ring, 7) == ITEM(7));
+
+    /* gaps and sequences outside of the stored range are empty */
+    g_assert(sequencering_lookup(ring, 3) == NULL);
+    g_assert(sequencering_lookup(ring, 10) == NULL);
+    g_assert(sequencering_lookup(ring, 100) == NULL);
+
+    /* stealing from the ends moves them to the next stored items */
+    g_assert(sequencering_steal(ring, 0) == ITEM(0));
+    g_assert(sequencering_getFirstSequence(ring) == 2);
+    g_assert(sequencering_steal(ring, 9) == ITEM(9));
+    g_assert(sequencering_steal(ring, 9) == NULL);
+    g_assert(sequencering_steal(ring, 5) == ITEM(5));
+
+    g_assert(sequencering_popFirst(ring) == ITEM(2));
+    g_assert(sequencering_popFirst(ring) == ITEM(7));
+    g_assert(sequencering_popFirst(ring) == NULL);
+    g_assert(sequencering_isEmpty(ring));
+
+    sequencering_free(ring);
+}
+
+/* a window sliding forward reuses the slots many times over */
+static void _test_wraparound() {
+    SequenceRing* ring = sequencering_new(NULL);
+    const guint32 window = 50;
+    const guint32 start = 1000;
+
+    for(guint32 s = start; s < start + window; s++) {
+        g_assert(sequencering_insert(ring, s, ITEM(s)));
+    }
+
+    for(guint32 s = start; s < start + 100 * window; s++) {
+        g_assert(sequencering_getFirstSequence(ring) == s);
+        g_assert(sequencering_popFirst(ring) == ITEM(s));
+        g_assert(sequencering_insert(ring, s + window, ITEM(s + window)));
+        g_assert(sequencering_getLength(ring) == window);
+
+        /* the slot we just freed now belongs to a new sequence */
+        g_assert(sequencering_lookup(ring, s) == NULL);
+        g_assert(sequencering_lookup(ring, s + window) == ITEM(s + window));
+    }
+
+    /* sequences near the top of the range do not overflow the span */
+    sequencering_clear(ring);
+    guint32 top = G_MAXUINT32 - 10;
+    for(guint32 s = top; s < G_MAXUINT32; s++) {
+        g_assert(sequencering_insert(ring, s, ITEM(s)));
+    }
+    g_assert(sequencering_getFirstSequence(ring) == top);
+    g_assert(sequencering_lookup(ring, G_MAXUINT32 - 1) == ITEM(G_MAXUINT32 - 1));
+
+    sequencering_free(ring);
+}
+
+/* growing must move items whose slots had wrapped past the end of the array */
+static void _test_growth() {
+    SequenceRing* ring = sequencering_new(_countFree);
+    numFreed = 0;
+
+    /* shift the window so the stored items wrap in the initial 64 slots */
+    for(guint32 s = 0; s < 40; s++) {
+        g_assert(sequencering_insert(ring, s, ITEM(s)));
+    }
+    for(guint32 s = 40; s < 100; s++) {
+        g_assert(sequencering_popFirst(ring) == ITEM(s - 40));
+        g_assert(sequencering_insert(ring, s, ITEM(s)));
+    }
+
+    /* a far ahead sequence forces several doublings at once */
+    g_assert(sequencering_insert(ring, 5000, ITEM(5000)));
+    for(guint32 s = 60; s < 100; s++) {
+        g_assert(sequencering_lookup(ring, s) == ITEM(s));
+    }
+    for(guint32 s = 100; s < 5000; s++) {
+        g_assert(sequencering_lookup(ring, s) == NULL);
+    }
+
+    /* fill the gap in reverse, growing from the front is covered by the span */
+    for(guint32 s = 4999; s >= 100; s--) {
+        g_assert(sequencering_insert(ring, s, ITEM(s)));
+    }
+    g_assert(!sequencering_insert(ring, 60, ITEM(60)));
+    g_assert(sequencering_getLength(ring) == 5001 - 60);
+
+    /* a sequence below the first grows the ring backwards */
+    g_assert(sequencering_insert(ring, 10, ITEM(10)));
+    g_assert(sequencering_getFirstSequence(ring) == 10);
+    g_assert(sequencering_lookup(ring, 59) == NULL);
+
+    /* a cumulative ack walks exactly the acked items in order */
+    g_assert(sequencering_popFirst(ring) == ITEM(10));
+    guint32 nextAcked = 60;
+    guint nRemoved = sequencering_removeBefore(ring, 3000, _checkAcked, &nextAcked);
+    g_assert(nRemoved == 3000 - 60);
+    g_assert(nextAcked == 3000);
+    g_assert(numFreed == 3000 - 60);
+    g_assert(sequencering_getFirstSequence(ring) == 3000);
+
+    /* acking below the first item removes nothing */
+    g_assert(sequencering_removeBefore(ring, 100, NULL, NULL) == 0);
+
+    sequencering_free(ring);
+    g_assert(numFreed == 5001 - 60);
+}
+
+/* the cumulative ack pattern of the retransmit queue, with many segments in flight */
+static gint64 _benchmark_ring(guint32 inFlight, guint32 nAcks) {
+    gint64 start = g_get_monotonic_time();
+
+    SequenceRing* ring = sequencering_new(NULL);
+    guint32 next = 1;
+    for(; next <= inFlight; next++) {
+        sequencering_insert(ring, next, ITEM(next));
+    }
+    for(guint32 i = 0; i < nAcks; i++) {
+        /* a delayed ack covers two segments, and two more go out */
+        sequencering_removeBefore(ring, sequencering_getFirstSequence(ring) + 2, NULL, NULL);
+        sequencering_insert(ring, next, ITEM(next));
+        next++;
+        sequencering_insert(ring, next, ITEM(next));
+        next++;
+    }
+    sequencering_free(ring);
+
+    return g_get_monotonic_time() - start;
+}
+
+/* the same pattern on a hash table that must be scanned on every ack */
+static gint64 _benchmark_hashTable(guint32 inFlight, guint32 nAcks) {
+    gint64 start = g_get_monotonic_time();
+
+    GHashTable* table = g_hash_table_new(g_direct_hash, g_direct_equal);
+    guint32 next = 1, unacked = 1;
+    for(; next <= inFlight; next++) {
+        g_hash_table_insert(table, GUINT_TO_POINTER(next), ITEM(next));
+    }
+    for(guint32 i = 0; i < nAcks; i++) {
+        unacked += 2;
+
+        GHashTableIter iter;
+        gpointer key, value;
+        g_hash_table_iter_init(&iter, table);
+        while(g_hash_table_iter_next(&iter, &key, &value)) {
+            if(GPOINTER_TO_UINT(key) < unacked) {
+                g_hash_table_iter_remove(&iter);
+            }
+        }
+
+        g_hash_table_insert(table, GUINT_TO_POINTER(next), ITEM(next));
+        next++;
+        g_hash_table_insert(table, GUINT_TO_POINTER(next), ITEM(next));
+        next++;
+    }
+    g_hash_table_destroy(table);
+
+    return g_get_monotonic_time() - start;
+}
+
+static void _run_benchmark(guint32 inFlight) {
+    guint32 nAcks = 5000;
+
+    gint64 ringTime = _benchmark_ring(inFlight, nAcks);
+    gint64 tableTime = _benchmark_hashTable(inFlight, nAcks);
+
+    fprintf(stdout, "%u segments in flight, %u acks: sequence ring %"G_GINT64_FORMAT" us, "
+            "hash table %"G_GINT64_FORMAT" us\n", inFlight, nAcks, ringTime, tableTime);
+}
+
+int main(int argc, char* argv[]) {
+    if(argc > 1 && g_ascii_strcasecmp(argv[1], "benchmark") == 0) {
+        guint32 inFlight = argc > 2 ? (guint32)atoi(argv[2]) : 20000;
+        _run_benchmark(MAX(inFlight, 2));
+        return EXIT_SUCCESS;
+    }
+
+    _test_insertLookup();
+    _test_wraparound();
+    _test_growth();
+
+    fprintf(stdout, "all sequence ring tests passed\n");
+    return EXIT_SUCCESS;
+}
@@ -20,10 +20,14 @@
 #include <sys/select.h>
 #include <fcntl.h>
 
-#define USAGE "USAGE: 'shd-test-tcp iomode type'; iomode=('blocking'|'nonblocking-poll'|'nonblocking-epoll'|'nonblocking-select') type=('client' server_ip|'server')"
+#include "shd-plugin-api.h"
+
+#define USAGE "USAGE: 'shd-test-tcp iomode type'; iomode=('blocking'|'nonblocking-poll'|'nonblocking-epoll'|'nonblocking-select'|'iov'|'virtual'|'bulk') type=('client' server_ip|'server')"
 #define MYLOG(...) _mylog(__FILE__, __LINE__, __FUNCTION__, __VA_ARGS__)
 #define SERVER_PORT 58333
 #define BUFFERSIZE 20000
+/* long enough for the flow to settle into congestion avoidance */
+#define BULKSIZE (20*1024*1024)
 #define ARRAY_LENGTH(arr)  (sizeof (arr) / sizeof ((arr)[0]))
 
 int tempa = 0;
@@ -322,6 +326,125 @@ static int _do_recv(int fd, char* buf, iowait_func iowait) {
     return 0;
 }
 
+/* sends BUFFERSIZE bytes without a buffer, the socket must be non-blocking */
+static int _do_send_virtual(int fd, iowait_func iowait) {
+    int offset = 0, amount = 0;
+
+    if(!shadow_send_virtual) {
+        MYLOG("shadow_send_virtual() is only available when running in shadow");
+        return -1;
+    }
+
+    while((amount = BUFFERSIZE - offset) > 0) {
+        MYLOG("trying to send %i more virtual bytes", amount);
+        ssize_t n = shadow_send_virtual(fd, (size_t)amount);
+        MYLOG("shadow_send_virtual() returned %li", (long)n);
+
+        if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if(iowait(fd, WAIT_WRITE) < 0) {
+                MYLOG("error waiting for shadow_send_virtual()");
+                return -1;
+            }
+        } else if(n < 0) {
+            MYLOG("shadow_send_virtual() error was: %s", strerror(errno));
+            return -1;
+        } else if(n > 0) {
+            offset += (int)n;
+        } else {
+            MYLOG("shadow_send_virtual() accepted no bytes and did not fail");
+            return -1;
+        }
+    }
+
+    MYLOG("sent %i/%i virtual bytes", offset, BUFFERSIZE);
+
+    /* virtual bytes are never returned, a single ok tells us they all arrived */
+    if(iowait(fd, WAIT_READ) < 0) {
+        MYLOG("error waiting for the server's ok");
+        return -1;
+    }
+    char syncbuf[2] = {0};
+    ssize_t n = recv(fd, syncbuf, sizeof syncbuf, 0);
+    if(n != sizeof syncbuf || memcmp(syncbuf, "OK", sizeof syncbuf)) {
+        MYLOG("server did not receive all of the virtual bytes");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* the byte expected at an offset of the bulk stream */
+static char _bulkbyte(long offset) {
+    return (char)('a' + (offset % 23));
+}
+
+/* sends BULKSIZE bytes in BUFFERSIZE chunks on a blocking socket */
+static int _do_send_bulk(int fd) {
+    char buf[BUFFERSIZE];
+    long offset = 0;
+
+    while(offset < BULKSIZE) {
+        int amount = (BULKSIZE - offset < BUFFERSIZE) ? (int)(BULKSIZE - offset) : BUFFERSIZE;
+        for(int i = 0; i < amount; i++) {
+            buf[i] = _bulkbyte(offset + i);
+        }
+
+        int sent = 0;
+        while(sent < amount) {
+            ssize_t n = send(fd, &buf[sent], (size_t)(amount - sent), 0);
+            if(n <= 0) {
+                MYLOG("send() failed after %li bytes, error was: %s", offset + sent, strerror(errno));
+                return -1;
+            }
+            sent += (int)n;
+        }
+        offset += amount;
+    }
+
+    MYLOG("sent %li bulk bytes", offset);
+
+    /* wait until the server checked all of them */
+    char syncbuf[2] = {0};
+    ssize_t n = recv(fd, syncbuf, sizeof syncbuf, 0);
+    if(n != sizeof syncbuf || memcmp(syncbuf, "OK", sizeof syncbuf)) {
+        MYLOG("server did not receive the bulk bytes intact");
+        return -1;
+    }
+
+    return 0;
+}
+
+/* receives BULKSIZE bytes on a blocking socket, checking every one of them */
+static int _do_recv_bulk(int fd) {
+    char buf[BUFFERSIZE];
+    long offset = 0;
+
+    while(offset < BULKSIZE) {
+        size_t amount = (BULKSIZE - offset < BUFFERSIZE) ? (size_t)(BULKSIZE - offset) : BUFFERSIZE;
+        ssize_t n = recv(fd, buf, amount, 0);
+        if(n <= 0) {
+            MYLOG("recv() returned %li after %li bytes, error was: %s", (long)n, offset, strerror(errno));
+            return -1;
+        }
+        for(ssize_t i = 0; i < n; i++) {
+            if(buf[i] != _bulkbyte(offset + i)) {
+                MYLOG("inconsistent bulk byte at offset %li", offset + (long)i);
+                return -1;
+            }
+        }
+        offset += n;
+    }
+
+    MYLOG("received %li/%i bulk bytes :)", offset, BULKSIZE);
+
+    if(send(fd, "OK", 2, 0) != 2) {
+        MYLOG("unable to send the ok to the client");
+        return -1;
+    }
+
+    return 0;
+}
+
 /* make the socket blocking. Returns 0 on success, or -1 on error */
 static int _make_socket_blocking(int fd)
 {
@@ -624,7 +747,7 @@ static int _test_iov_server(int clientfd)
     return 0;
 }
 
-static int _run_client(iowait_func iowait, const char* servername, const int use_iov) {
+static int _run_client(iowait_func iowait, const char* servername, const int use_iov, const int use_virtual, const int use_bulk) {
     struct sockaddr_in serveraddr;
     if(_do_addr(servername, &serveraddr) < 0) {
         return -1;
@@ -640,7 +763,17 @@ static int _run_client(iowait_func iowait, const char* servername, const int use
         return -1;
     }
 
-    if (!use_iov) {
+    if (use_virtual) {
+        if(_do_send_virtual(serversd, iowait) < 0) {
+            return -1;
+        }
+    }
+    else if (use_bulk) {
+        if(_do_send_bulk(serversd) < 0) {
+            return -1;
+        }
+    }
+    else if (!use_iov) {
         /* now prepare a message */
         char outbuf[BUFFERSIZE];
         memset(outbuf, 0, BUFFERSIZE);
@@ -680,7 +813,7 @@ static int _run_client(iowait_func iowait, const char* servername, const int use
     return 0;
 }
 
-static int _run_server(iowait_func iowait, int use_iov) {
+static int _run_server(iowait_func iowait, int use_iov, int use_virtual, int use_bulk) {
     int listensd;
     int type = iowait ? (SOCK_STREAM|SOCK_NONBLOCK) : SOCK_STREAM;
     if(_do_socket(type, &listensd) < 0) {
@@ -698,7 +831,23 @@ static int _run_server(iowait_func iowait, int use_iov) {
         return -1;
     }
 
-    if (!use_iov) {
+    if (use_virtual) {
+        /* the content is filler, only the amount matters */
+        char buf[BUFFERSIZE];
+        if(_do_recv(clientsd, buf, iowait) < 0) {
+            return -1;
+        }
+        if(send(clientsd, "OK", 2, 0) != 2) {
+            MYLOG("unable to send the ok to the client");
+            return -1;
+        }
+    }
+    else if (use_bulk) {
+        if(_do_recv_bulk(clientsd) < 0) {
+            return -1;
+        }
+    }
+    else if (!use_iov) {
         /* got one, now read the entire message */
         char buf[BUFFERSIZE];
         memset(buf, 0, BUFFERSIZE);
@@ -733,6 +882,8 @@ int main(int argc, char *argv[]) {
 
     iowait_func wait = NULL;
     int use_iov = 0;
+    int use_virtual = 0;
+    int use_bulk = 0;
 
     if(strncasecmp(argv[1], "blocking", 8) == 0) {
         wait = NULL;
@@ -745,6 +896,13 @@ int main(int argc, char *argv[]) {
     } else if(strncasecmp(argv[1], "iov", 3) == 0) {
         wait = NULL;
         use_iov = 1;
+    } else if(strncasecmp(argv[1], "virtual", 7) == 0) {
+        /* the sender needs a non-blocking socket */
+        wait = _wait_poll;
+        use_virtual = 1;
+    } else if(strncasecmp(argv[1], "bulk", 4) == 0) {
+        wait = NULL;
+        use_bulk = 1;
     } else {
         MYLOG("error, invalid iomode specified; see usage");
         return -1;
@@ -755,9 +913,9 @@ int main(int argc, char *argv[]) {
             MYLOG("error, client mode also needs a server ip address; see usage");
             return -1;
         }
-        return _run_client(wait, argv[3], use_iov);
+        return _run_client(wait, argv[3], use_iov, use_virtual, use_bulk);
     } else if(strncasecmp(argv[2], "server", 6) == 0) {
-        return _run_server(wait, use_iov);
+        return _run_server(wait, use_iov, use_virtual, use_bulk);
     } else {
         MYLOG("error, invalid type specified; see usage");
         return -1;
@@ -6,10 +6,43 @@
 
 #include "shadow.h"
 
+/* http://en.wikipedia.org/wiki/Reserved_IP_addresses#Reserved_IPv4_addresses */
+static const gchar* restrictedCIDRs[] = {
+    "0.0.0.0/8",
+    "10.0.0.0/8",
+    "100.64.0.0/10",
+    "127.0.0.0/8",
+    "169.254.0.0/16",
+    "172.16.0.0/12",
+    "192.0.0.0/29",
+    "192.0.2.0/24",
+    "192.88.99.0/24",
+    "192.168.0.0/16",
+    "198.18.0.0/15",
+    "198.51.100.0/24",
+    "203.0.113.0/24",
+    "224.0.0.0/4",
+    "240.0.0.0/4",
+    "255.255.255.255/32",
+    NULL
+};
+
+/* an inclusive range of host-order IPs */
+typedef struct _DNSRange DNSRange;
+struct _DNSRange {
+    guint32 first;
+    guint32 last;
+};
+
 struct _DNS {
+    /* the last host-order IP we handed out; we allocate sequentially from here */
     in_addr_t ipAddressCounter;
     guint macAddressCounter;
 
+    /* the restricted ranges, parsed once, sorted by first IP, and merged */
+    DNSRange* restricted;
+    guint numRestricted;
+
     /* address mappings */
     GHashTable* addressByIP;
     GHashTable* addressByName;
@@ -17,7 +50,7 @@ struct _DNS {
     MAGIC_DECLARE;
 };
 
-static gboolean _dns_isIPInRange(const in_addr_t netIP, const gchar* cidrStr) {
+static DNSRange _dns_parseCIDR(const gchar* cidrStr) {
     utility_assert(cidrStr);
 
     gchar** cidrParts = g_strsplit(cidrStr, "/", 0);
@@ -25,82 +58,107 @@ static gboolean _dns_isIPInRange(const in_addr_t netIP, const gchar* cidrStr) {
     gint cidrBits = atoi(cidrParts[1]);
     utility_assert(cidrBits >= 0 && cidrBits <= 32);
 
-    /* first create the mask in host order */
-    in_addr_t netmask = 0;
-    for(gint i = 0; i < 32; i++) {
-        /* move one so LSB is 0 */
-        netmask = netmask << 1;
-        if(cidrBits > i) {
-            /* flip the LSB */
-            netmask++;
-        }
+    /* create the mask in host order, shifting by 32 is undefined */
+    guint32 netmask = cidrBits == 0 ? 0 : (G_MAXUINT32 << (32 - cidrBits));
+
+    /* get the subnet ip in host order */
+    guint32 subnetIP = ntohl(address_stringToIP(cidrIPStr));
+
+    g_strfreev(cidrParts);
+
+    /* all non-subnet bits may be flipped */
+    DNSRange range;
+    range.first = subnetIP & netmask;
+    range.last = range.first | ~netmask;
+    return range;
+}
+
+static gint _dns_compareRanges(const DNSRange* a, const DNSRange* b) {
+    return a->first < b->first ? -1 : a->first > b->first ? 1 : 0;
+}
+
+static void _dns_compileRestrictedRanges(DNS* dns) {
+    MAGIC_ASSERT(dns);
+
+    guint n = 0;
+    while(restrictedCIDRs[n]) {
+        n++;
     }
 
-    /* flip to network order */
-    netmask = htonl(netmask);
+    DNSRange* ranges = g_new0(DNSRange, n);
+    for(guint i = 0; i < n; i++) {
+        ranges[i] = _dns_parseCIDR(restrictedCIDRs[i]);
+    }
 
-    /* get the subnet ip in network order */
-    in_addr_t subnetIP = address_stringToIP(cidrIPStr);
+    qsort(ranges, (size_t)n, sizeof(DNSRange), (GCompareFunc)_dns_compareRanges);
 
-    g_strfreev(cidrParts);
+    /* merge overlapping and adjacent ranges so lookups find at most one */
+    guint merged = 0;
+    for(guint i = 0; i < n; i++) {
+        if(merged > 0 && (ranges[merged-1].last == G_MAXUINT32 ||
+                ranges[i].first <= ranges[merged-1].last + 1)) {
+            ranges[merged-1].last = MAX(ranges[merged-1].last, ranges[i].last);
+        } else {
+            ranges[merged++] = ranges[i];
+        }
+    }
 
-    /* all non-subnet bits should be flipped */
-    if((netIP & netmask) == (subnetIP & netmask)) {
-        gchar* ipStr = address_ipToNewString(netIP);
-        gchar* subnetIPStr = address_ipToNewString(subnetIP);
-        gchar* netmaskStr = address_ipToNewString(netmask);
-        debug("ip '%s' is in range '%s' using subnet '%s' and mask '%s'",
-                ipStr, cidrStr, subnetIPStr, netmaskStr);
-        g_free(ipStr);
-        g_free(subnetIPStr);
-        g_free(netmaskStr);
-        return TRUE;
-    } else {
-        return FALSE;
+    dns->restricted = ranges;
+    dns->numRestricted = merged;
+}
+
+/* returns the restricted range that holds the given host-order IP, or NULL */
+static DNSRange* _dns_findRestrictedRange(DNS* dns, guint32 hostIP) {
+    MAGIC_ASSERT(dns);
+
+    /* binary search over the sorted ranges */
+    guint low = 0, high = dns->numRestricted;
+    while(low < high) {
+        guint middle = low + ((high - low) / 2);
+        DNSRange* range = &(dns->restricted[middle]);
+        if(hostIP < range->first) {
+            high = middle;
+        } else if(hostIP > range->last) {
+            low = middle + 1;
+        } else {
+            return range;
+        }
     }
+
+    return NULL;
 }
 
 static gboolean _dns_isRestricted(DNS* dns, in_addr_t netIP) {
-    /* http://en.wikipedia.org/wiki/Reserved_IP_addresses#Reserved_IPv4_addresses */
-    if(_dns_isIPInRange(netIP, "0.0.0.0/8") ||
-            _dns_isIPInRange(netIP, "10.0.0.0/8") ||
-            _dns_isIPInRange(netIP, "100.64.0.0/10") ||
-            _dns_isIPInRange(netIP, "127.0.0.0/8") ||
-            _dns_isIPInRange(netIP, "169.254.0.0/16") ||
-            _dns_isIPInRange(netIP, "172.16.0.0/12") ||
-            _dns_isIPInRange(netIP, "192.0.0.0/29") ||
-            _dns_isIPInRange(netIP, "192.0.2.0/24") ||
-            _dns_isIPInRange(netIP, "192.88.99.0/24") ||
-            _dns_isIPInRange(netIP, "192.168.0.0/16") ||
-            _dns_isIPInRange(netIP, "198.18.0.0/15") ||
-            _dns_isIPInRange(netIP, "198.51.100.0/24") ||
-            _dns_isIPInRange(netIP, "203.0.113.0/24") ||
-            _dns_isIPInRange(netIP, "224.0.0.0/4") ||
-            _dns_isIPInRange(netIP, "240.0.0.0/4") ||
-            _dns_isIPInRange(netIP, "255.255.255.255/32")) {
-        return TRUE;
-    } else {
-        return FALSE;
-    }
+    return _dns_findRestrictedRange(dns, ntohl(netIP)) != NULL;
 }
 
 static gboolean _dns_isIPUnique(DNS* dns, in_addr_t ip) {
-    return dns_resolveIPToName(dns, (guint32) ip) == NULL;
+    /* dont go through dns_resolveIPToName, a miss is expected here and should not be logged */
+    return !g_hash_table_contains(dns->addressByIP, GUINT_TO_POINTER(ip));
 }
 
 static in_addr_t _dns_generateIP(DNS* dns) {
     MAGIC_ASSERT(dns);
 
-    in_addr_t ip = htonl(++dns->ipAddressCounter);
+    while(TRUE) {
+        guint32 candidate = (guint32) ++dns->ipAddressCounter;
 
-    while(_dns_isRestricted(dns, ip) || !_dns_isIPUnique(dns, ip)) {
-        ip = htonl(++dns->ipAddressCounter);
-    }
+        /* skip over an entire restricted range at once */
+        DNSRange* range = _dns_findRestrictedRange(dns, candidate);
+        if(range) {
+            dns->ipAddressCounter = range->last;
+            continue;
+        }
 
-    return ip;
+        /* only requested IPs can be in the way, since we allocate sequentially */
+        in_addr_t ip = htonl(candidate);
+        if(_dns_isIPUnique(dns, ip)) {
+            return ip;
+        }
+    }
 }
 
-Address* dns_register(DNS* dns, GQuark id, gchar* name, gchar* requestedIP) {
+static Address* _dns_registerIP(DNS* dns, GQuark id, gchar* name, in_addr_t requestedIP) {
     MAGIC_ASSERT(dns);
     utility_assert(name);
 
@@ -108,11 +166,11 @@ Address* dns_register(DNS* dns, GQuark id, gchar* name, gchar* requestedIP) {
     guint mac = ++dns->macAddressCounter;
     gboolean isLocal = FALSE;
 
-    /* if requestedIP is NULL, we should generate one ourselves */
-    if(requestedIP) {
-        ip = address_stringToIP(requestedIP);
+    /* if requestedIP is INADDR_NONE, we should generate one ourselves */
+    if(requestedIP != INADDR_NONE) {
+        ip = requestedIP;
         /* restricted is OK if this is a localhost address, otherwise it must be unique */
-        if(ip == address_stringToIP("127.0.0.1")) {
+        if(ip == htonl(INADDR_LOOPBACK)) {
             isLocal = TRUE;
         } else if(_dns_isRestricted(dns, ip) || !_dns_isIPUnique(dns, ip)) {
             ip = _dns_generateIP(dns);
@@ -134,6 +192,28 @@ Address* dns_register(DNS* dns, GQuark id, gchar* name, gchar* requestedIP) {
     return address;
 }
 
+Address* dns_register(DNS* dns, GQuark id, gchar* name, gchar* requestedIP) {
+    MAGIC_ASSERT(dns);
+    utility_assert(name);
+    return _dns_registerIP(dns, id, name, requestedIP ? address_stringToIP(requestedIP) : INADDR_NONE);
+}
+
+Address** dns_registerBatch(DNS* dns, GQuark* ids, gchar** names, guint count, gchar* requestedIP) {
+    MAGIC_ASSERT(dns);
+    utility_assert(ids && names);
+
+    /* parse the hint once for the whole batch. the first address gets the
+     * requested IP if available, the rest are generated sequentially. */
+    in_addr_t ip = requestedIP ? address_stringToIP(requestedIP) : INADDR_NONE;
+
+    Address** addresses = g_new0(Address*, count);
+    for(guint i = 0; i < count; i++) {
+        addresses[i] = _dns_registerIP(dns, ids[i], names[i], ip);
+    }
+
+    return addresses;
+}
+
 void dns_deregister(DNS* dns, Address* address) {
     MAGIC_ASSERT(dns);
     if(!address_isLocal(address)) {
@@ -192,6 +272,8 @@ DNS* dns_new() {
     dns->addressByIP = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify) address_unref);
     dns->addressByName = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, (GDestroyNotify) address_unref);
 
+    _dns_compileRestrictedRanges(dns);
+
     /* 11.0.0.0 -- 100.0.0.0 is the longest available unrestricted range */
     dns->ipAddressCounter = ntohl(address_stringToIP("11.0.0.0"));
 
@@ -203,6 +285,7 @@ void dns_free(DNS* dns) {
 
     g_hash_table_destroy(dns->addressByIP);
     g_hash_table_destroy(dns->addressByName);
+    g_free(dns->restricted);
 
     MAGIC_CLEAR(dns);
     g_free(dns);
@@ -15,6 +15,9 @@ DNS* dns_new();
 void dns_free(DNS* dns);
 
 Address* dns_register(DNS* dns, GQuark id, gchar* name, gchar* requestedIP);
+/* registers one address for each of the count ids and names. the caller owns a
+ * reference to each returned address and must free the returned array */
+Address** dns_registerBatch(DNS* dns, GQuark* ids, gchar** names, guint count, gchar* requestedIP);
 void dns_deregister(DNS* dns, Address* address);
 
 Address* dns_resolveIPToAddress(DNS* dns, guint32 ip);
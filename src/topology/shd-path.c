@@ -9,6 +9,11 @@
 struct _Path {
     gdouble latency;
     gdouble reliablity;
+
+    /* per-packet forms of the above, so scheduling needs no float math */
+    SimulationTime delay;
+    guint32 reliabilityThreshold;
+
     MAGIC_DECLARE;
 };
 
@@ -19,6 +24,17 @@ Path* path_new(gdouble latency, gdouble reliablity) {
     path->latency = latency;
     path->reliablity = reliablity;
 
+    path->delay = (SimulationTime) ceil(latency * SIMTIME_ONE_MILLISECOND);
+
+    /* a packet survives if a uniform 32 bit draw is at most the threshold */
+    if(reliablity >= 1.0f) {
+        path->reliabilityThreshold = G_MAXUINT32;
+    } else if(reliablity <= 0.0f) {
+        path->reliabilityThreshold = 0;
+    } else {
+        path->reliabilityThreshold = (guint32) (reliablity * (gdouble)G_MAXUINT32);
+    }
+
     return path;
 }
 
@@ -38,3 +54,13 @@ gdouble path_getReliability(Path* path) {
     MAGIC_ASSERT(path);
     return path->reliablity;
 }
+
+SimulationTime path_getDelay(Path* path) {
+    MAGIC_ASSERT(path);
+    return path->delay;
+}
+
+guint32 path_getReliabilityThreshold(Path* path) {
+    MAGIC_ASSERT(path);
+    return path->reliabilityThreshold;
+}
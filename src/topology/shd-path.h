@@ -11,9 +11,11 @@
 
 typedef struct _Path Path;
 
-Path* path_new();
+Path* path_new(gdouble latency, gdouble reliablity);
 void path_free(Path* path);
 gdouble path_getLatency(Path* path);
 gdouble path_getReliability(Path* path);
+SimulationTime path_getDelay(Path* path);
+guint32 path_getReliabilityThreshold(Path* path);
 
 #endif /* SHD_PATH_H_ */
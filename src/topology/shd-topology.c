@@ -6,6 +6,15 @@
 
 #include "shadow.h"
 
+typedef struct _TopologySnapshot TopologySnapshot;
+struct _TopologySnapshot {
+    /* virtualIP->vertexIndex (stored as pointer) */
+    GHashTable* virtualIP;
+    /* srcVertexIndex->dstVertexIndex->Path*. the per-source tables are never modified
+     * after publication, so unchanged sources are shared with the next snapshot */
+    GHashTable* pathCache;
+};
+
 struct _Topology {
     /* the imported igraph graph data - operations on it after initializations
      * MUST be locked in cases where igraph is not thread-safe! */
@@ -13,22 +22,36 @@ struct _Topology {
     GMutex graphLock;
 
     /* the edge weights currently used when computing shortest paths.
-     * this is protected by its own lock */
+     * these are only written while the topology is being created */
     igraph_vector_t* edgeWeights;
-    GRWLock edgeWeightsLock;
+
+    /* an immutable copy of the attachments and cached paths that workers read without
+     * taking any locks. a new copy is only swapped in at execution window barriers,
+     * when no worker is reading, so the old one can be reclaimed immediately */
+    TopologySnapshot* snapshot;
+
+    /******/
+    /* START - items protected by the cache lock. these are the authoritative
+     * tables that we fall back to when a lookup misses in the snapshot */
+    GMutex cacheLock;
 
     /* each connected virtual host is assigned to a PoI vertex. we store the mapping to the
      * vertex index so we can correctly lookup the assigned edge when computing latency.
      * virtualIP->vertexIndex (stored as pointer) */
     GHashTable* virtualIP;
-    GRWLock virtualIPLock;
 
     /* cached latencies to avoid excessive shortest path lookups
      * store a cache table for every connected address
      * fromAddress->toAddress->Path* */
     GHashTable* pathCache;
     gdouble minimumPathLatency;
-    GRWLock pathCacheLock;
+
+    /* what changed since the last snapshot was published */
+    GHashTable* dirtySources;
+    gboolean isVirtualIPDirty;
+
+    /* END cache lock */
+    /******/
 
     /******/
     /* START - items protected by a global topology lock */
@@ -400,7 +423,6 @@ static gboolean _topology_extractEdgeWeights(Topology* top) {
     MAGIC_ASSERT(top);
 
     _topology_lockGraph(top);
-    g_rw_lock_writer_lock(&(top->edgeWeightsLock));
 
     /* create new or clear existing edge weights */
     if(!top->edgeWeights) {
@@ -413,7 +435,6 @@ static gboolean _topology_extractEdgeWeights(Topology* top) {
     /* now we have fresh memory */
     gint result = igraph_vector_init(top->edgeWeights, (glong) top->edgeCount);
     if(result != IGRAPH_SUCCESS) {
-        g_rw_lock_writer_unlock(&(top->edgeWeightsLock));
         _topology_unlockGraph(top);
         critical("igraph_vector_init return non-success code %i", result);
         return FALSE;
@@ -421,7 +442,6 @@ static gboolean _topology_extractEdgeWeights(Topology* top) {
 
     /* use the 'latency' edge attribute as the edge weight */
     result = EANV(&top->graph, "latency", top->edgeWeights);
-    g_rw_lock_writer_unlock(&(top->edgeWeightsLock));
     _topology_unlockGraph(top);
     if(result != IGRAPH_SUCCESS) {
         critical("igraph_cattribute_EANV return non-success code %i", result);
@@ -431,14 +451,22 @@ static gboolean _topology_extractEdgeWeights(Topology* top) {
     return TRUE;
 }
 
+static void _topology_freeSnapshot(TopologySnapshot* snapshot) {
+    if(snapshot) {
+        g_hash_table_unref(snapshot->virtualIP);
+        g_hash_table_unref(snapshot->pathCache);
+        g_free(snapshot);
+    }
+}
+
+/* @warning top->cacheLock must be held when calling this function!! */
 static void _topology_clearCache(Topology* top) {
     MAGIC_ASSERT(top);
-    g_rw_lock_writer_lock(&(top->pathCacheLock));
     if(top->pathCache) {
         g_hash_table_destroy(top->pathCache);
         top->pathCache = NULL;
     }
-    g_rw_lock_writer_unlock(&(top->pathCacheLock));
+    g_hash_table_remove_all(top->dirtySources);
 
     /* lock the read on the shortest path info */
     g_mutex_lock(&(top->topologyLock));
@@ -447,39 +475,37 @@ static void _topology_clearCache(Topology* top) {
     g_mutex_unlock(&(top->topologyLock));
 }
 
-static Path* _topology_getPathFromCache(Topology* top, igraph_integer_t srcVertexIndex,
+static Path* _topology_lookupPathTable(GHashTable* pathCache, igraph_integer_t srcVertexIndex,
         igraph_integer_t dstVertexIndex) {
-    MAGIC_ASSERT(top);
-
-    Path* path = NULL;
-    g_rw_lock_reader_lock(&(top->pathCacheLock));
-
-    if(top->pathCache) {
+    if(pathCache) {
         /* look for the source first level cache */
-        gpointer sourceCache = g_hash_table_lookup(top->pathCache, GINT_TO_POINTER(srcVertexIndex));
+        GHashTable* sourceCache = g_hash_table_lookup(pathCache, GINT_TO_POINTER(srcVertexIndex));
 
         if(sourceCache) {
             /* check for the path to destination in source cache */
-            path = g_hash_table_lookup(sourceCache, GINT_TO_POINTER(dstVertexIndex));
+            return g_hash_table_lookup(sourceCache, GINT_TO_POINTER(dstVertexIndex));
         }
     }
 
-    g_rw_lock_reader_unlock(&(top->pathCacheLock));
-
     /* NULL if cache miss */
-    return path;
+    return NULL;
+}
+
+/* @warning top->cacheLock must be held when calling this function!! */
+static Path* _topology_getPathFromCache(Topology* top, igraph_integer_t srcVertexIndex,
+        igraph_integer_t dstVertexIndex) {
+    MAGIC_ASSERT(top);
+    return _topology_lookupPathTable(top->pathCache, srcVertexIndex, dstVertexIndex);
 }
 
-static void _topology_storePathInCache(Topology* top, igraph_integer_t srcVertexIndex,
+/* returns TRUE if the path lowered the minimum path latency, which the caller
+ * must pass on to the worker after releasing the lock.
+ * @warning top->cacheLock must be held when calling this function!! */
+static gboolean _topology_storePathInCache(Topology* top, igraph_integer_t srcVertexIndex,
         igraph_integer_t dstVertexIndex, igraph_real_t totalLatency, igraph_real_t totalReliability) {
     MAGIC_ASSERT(top);
 
     gdouble latencyMS = (gdouble) totalLatency;
-    gboolean wasUpdated = FALSE;
-
-    Path* path = path_new(latencyMS, (gdouble) totalReliability);
-
-    g_rw_lock_writer_lock(&(top->pathCacheLock));
 
     /* create latency cache on the fly */
     if(!top->pathCache) {
@@ -494,23 +520,27 @@ static void _topology_storePathInCache(Topology* top, igraph_integer_t srcVertex
         g_hash_table_replace(top->pathCache, GINT_TO_POINTER(srcVertexIndex), sourceCache);
     }
 
+    /* published snapshots may still point at a path we already cached, so never replace it.
+     * recomputing the same path gives the same result anyway. */
+    if(g_hash_table_contains(sourceCache, GINT_TO_POINTER(dstVertexIndex))) {
+        return FALSE;
+    }
+
     /* now cache this sources path to the destination */
+    Path* path = path_new(latencyMS, (gdouble) totalReliability);
     g_hash_table_replace(sourceCache, GINT_TO_POINTER(dstVertexIndex), path);
+    g_hash_table_add(top->dirtySources, GINT_TO_POINTER(srcVertexIndex));
 
     /* track the minimum network latency in the entire graph */
     if(top->minimumPathLatency == 0 || latencyMS < top->minimumPathLatency) {
         top->minimumPathLatency = latencyMS;
-        wasUpdated = TRUE;
+        return TRUE;
     }
 
-    g_rw_lock_writer_unlock(&(top->pathCacheLock));
-
-    /* make sure the worker knows the new min latency */
-    if(wasUpdated) {
-        worker_updateMinTimeJump(top->minimumPathLatency);
-    }
+    return FALSE;
 }
 
+/* @warning top->cacheLock must be held when calling this function!! */
 static igraph_integer_t _topology_getConnectedVertexIndex(Topology* top, Address* address) {
     MAGIC_ASSERT(top);
 
@@ -518,9 +548,7 @@ static igraph_integer_t _topology_getConnectedVertexIndex(Topology* top, Address
     gpointer vertexIndexPtr = NULL;
     in_addr_t ip = address_toNetworkIP(address);
 
-    g_rw_lock_reader_lock(&(top->virtualIPLock));
     gboolean found = g_hash_table_lookup_extended(top->virtualIP, GUINT_TO_POINTER(ip), NULL, &vertexIndexPtr);
-    g_rw_lock_reader_unlock(&(top->virtualIPLock));
 
     if(!found) {
         warning("address %s is not connected to the topology", address_toHostIPString(address));
@@ -558,8 +586,23 @@ static gint _topology_getEdgeHelper(Topology* top, igraph_integer_t fromVertexIn
     return IGRAPH_SUCCESS;
 }
 
+/* a path computed outside of the cache lock, waiting to be stored in the cache */
+typedef struct _ComputedPath ComputedPath;
+struct _ComputedPath {
+    igraph_integer_t srcVertexIndex;
+    igraph_integer_t dstVertexIndex;
+    igraph_real_t totalLatency;
+    igraph_real_t totalReliability;
+};
+
+static void _topology_addComputedPath(GArray* computedPaths, igraph_integer_t srcVertexIndex,
+        igraph_integer_t dstVertexIndex, igraph_real_t totalLatency, igraph_real_t totalReliability) {
+    ComputedPath computed = {srcVertexIndex, dstVertexIndex, totalLatency, totalReliability};
+    g_array_append_val(computedPaths, computed);
+}
+
 static gboolean _topology_computeSourcePathsHelper(Topology* top, igraph_integer_t srcVertexIndex,
-        igraph_vector_t* resultPathVertices) {
+        igraph_vector_t* resultPathVertices, GArray* computedPaths) {
     MAGIC_ASSERT(top);
 
     /* each position represents a single destination.
@@ -664,14 +707,14 @@ static gboolean _topology_computeSourcePathsHelper(Topology* top, igraph_integer
 
     g_string_free(pathString, TRUE);
 
-    /* cache the latency and reliability we just computed */
-    _topology_storePathInCache(top, srcVertexIndex, dstVertexIndex, totalLatency, totalReliability);
+    /* the caller caches the latency and reliability we just computed */
+    _topology_addComputedPath(computedPaths, srcVertexIndex, dstVertexIndex, totalLatency, totalReliability);
 
     return TRUE;
 }
 
 static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t srcVertexIndex,
-        igraph_integer_t dstVertexIndex) {
+        igraph_integer_t dstVertexIndex, GList* attachedTargets, GArray* computedPaths) {
     MAGIC_ASSERT(top);
     utility_assert(srcVertexIndex >= 0);
     utility_assert(dstVertexIndex >= 0);
@@ -685,13 +728,8 @@ static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t src
             (glong)srcVertexIndex, srcIDStr, (glong)dstVertexIndex, dstIDStr);
 
     /* we are going to compute shortest path from the source to all attached destinations
-     * (including dstAddress) in order to cut down on the the number of dijkstra runs we do */
-    g_rw_lock_reader_lock(&(top->virtualIPLock));
-    GList* attachedTargets = g_hash_table_get_values(top->virtualIP);
-    g_rw_lock_reader_unlock(&(top->virtualIPLock));
-
-    /* normally we should hold the lock while modifying the list, but since the virtualIPLock
-     * hash table stores vertex indices in pointers, this should be OK. */
+     * (including dstAddress) in order to cut down on the the number of dijkstra runs we do.
+     * the caller copied the attachments while holding the cache lock. */
     guint numTargets = g_list_length(attachedTargets);
 
     /* initialize vector to hold intended destinations */
@@ -751,7 +789,6 @@ static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t src
             (glong)srcVertexIndex, srcIDStr);
 
     _topology_lockGraph(top);
-    g_rw_lock_reader_lock(&(top->edgeWeightsLock));
 
     /* time the dijkstra algorithm */
     GTimer* pathTimer = g_timer_new();
@@ -783,7 +820,6 @@ static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t src
     /* track the time spent running the algorithm */
     gdouble elapsedSeconds = g_timer_elapsed(pathTimer, NULL);
 
-    g_rw_lock_reader_unlock(&(top->edgeWeightsLock));
     _topology_unlockGraph(top);
 
     g_timer_destroy(pathTimer);
@@ -813,7 +849,7 @@ static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t src
             foundDstPosition = TRUE;
         }
 
-        gboolean success = _topology_computeSourcePathsHelper(top, srcVertexIndex, resultPathVertices);
+        gboolean success = _topology_computeSourcePathsHelper(top, srcVertexIndex, resultPathVertices, computedPaths);
         if(!success) {
             allSuccess = FALSE;
         }
@@ -833,7 +869,7 @@ static gboolean _topology_computeSourcePaths(Topology* top, igraph_integer_t src
 }
 
 static gboolean _topology_lookupPath(Topology* top, igraph_integer_t srcVertexIndex,
-        igraph_integer_t dstVertexIndex) {
+        igraph_integer_t dstVertexIndex, GArray* computedPaths) {
     MAGIC_ASSERT(top);
 
     /* for complete graphs, we lookup the edge and use it as the path instead
@@ -866,52 +902,125 @@ static gboolean _topology_lookupPath(Topology* top, igraph_integer_t srcVertexIn
     totalLatency += edgeLatency;
     totalReliability *= edgeReliability;
 
-    /* cache the latency and reliability we just computed */
-    _topology_storePathInCache(top, srcVertexIndex, dstVertexIndex, totalLatency, totalReliability);
+    /* the caller caches the latency and reliability we just computed */
+    _topology_addComputedPath(computedPaths, srcVertexIndex, dstVertexIndex, totalLatency, totalReliability);
 
     return TRUE;
 }
 
 
-static gboolean _topology_getPathEntry(Topology* top, Address* srcAddress, Address* dstAddress,
-        gdouble* latency, gdouble* reliability) {
+static Path* _topology_getPathFromSnapshot(Topology* top, Address* srcAddress, Address* dstAddress) {
+    MAGIC_ASSERT(top);
+
+    /* this is the common case, and must not write to any shared state */
+    TopologySnapshot* snapshot = g_atomic_pointer_get(&(top->snapshot));
+    if(!snapshot) {
+        return NULL;
+    }
+
+    gpointer srcVertexIndexPtr = NULL, dstVertexIndexPtr = NULL;
+    if(!g_hash_table_lookup_extended(snapshot->virtualIP,
+            GUINT_TO_POINTER(address_toNetworkIP(srcAddress)), NULL, &srcVertexIndexPtr) ||
+            !g_hash_table_lookup_extended(snapshot->virtualIP,
+            GUINT_TO_POINTER(address_toNetworkIP(dstAddress)), NULL, &dstVertexIndexPtr)) {
+        return NULL;
+    }
+
+    igraph_integer_t srcVertexIndex = (igraph_integer_t) GPOINTER_TO_INT(srcVertexIndexPtr);
+    igraph_integer_t dstVertexIndex = (igraph_integer_t) GPOINTER_TO_INT(dstVertexIndexPtr);
+
+    Path* path = _topology_lookupPathTable(snapshot->pathCache, srcVertexIndex, dstVertexIndex);
+    if(!path && !top->isDirected) {
+        path = _topology_lookupPathTable(snapshot->pathCache, dstVertexIndex, srcVertexIndex);
+    }
+    return path;
+}
+
+/* @warning top->cacheLock must be held when calling this function!! */
+static Path* _topology_getCachedPath(Topology* top, igraph_integer_t srcVertexIndex,
+        igraph_integer_t dstVertexIndex) {
+    Path* path = _topology_getPathFromCache(top, srcVertexIndex, dstVertexIndex);
+    if(!path && !top->isDirected) {
+        path = _topology_getPathFromCache(top, dstVertexIndex, srcVertexIndex);
+    }
+    return path;
+}
+
+/* takes the cache lock only to read and update the cache, so that lookups by
+ * other workers do not wait for our shortest path computation */
+static Path* _topology_findPath(Topology* top, Address* srcAddress, Address* dstAddress) {
     MAGIC_ASSERT(top);
 
+    g_mutex_lock(&(top->cacheLock));
+
     /* get connected points */
     igraph_integer_t srcVertexIndex = _topology_getConnectedVertexIndex(top, srcAddress);
+    igraph_integer_t dstVertexIndex = _topology_getConnectedVertexIndex(top, dstAddress);
+
+    /* check for a cache hit */
+    Path* path = NULL;
+    GList* attachedTargets = NULL;
+    if(srcVertexIndex >= 0 && dstVertexIndex >= 0) {
+        path = _topology_getCachedPath(top, srcVertexIndex, dstVertexIndex);
+        if(!path && !top->isComplete) {
+            attachedTargets = g_hash_table_get_values(top->virtualIP);
+        }
+    }
+
+    g_mutex_unlock(&(top->cacheLock));
+
     if(srcVertexIndex < 0) {
         critical("invalid vertex %i, source address %s is not connected to topology",
                 (gint)srcVertexIndex, address_toString(srcAddress));
-        return FALSE;
+        return NULL;
     }
-    igraph_integer_t dstVertexIndex = _topology_getConnectedVertexIndex(top, dstAddress);
     if(dstVertexIndex < 0) {
         critical("invalid vertex %i, destination address %s is not connected to topology",
                 (gint)dstVertexIndex, address_toString(dstAddress));
-        return FALSE;
-    }
-
-    /* check for a cache hit */
-    Path* path = _topology_getPathFromCache(top, srcVertexIndex, dstVertexIndex);
-    if(!path && !top->isDirected) {
-        path = _topology_getPathFromCache(top, dstVertexIndex, srcVertexIndex);
+        return NULL;
     }
 
     if(!path) {
-        /* cache miss, lets find the path */
+        /* cache miss, lets find the path without holding the cache lock */
+        GArray* computedPaths = g_array_new(FALSE, FALSE, sizeof(ComputedPath));
         gboolean success = FALSE;
 
         if(top->isComplete) {
             /* use the edge between src and dst as the path */
-            success = _topology_lookupPath(top, srcVertexIndex, dstVertexIndex);
+            success = _topology_lookupPath(top, srcVertexIndex, dstVertexIndex, computedPaths);
         } else {
             /* use shortest path over the network graph */
-            success = _topology_computeSourcePaths(top, srcVertexIndex, dstVertexIndex);
+            success = _topology_computeSourcePaths(top, srcVertexIndex, dstVertexIndex,
+                    attachedTargets, computedPaths);
         }
 
+        /* another worker may have cached some of the same paths meanwhile, which
+         * the cache ignores since they are identical */
+        gdouble minimumPathLatency = 0;
+        g_mutex_lock(&(top->cacheLock));
+        for(guint i = 0; i < computedPaths->len; i++) {
+            ComputedPath* computed = &g_array_index(computedPaths, ComputedPath, i);
+            if(_topology_storePathInCache(top, computed->srcVertexIndex, computed->dstVertexIndex,
+                    computed->totalLatency, computed->totalReliability)) {
+                minimumPathLatency = top->minimumPathLatency;
+            }
+        }
         if(success) {
-            path = _topology_getPathFromCache(top, srcVertexIndex, dstVertexIndex);
+            path = _topology_getCachedPath(top, srcVertexIndex, dstVertexIndex);
         }
+        g_mutex_unlock(&(top->cacheLock));
+
+        /* make sure the worker knows the new min latency, without nesting its
+         * locks inside ours. the master keeps the lowest of concurrent updates. */
+        if(minimumPathLatency > 0) {
+            worker_updateMinTimeJump(minimumPathLatency);
+        }
+
+        g_array_free(computedPaths, TRUE);
+    }
+
+    if(attachedTargets) {
+        g_list_free(attachedTargets);
     }
 
     if(!path) {
@@ -925,23 +1034,32 @@ static gboolean _topology_getPathEntry(Topology* top, Address* srcAddress, Addre
                 "and node %s at %s (vertex %i)",
                 address_toString(srcAddress), srcIDStr, (gint)srcVertexIndex,
                 address_toString(dstAddress), dstIDStr, (gint)dstVertexIndex);
-        return FALSE;
     }
 
-    if(latency) {
-        *latency = path_getLatency(path);
-    }
-    if(reliability) {
-        *reliability = path_getReliability(path);
+    return path;
+}
+
+Path* topology_getPath(Topology* top, Address* srcAddress, Address* dstAddress) {
+    MAGIC_ASSERT(top);
+
+    /* first try the published snapshot without locking */
+    Path* path = _topology_getPathFromSnapshot(top, srcAddress, dstAddress);
+
+    if(!path) {
+        /* the snapshot is missing the path or one of the attachments. paths are never removed
+         * from the authoritative cache while the topology exists, so its safe to use the
+         * path after the cache lock is released. */
+        path = _topology_findPath(top, srcAddress, dstAddress);
     }
-    return TRUE;
+
+    return path;
 }
 
 gdouble topology_getLatency(Topology* top, Address* srcAddress, Address* dstAddress) {
     MAGIC_ASSERT(top);
-    gdouble latency = 0;
-    if(_topology_getPathEntry(top, srcAddress, dstAddress, &latency, NULL)) {
-        return latency;
+    Path* path = topology_getPath(top, srcAddress, dstAddress);
+    if(path) {
+        return path_getLatency(path);
     } else {
         return (gdouble) -1;
     }
@@ -949,9 +1067,9 @@ gdouble topology_getLatency(Topology* top, Address* srcAddress, Address* dstAddr
 
 gdouble topology_getReliability(Topology* top, Address* srcAddress, Address* dstAddress) {
     MAGIC_ASSERT(top);
-    gdouble reliability = 0;
-    if(_topology_getPathEntry(top, srcAddress, dstAddress, NULL, &reliability)) {
-        return reliability;
+    Path* path = topology_getPath(top, srcAddress, dstAddress);
+    if(path) {
+        return path_getReliability(path);
     } else {
         return (gdouble) -1;
     }
@@ -1161,9 +1279,10 @@ void topology_attach(Topology* top, Address* address, Random* randomSourcePool,
             geocodeHint, typeHint);
 
     /* attach it, i.e. store the mapping so we can route later */
-    g_rw_lock_writer_lock(&(top->virtualIPLock));
+    g_mutex_lock(&(top->cacheLock));
     g_hash_table_replace(top->virtualIP, GUINT_TO_POINTER(nodeIP), GINT_TO_POINTER(vertexIndex));
-    g_rw_lock_writer_unlock(&(top->virtualIPLock));
+    top->isVirtualIPDirty = TRUE;
+    g_mutex_unlock(&(top->cacheLock));
 
     _topology_lockGraph(top);
 
@@ -1191,36 +1310,111 @@ void topology_detach(Topology* top, Address* address) {
     MAGIC_ASSERT(top);
     in_addr_t ip = address_toNetworkIP(address);
 
-    g_rw_lock_writer_lock(&(top->virtualIPLock));
+    g_mutex_lock(&(top->cacheLock));
     g_hash_table_remove(top->virtualIP, GUINT_TO_POINTER(ip));
-    g_rw_lock_writer_unlock(&(top->virtualIPLock));
+    top->isVirtualIPDirty = TRUE;
+    g_mutex_unlock(&(top->cacheLock));
+}
+
+static void _topology_copySnapshotEntry(gpointer key, gpointer value, GHashTable* copy) {
+    g_hash_table_replace(copy, key, value);
+}
+
+static void _topology_shareSnapshotSource(gpointer srcVertexIndexPtr, GHashTable* sourceCache,
+        TopologySnapshot* snapshot) {
+    /* sources without new paths were not modified, and can be shared */
+    if(!g_hash_table_contains(snapshot->pathCache, srcVertexIndexPtr)) {
+        g_hash_table_replace(snapshot->pathCache, srcVertexIndexPtr, g_hash_table_ref(sourceCache));
+    }
+}
+
+/* @warning this must only be called when no worker can be reading the topology,
+ * e.g., between execution windows or before the workers are started */
+void topology_publishSnapshot(Topology* top) {
+    MAGIC_ASSERT(top);
+
+    g_mutex_lock(&(top->cacheLock));
+
+    TopologySnapshot* oldSnapshot = top->snapshot;
+
+    if(oldSnapshot && !top->isVirtualIPDirty && g_hash_table_size(top->dirtySources) == 0) {
+        /* nothing changed since the last publish */
+        g_mutex_unlock(&(top->cacheLock));
+        return;
+    }
+
+    TopologySnapshot* snapshot = g_new0(TopologySnapshot, 1);
+
+    /* only copy the attachments if they changed */
+    if(oldSnapshot && !top->isVirtualIPDirty) {
+        snapshot->virtualIP = g_hash_table_ref(oldSnapshot->virtualIP);
+    } else {
+        snapshot->virtualIP = g_hash_table_new(g_direct_hash, g_direct_equal);
+        g_hash_table_foreach(top->virtualIP, (GHFunc)_topology_copySnapshotEntry, snapshot->virtualIP);
+    }
+
+    /* the snapshot paths are owned by the authoritative cache, which never removes them */
+    snapshot->pathCache = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)g_hash_table_unref);
+
+    /* fresh copies of the sources that got new paths */
+    GHashTableIter iter;
+    gpointer srcVertexIndexPtr = NULL;
+    g_hash_table_iter_init(&iter, top->dirtySources);
+    while(g_hash_table_iter_next(&iter, &srcVertexIndexPtr, NULL)) {
+        GHashTable* sourceCache = top->pathCache ? g_hash_table_lookup(top->pathCache, srcVertexIndexPtr) : NULL;
+        if(sourceCache) {
+            GHashTable* sourceCopy = g_hash_table_new(g_direct_hash, g_direct_equal);
+            g_hash_table_foreach(sourceCache, (GHFunc)_topology_copySnapshotEntry, sourceCopy);
+            g_hash_table_replace(snapshot->pathCache, srcVertexIndexPtr, sourceCopy);
+        }
+    }
+
+    if(oldSnapshot) {
+        g_hash_table_foreach(oldSnapshot->pathCache, (GHFunc)_topology_shareSnapshotSource, snapshot);
+    }
+
+    g_hash_table_remove_all(top->dirtySources);
+    top->isVirtualIPDirty = FALSE;
+
+    /* swap, and reclaim the old one now since nobody could be using it */
+    g_atomic_pointer_set(&(top->snapshot), snapshot);
+
+    g_mutex_unlock(&(top->cacheLock));
+
+    _topology_freeSnapshot(oldSnapshot);
+
+    debug("published topology snapshot with %u attachments and %u path sources",
+            g_hash_table_size(snapshot->virtualIP), g_hash_table_size(snapshot->pathCache));
 }
 
 void topology_free(Topology* top) {
     MAGIC_ASSERT(top);
 
+    /* nobody is reading at this point */
+    _topology_freeSnapshot(top->snapshot);
+    top->snapshot = NULL;
+
+    g_mutex_lock(&(top->cacheLock));
+
     /* clear the virtual ip table */
-    g_rw_lock_writer_lock(&(top->virtualIPLock));
     if(top->virtualIP) {
         g_hash_table_destroy(top->virtualIP);
         top->virtualIP = NULL;
     }
-    g_rw_lock_writer_unlock(&(top->virtualIPLock));
-    g_rw_lock_clear(&(top->virtualIPLock));
 
-    /* this functions grabs and releases the pathCache write lock */
     _topology_clearCache(top);
-    g_rw_lock_clear(&(top->pathCacheLock));
+    g_hash_table_destroy(top->dirtySources);
+    top->dirtySources = NULL;
+
+    g_mutex_unlock(&(top->cacheLock));
+    g_mutex_clear(&(top->cacheLock));
 
     /* clear the stored edge weights */
-    g_rw_lock_writer_lock(&(top->edgeWeightsLock));
     if(top->edgeWeights) {
         igraph_vector_destroy(top->edgeWeights);
         g_free(top->edgeWeights);
         top->edgeWeights = NULL;
     }
-    g_rw_lock_writer_unlock(&(top->edgeWeightsLock));
-    g_rw_lock_clear(&(top->edgeWeightsLock));
 
     /* clear the graph */
     _topology_lockGraph(top);
@@ -1240,12 +1434,11 @@ Topology* topology_new(const gchar* graphPath) {
     MAGIC_INIT(top);
 
     top->virtualIP = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, NULL);
+    top->dirtySources = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     _topology_initGraphLock(&(top->graphLock));
     g_mutex_init(&(top->topologyLock));
-    g_rw_lock_init(&(top->edgeWeightsLock));
-    g_rw_lock_init(&(top->virtualIPLock));
-    g_rw_lock_init(&(top->pathCacheLock));
+    g_mutex_init(&(top->cacheLock));
 
     /* first read in the graph and make sure its formed correctly,
      * then setup our edge weights for shortest path */
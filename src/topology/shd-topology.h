@@ -17,8 +17,12 @@ void topology_free(Topology* top);
 void topology_attach(Topology* top, Address* address, Random* randomSourcePool,
         gchar* ipHint, gchar* geocodeHint, gchar* typeHint, guint64* bwDownOut, guint64* bwUpOut);
 void topology_detach(Topology* top, Address* address);
+/* the returned path is owned by the topology and stays valid until the topology is freed,
+ * so it may be cached by callers that need repeated lookups for the same address pair */
+Path* topology_getPath(Topology* top, Address* srcAddress, Address* dstAddress);
 gboolean topology_isRoutable(Topology* top, Address* srcAddress, Address* dstAddress);
 gdouble topology_getLatency(Topology* top, Address* srcAddress, Address* dstAddress);
 gdouble topology_getReliability(Topology* top, Address* srcAddress, Address* dstAddress);
+void topology_publishSnapshot(Topology* top);
 
 #endif /* SHD_TOPOLOGY_H_ */
@@ -0,0 +1,376 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "shd-utility.h"
+#include "shd-arena.h"
+
+/* slabs are mapped directly, and recycled through the free lists. pages of a
+ * slab are only backed once a chunk in them is used, so the size mostly
+ * bounds how often we take the page map lock. */
+#define ARENA_SLAB_SIZE (4*1024*1024)
+#define ARENA_ALIGNMENT 16
+/* 8 classes in 16 byte steps up to 128 bytes, then 4 classes per doubling.
+ * like the mmap threshold of glibc, chunks above that get their own mapping. */
+#define ARENA_NUM_CLASSES 60
+#define ARENA_MAX_CLASS_SIZE (1024*1024)
+#define ARENA_CLASS_LARGE 0xFFFF
+
+/* the tag of a chunk tells whether it is live or in a free list */
+#define ARENA_TAG_MASK G_GUINT64_CONSTANT(0xFFFFFFFFFFFF0000)
+#define ARENA_TAG_LIVE G_GUINT64_CONSTANT(0xA7E4A11C0DE50000)
+#define ARENA_TAG_FREE G_GUINT64_CONSTANT(0xA7E4AF7EEC0D0000)
+
+/* the owner of every page that an arena mapped, in a three level radix tree
+ * over the 48 bit address space. it only ever grows, so lookups need no lock. */
+#define ARENA_PAGE_SHIFT 12
+#define ARENA_ADDRESS_BITS 48
+#define ARENA_MAP_BITS 12
+#define ARENA_MAP_SIZE (1 << ARENA_MAP_BITS)
+#define ARENA_MAP_INDEX(page, level) \
+    ((guint)(((page) >> ((2 - (level)) * ARENA_MAP_BITS)) & (ARENA_MAP_SIZE - 1)))
+
+typedef struct _ArenaChunk ArenaChunk;
+typedef struct _ArenaLargeChunk ArenaLargeChunk;
+typedef struct _ArenaSlab ArenaSlab;
+
+/* placed immediately in front of every chunk */
+struct _ArenaChunk {
+    /* the size the caller asked for */
+    gsize requestedSize;
+    guint64 tag;
+};
+
+/* placed in front of the header of chunks that get their own mapping. when
+ * released, the mapping stays with the arena so it can be reused and a second
+ * release is still recognized, but its pages are given back. */
+struct _ArenaLargeChunk {
+    ArenaLargeChunk* prev;
+    ArenaLargeChunk* next;
+    gpointer map;
+    gsize mapSize;
+    /* usable bytes from the chunk to the end of the mapping */
+    gsize size;
+    gsize padding;
+};
+
+struct _ArenaSlab {
+    ArenaSlab* next;
+    gsize padding;
+};
+
+struct _Arena {
+    /* released chunks of each class, linked through their first word */
+    gpointer freeLists[ARENA_NUM_CLASSES];
+    /* unused space at the end of the newest slab */
+    gchar* bump;
+    gchar* bumpEnd;
+    ArenaSlab* slabs;
+    ArenaLargeChunk* largeChunks;
+    ArenaLargeChunk* freeLargeChunks;
+    MAGIC_DECLARE;
+};
+
+#define _HEADER(ptr) (((ArenaChunk*)(ptr)) - 1)
+#define _LARGE_HEADER(ptr) (((ArenaLargeChunk*)_HEADER(ptr)) - 1)
+#define _LARGE_CHUNK(large) ((gpointer)(((ArenaChunk*)((large) + 1)) + 1))
+
+static gpointer* arenaPageMap[ARENA_MAP_SIZE];
+G_LOCK_DEFINE_STATIC(arenaPageMapLock);
+
+/* sets the owner of all pages in [start, start+length) */
+static void _arena_mapPages(gpointer start, gsize length, Arena* owner) {
+    guintptr first = ((guintptr)start) >> ARENA_PAGE_SHIFT;
+    guintptr last = (((guintptr)start) + length - 1) >> ARENA_PAGE_SHIFT;
+    utility_assert((((guintptr)start) + length - 1) >> ARENA_ADDRESS_BITS == 0);
+
+    G_LOCK(arenaPageMapLock);
+    for(guintptr page = first; page <= last; page++) {
+        gpointer* level1 = g_atomic_pointer_get(&arenaPageMap[ARENA_MAP_INDEX(page, 0)]);
+        if(!level1) {
+            level1 = g_new0(gpointer, ARENA_MAP_SIZE);
+            g_atomic_pointer_set(&arenaPageMap[ARENA_MAP_INDEX(page, 0)], level1);
+        }
+        Arena** level2 = g_atomic_pointer_get(&level1[ARENA_MAP_INDEX(page, 1)]);
+        if(!level2) {
+            level2 = g_new0(Arena*, ARENA_MAP_SIZE);
+            g_atomic_pointer_set(&level1[ARENA_MAP_INDEX(page, 1)], level2);
+        }
+        g_atomic_pointer_set(&level2[ARENA_MAP_INDEX(page, 2)], owner);
+    }
+    G_UNLOCK(arenaPageMapLock);
+}
+
+static gpointer _arena_mapMemory(Arena* arena, gsize length) {
+    gpointer map = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED) {
+        return NULL;
+    }
+    _arena_mapPages(map, length, arena);
+    return map;
+}
+
+static void _arena_unmapMemory(gpointer map, gsize length) {
+    _arena_mapPages(map, length, NULL);
+    munmap(map, length);
+}
+
+static gsize _arena_getClassSize(guint class) {
+    if(class < 8) {
+        return (class + 1) * 16;
+    }
+    guint shift = 7 + (class - 8) / 4;
+    guint sub = (class - 8) % 4;
+    return (((gsize)1) << shift) + (sub + 1) * (((gsize)1) << (shift - 2));
+}
+
+static guint _arena_getClass(gsize size) {
+    if(size <= 128) {
+        return size == 0 ? 0 : (guint)((size - 1) / 16);
+    }
+    /* size is in (2^shift, 2^(shift+1)] */
+    guint shift = g_bit_storage(size - 1) - 1;
+    guint sub = (guint)((size - 1 - (((gsize)1) << shift)) >> (shift - 2));
+    return 8 + (shift - 7) * 4 + sub;
+}
+
+Arena* arena_new() {
+    Arena* arena = g_new0(Arena, 1);
+    MAGIC_INIT(arena);
+    return arena;
+}
+
+void arena_free(Arena* arena) {
+    MAGIC_ASSERT(arena);
+
+    while(arena->slabs) {
+        ArenaSlab* slab = arena->slabs;
+        arena->slabs = slab->next;
+        _arena_unmapMemory(slab, ARENA_SLAB_SIZE);
+    }
+
+    ArenaLargeChunk** lists[] = {&arena->largeChunks, &arena->freeLargeChunks};
+    for(guint i = 0; i < G_N_ELEMENTS(lists); i++) {
+        while(*lists[i]) {
+            ArenaLargeChunk* large = *lists[i];
+            *lists[i] = large->next;
+            _arena_unmapMemory(large->map, large->mapSize);
+        }
+    }
+
+    MAGIC_CLEAR(arena);
+    g_free(arena);
+}
+
+static void _arena_pushLarge(ArenaLargeChunk** list, ArenaLargeChunk* large) {
+    large->prev = NULL;
+    large->next = *list;
+    if(*list) {
+        (*list)->prev = large;
+    }
+    *list = large;
+}
+
+static void _arena_unlinkLarge(ArenaLargeChunk** list, ArenaLargeChunk* large) {
+    if(large->prev) {
+        large->prev->next = large->next;
+    } else {
+        *list = large->next;
+    }
+    if(large->next) {
+        large->next->prev = large->prev;
+    }
+}
+
+/* the first page that is released while the chunk is free, the header and
+ * anything else in front of it stays in place */
+static gchar* _arena_getLargeReleaseStart(gpointer ptr) {
+    gsize pageSize = ((gsize)1) << ARENA_PAGE_SHIFT;
+    return (gchar*)((((guintptr)ptr) + pageSize - 1) & ~((guintptr)pageSize - 1));
+}
+
+/* a released mapping that fits without wasting more than it holds */
+static ArenaLargeChunk* _arena_findFreeLarge(Arena* arena, gsize alignment, gsize size, gsize mapSize) {
+    for(ArenaLargeChunk* large = arena->freeLargeChunks; large; large = large->next) {
+        gpointer ptr = _LARGE_CHUNK(large);
+        if(large->size >= size && large->mapSize / 2 <= mapSize &&
+                (((guintptr)ptr) & ((guintptr)alignment - 1)) == 0) {
+            return large;
+        }
+    }
+    return NULL;
+}
+
+static gpointer _arena_allocLarge(Arena* arena, gsize alignment, gsize size, gboolean clear) {
+    alignment = MAX(alignment, ARENA_ALIGNMENT);
+    gsize overhead = sizeof(ArenaLargeChunk) + sizeof(ArenaChunk);
+    gsize pageSize = ((gsize)1) << ARENA_PAGE_SHIFT;
+
+    /* room to move the chunk up to the requested alignment */
+    gsize padding = alignment > ARENA_ALIGNMENT ? alignment : 0;
+    if(size > G_MAXSIZE - overhead - padding - pageSize) {
+        return NULL;
+    }
+    gsize mapSize = (size + overhead + padding + pageSize - 1) & ~(pageSize - 1);
+
+    gpointer ptr = NULL;
+    ArenaLargeChunk* large = _arena_findFreeLarge(arena, alignment, size, mapSize);
+    if(large) {
+        _arena_unlinkLarge(&arena->freeLargeChunks, large);
+        ptr = _LARGE_CHUNK(large);
+        if(clear) {
+            /* the released pages come back clear */
+            gchar* released = _arena_getLargeReleaseStart(ptr);
+            memset(ptr, 0, MIN(size, (gsize)(released - (gchar*)ptr)));
+        }
+    } else {
+        /* fresh mappings are already clear */
+        gpointer map = _arena_mapMemory(arena, mapSize);
+        if(!map) {
+            return NULL;
+        }
+
+        guintptr start = (guintptr)map + overhead;
+        ptr = (gpointer)((start + alignment - 1) & ~((guintptr)alignment - 1));
+
+        large = _LARGE_HEADER(ptr);
+        large->map = map;
+        large->mapSize = mapSize;
+        large->size = (gsize)(((gchar*)map + mapSize) - (gchar*)ptr);
+    }
+
+    _arena_pushLarge(&arena->largeChunks, large);
+    _HEADER(ptr)->tag = ARENA_TAG_LIVE | ARENA_CLASS_LARGE;
+    return ptr;
+}
+
+static gpointer _arena_allocSmall(Arena* arena, guint class) {
+    gpointer ptr = arena->freeLists[class];
+    if(ptr) {
+        arena->freeLists[class] = *((gpointer*)ptr);
+    } else {
+        gsize needed = sizeof(ArenaChunk) + _arena_getClassSize(class);
+        if(arena->bump == NULL || (gsize)(arena->bumpEnd - arena->bump) < needed) {
+            /* the tail of the old slab is abandoned */
+            ArenaSlab* slab = _arena_mapMemory(arena, ARENA_SLAB_SIZE);
+            if(!slab) {
+                return NULL;
+            }
+            slab->next = arena->slabs;
+            arena->slabs = slab;
+            arena->bump = (gchar*)(slab + 1);
+            arena->bumpEnd = ((gchar*)slab) + ARENA_SLAB_SIZE;
+        }
+        ptr = arena->bump + sizeof(ArenaChunk);
+        arena->bump += needed;
+    }
+
+    _HEADER(ptr)->tag = ARENA_TAG_LIVE | class;
+    return ptr;
+}
+
+gpointer arena_alloc(Arena* arena, gsize size, gboolean clear) {
+    MAGIC_ASSERT(arena);
+
+    gpointer ptr = NULL;
+    if(size <= ARENA_MAX_CLASS_SIZE) {
+        ptr = _arena_allocSmall(arena, _arena_getClass(size));
+        if(ptr && clear) {
+            memset(ptr, 0, arena_getChunkSize(ptr));
+        }
+    } else {
+        ptr = _arena_allocLarge(arena, ARENA_ALIGNMENT, size, clear);
+    }
+
+    if(ptr) {
+        _HEADER(ptr)->requestedSize = size;
+    }
+    return ptr;
+}
+
+gpointer arena_allocAligned(Arena* arena, gsize alignment, gsize size) {
+    MAGIC_ASSERT(arena);
+    utility_assert((alignment & (alignment - 1)) == 0);
+
+    if(alignment <= ARENA_ALIGNMENT) {
+        return arena_alloc(arena, size, FALSE);
+    }
+
+    gpointer ptr = _arena_allocLarge(arena, alignment, size, FALSE);
+    if(ptr) {
+        _HEADER(ptr)->requestedSize = size;
+    }
+    return ptr;
+}
+
+gboolean arena_release(Arena* arena, gpointer ptr) {
+    MAGIC_ASSERT(arena);
+    utility_assert(arena_getOwner(ptr) == arena);
+    ArenaChunk* header = _HEADER(ptr);
+
+    if((header->tag & ARENA_TAG_MASK) != ARENA_TAG_LIVE) {
+        /* double free */
+        return FALSE;
+    }
+
+    guint class = (guint)(header->tag & ~ARENA_TAG_MASK);
+    if(class == ARENA_CLASS_LARGE) {
+        /* keep the mapping, and with it the tag, but not the memory behind it */
+        ArenaLargeChunk* large = _LARGE_HEADER(ptr);
+        _arena_unlinkLarge(&arena->largeChunks, large);
+        gchar* released = _arena_getLargeReleaseStart(ptr);
+        gchar* end = ((gchar*)large->map) + large->mapSize;
+        if(released < end) {
+            madvise(released, (gsize)(end - released), MADV_DONTNEED);
+        }
+        header->tag = ARENA_TAG_FREE | class;
+        _arena_pushLarge(&arena->freeLargeChunks, large);
+    } else {
+        header->tag = ARENA_TAG_FREE | class;
+        *((gpointer*)ptr) = arena->freeLists[class];
+        arena->freeLists[class] = ptr;
+    }
+
+    return TRUE;
+}
+
+Arena* arena_getOwner(gconstpointer ptr) {
+    guintptr page = ((guintptr)ptr) >> ARENA_PAGE_SHIFT;
+    if(page >> (ARENA_ADDRESS_BITS - ARENA_PAGE_SHIFT)) {
+        return NULL;
+    }
+
+    gpointer* level1 = g_atomic_pointer_get(&arenaPageMap[ARENA_MAP_INDEX(page, 0)]);
+    if(!level1) {
+        return NULL;
+    }
+    Arena** level2 = g_atomic_pointer_get(&level1[ARENA_MAP_INDEX(page, 1)]);
+    if(!level2) {
+        return NULL;
+    }
+    return g_atomic_pointer_get(&level2[ARENA_MAP_INDEX(page, 2)]);
+}
+
+gsize arena_getChunkSize(gconstpointer ptr) {
+    const ArenaChunk* header = _HEADER(ptr);
+    guint class = (guint)(header->tag & ~ARENA_TAG_MASK);
+    if(class == ARENA_CLASS_LARGE) {
+        return _LARGE_HEADER(ptr)->size;
+    }
+    return _arena_getClassSize(class);
+}
+
+gsize arena_getRequestedSize(gconstpointer ptr) {
+    return _HEADER(ptr)->requestedSize;
+}
+
+void arena_setRequestedSize(gpointer ptr, gsize size) {
+    utility_assert(size <= arena_getChunkSize(ptr));
+    _HEADER(ptr)->requestedSize = size;
+}
@@ -0,0 +1,52 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_ARENA_H_
+#define SHD_ARENA_H_
+
+#include <glib.h>
+
+/**
+ * A private heap that serves the allocations of one owner from large slabs.
+ * Chunks up to 1 MiB are carved from the slabs by size class and recycled
+ * through per-class free lists; larger and over-aligned chunks get their own
+ * mapping, which the arena keeps for reuse once it is released.
+ * The arena that owns a pointer is found in O(1) from the address alone,
+ * through a process-wide map of the pages that arenas mapped, so pointers
+ * from any other allocator are told apart without touching their memory.
+ * Every chunk carries a header in front of it with its size class and the
+ * size that was requested. Freeing the arena releases all of its chunks at
+ * once, including the ones that were never released individually.
+ *
+ * Chunks are guaranteed 16 byte alignment unless requested otherwise.
+ */
+
+typedef struct _Arena Arena;
+
+Arena* arena_new();
+void arena_free(Arena* arena);
+
+/* returns a chunk of at least size bytes, clearing it if requested */
+gpointer arena_alloc(Arena* arena, gsize size, gboolean clear);
+/* alignment must be a power of two */
+gpointer arena_allocAligned(Arena* arena, gsize alignment, gsize size);
+/* returns FALSE if the chunk was already free, whatever its size */
+gboolean arena_release(Arena* arena, gpointer ptr);
+
+/* returns the arena that owns the memory at ptr, or NULL if no arena does.
+ * safe to call with any pointer, from any thread. */
+Arena* arena_getOwner(gconstpointer ptr);
+
+/* the functions below require ptr to be a chunk allocated by an arena */
+
+/* the usable size of the chunk */
+gsize arena_getChunkSize(gconstpointer ptr);
+/* the size the chunk was requested with, or last resized to */
+gsize arena_getRequestedSize(gconstpointer ptr);
+/* resizes the chunk in place, size must not exceed its usable size */
+void arena_setRequestedSize(gpointer ptr, gsize size);
+
+#endif /* SHD_ARENA_H_ */
@@ -10,15 +10,37 @@
 #include "shd-utility.h"
 #include "shd-random.h"
 
+/* xoshiro128** by Blackman and Vigna. its only state is four words and each
+ * draw is a handful of shifts and adds, so loss checks stay cheap per packet */
 struct _Random {
-    guint seedState;
+    guint32 state[4];
     guint initialSeed;
 };
 
+static inline guint32 _random_rotateLeft(const guint32 x, gint k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+static guint64 _random_splitMix64(guint64* x) {
+    guint64 z = (*x += G_GUINT64_CONSTANT(0x9E3779B97F4A7C15));
+    z = (z ^ (z >> 30)) * G_GUINT64_CONSTANT(0xBF58476D1CE4E5B9);
+    z = (z ^ (z >> 27)) * G_GUINT64_CONSTANT(0x94D049BB133111EB);
+    return z ^ (z >> 31);
+}
+
 Random* random_new(guint seed) {
     Random* random = g_new0(Random, 1);
     random->initialSeed = seed;
-    random->seedState = seed;
+
+    /* expand the seed so that similar seeds give unrelated streams, and
+     * so that the state is never all zeros */
+    guint64 x = (guint64) seed;
+    for(gint i = 0; i < 4; i += 2) {
+        guint64 z = _random_splitMix64(&x);
+        random->state[i] = (guint32) z;
+        random->state[i+1] = (guint32) (z >> 32);
+    }
+
     return random;
 }
 
@@ -27,13 +49,30 @@ void random_free(Random* random) {
     g_free(random);
 }
 
+guint32 random_nextUInt(Random* random) {
+    utility_assert(random);
+    guint32* s = random->state;
+
+    const guint32 result = _random_rotateLeft(s[1] * 5, 7) * 9;
+    const guint32 t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = _random_rotateLeft(s[3], 11);
+
+    return result;
+}
+
 gint random_nextInt(Random* random) {
-    return (gint) rand_r(&(random->seedState));
+    /* keep the documented [0, RAND_MAX] range */
+    return (gint) (random_nextUInt(random) % ((guint32)RAND_MAX + 1));
 }
 
 gdouble random_nextDouble(Random* random) {
-    utility_assert(random);
-    return (gdouble)(((gdouble)rand_r(&(random->seedState))) / ((gdouble)RAND_MAX));
+    return (gdouble)(((gdouble)random_nextUInt(random)) / ((gdouble)G_MAXUINT32));
 }
 
 void random_nextNBytes(Random* random, guchar* buffer, gint nbytes) {
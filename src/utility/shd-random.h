@@ -25,6 +25,13 @@ Random* random_new(guint seed);
  */
 void random_free(Random* random);
 
+/**
+ * Gets the next unsigned integer in the range [0, G_MAXUINT32] from the random source.
+ * @param random the random source
+ * @return the next integer in the range [0, G_MAXUINT32]
+ */
+guint32 random_nextUInt(Random* random);
+
 /**
  * Gets the next integer in the range [0, RAND_MAX] from the random source.
  * @param random the random source
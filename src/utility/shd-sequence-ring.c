@@ -0,0 +1,173 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#include <glib.h>
+
+#include "shd-utility.h"
+#include "shd-sequence-ring.h"
+
+/* must be a power of two */
+static const guint32 INITIAL_CAPACITY = 64;
+
+struct _SequenceRing {
+    /* slot for a sequence is sequence & (capacity - 1), so the ring
+     * never needs to move items when the first sequence changes */
+    gpointer* slots;
+    guint32 capacity;
+    /* lowest and highest stored sequence, only valid if length > 0 */
+    guint32 first;
+    guint32 last;
+    gsize length;
+    GDestroyNotify freeFunc;
+};
+
+#define _SLOT(ring, sequence) ((ring)->slots[(sequence) & ((ring)->capacity - 1)])
+
+SequenceRing* sequencering_new(GDestroyNotify freeFunc) {
+    SequenceRing* ring = g_slice_new0(SequenceRing);
+    ring->capacity = INITIAL_CAPACITY;
+    ring->slots = g_new0(gpointer, ring->capacity);
+    ring->freeFunc = freeFunc;
+    return ring;
+}
+
+void sequencering_clear(SequenceRing* ring) {
+    utility_assert(ring);
+    while(ring->length > 0) {
+        gpointer data = sequencering_popFirst(ring);
+        if(ring->freeFunc) {
+            ring->freeFunc(data);
+        }
+    }
+}
+
+void sequencering_free(SequenceRing* ring) {
+    utility_assert(ring);
+    sequencering_clear(ring);
+    g_free(ring->slots);
+    g_slice_free(SequenceRing, ring);
+}
+
+gsize sequencering_getLength(SequenceRing* ring) {
+    utility_assert(ring);
+    return ring->length;
+}
+
+gboolean sequencering_isEmpty(SequenceRing* ring) {
+    utility_assert(ring);
+    return ring->length == 0;
+}
+
+static void _sequencering_grow(SequenceRing* ring, guint64 span) {
+    /* sequences are expected to be close together, this is a sanity check */
+    utility_assert(span <= (guint64)G_MAXINT32);
+
+    guint32 capacity = ring->capacity;
+    while(capacity < span) {
+        capacity *= 2;
+    }
+    if(capacity == ring->capacity) {
+        return;
+    }
+
+    gpointer* slots = g_new0(gpointer, capacity);
+    if(ring->length > 0) {
+        for(guint32 sequence = ring->first; sequence <= ring->last; sequence++) {
+            slots[sequence & (capacity - 1)] = _SLOT(ring, sequence);
+        }
+    }
+
+    g_free(ring->slots);
+    ring->slots = slots;
+    ring->capacity = capacity;
+}
+
+gboolean sequencering_insert(SequenceRing* ring, guint32 sequence, gpointer data) {
+    utility_assert(ring && data);
+
+    if(ring->length == 0) {
+        ring->first = ring->last = sequence;
+    } else {
+        guint32 first = MIN(ring->first, sequence);
+        guint32 last = MAX(ring->last, sequence);
+        _sequencering_grow(ring, ((guint64)last) - first + 1);
+
+        /* slots outside of first and last are always empty */
+        if(_SLOT(ring, sequence) != NULL) {
+            return FALSE;
+        }
+
+        ring->first = first;
+        ring->last = last;
+    }
+
+    _SLOT(ring, sequence) = data;
+    ring->length++;
+    return TRUE;
+}
+
+gpointer sequencering_lookup(SequenceRing* ring, guint32 sequence) {
+    utility_assert(ring);
+    if(ring->length == 0 || sequence < ring->first || sequence > ring->last) {
+        return NULL;
+    }
+    return _SLOT(ring, sequence);
+}
+
+gpointer sequencering_steal(SequenceRing* ring, guint32 sequence) {
+    gpointer data = sequencering_lookup(ring, sequence);
+    if(!data) {
+        return NULL;
+    }
+
+    _SLOT(ring, sequence) = NULL;
+    ring->length--;
+
+    /* skip the gaps so first and last always point at stored items */
+    if(ring->length > 0) {
+        while(_SLOT(ring, ring->first) == NULL) {
+            ring->first++;
+        }
+        while(_SLOT(ring, ring->last) == NULL) {
+            ring->last--;
+        }
+    }
+
+    return data;
+}
+
+guint32 sequencering_getFirstSequence(SequenceRing* ring) {
+    utility_assert(ring && ring->length > 0);
+    return ring->first;
+}
+
+gpointer sequencering_peekFirst(SequenceRing* ring) {
+    utility_assert(ring);
+    return ring->length > 0 ? _SLOT(ring, ring->first) : NULL;
+}
+
+gpointer sequencering_popFirst(SequenceRing* ring) {
+    utility_assert(ring);
+    return ring->length > 0 ? sequencering_steal(ring, ring->first) : NULL;
+}
+
+guint sequencering_removeBefore(SequenceRing* ring, guint32 sequence, GFunc func, gpointer userData) {
+    utility_assert(ring);
+
+    guint nRemoved = 0;
+    while(ring->length > 0 && ring->first < sequence) {
+        gpointer data = sequencering_popFirst(ring);
+        if(func) {
+            func(data, userData);
+        }
+        if(ring->freeFunc) {
+            ring->freeFunc(data);
+        }
+        nRemoved++;
+    }
+
+    return nRemoved;
+}
@@ -0,0 +1,43 @@
+/*
+ * The Shadow Simulator
+ * Copyright (c) 2010-2011, Rob Jansen
+ * See LICENSE for licensing information
+ */
+
+#ifndef SHD_SEQUENCE_RING_H_
+#define SHD_SEQUENCE_RING_H_
+
+#include <glib.h>
+
+/**
+ * A circular array of items indexed by a sequence number. Sequences that are
+ * stored at the same time are expected to be mostly contiguous, so insert,
+ * lookup, and removal from the front are O(1). The ring grows automatically
+ * when the span between the first and last stored sequence exceeds its size.
+ * Sequences are compared as plain integers, they must not wrap around zero.
+ */
+
+typedef struct _SequenceRing SequenceRing;
+
+SequenceRing* sequencering_new(GDestroyNotify freeFunc);
+void sequencering_clear(SequenceRing* ring);
+void sequencering_free(SequenceRing* ring);
+
+gsize sequencering_getLength(SequenceRing* ring);
+gboolean sequencering_isEmpty(SequenceRing* ring);
+
+/* returns FALSE if an item is already stored at the sequence */
+gboolean sequencering_insert(SequenceRing* ring, guint32 sequence, gpointer data);
+gpointer sequencering_lookup(SequenceRing* ring, guint32 sequence);
+/* removes the item without calling the free function */
+gpointer sequencering_steal(SequenceRing* ring, guint32 sequence);
+
+guint32 sequencering_getFirstSequence(SequenceRing* ring);
+gpointer sequencering_peekFirst(SequenceRing* ring);
+gpointer sequencering_popFirst(SequenceRing* ring);
+
+/* calls func on and then frees every item stored below the sequence,
+ * returning the number of items removed */
+guint sequencering_removeBefore(SequenceRing* ring, guint32 sequence, GFunc func, gpointer userData);
+
+#endif /* SHD_SEQUENCE_RING_H_ */